@@ -0,0 +1,669 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "munit.h"
+#include "object_rc.h"
+#include "object_ms.h"
+#include "event_ring.h"
+
+/*MSVC warning about conditional expressions being constant*/
+#if defined(_MSC_VER)
+#pragma warning(disable : 4127)
+#endif
+
+/**
+ * @brief Read a monotonic clock.
+ * 
+ * @return Current time in nanoseconds.
+ */
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Report the cost of one measured loop.
+ * 
+ * @param name Name of the measurement.
+ * @param n Size of the workload.
+ * @param ops Number of operations in the loop.
+ * @param ns Time spent in the loop.
+ */
+static void bench_report(const char *name, size_t n, size_t ops, uint64_t ns)
+{
+    munit_logf(MUNIT_LOG_INFO, "%s n=%zu: %.1f ns/op", name, n, (double)ns / (double)ops);
+}
+
+/**
+ * @brief Get a numeric benchmark parameter.
+ * 
+ * @param params Parameters of the running benchmark.
+ * @param key Name of the parameter.
+ * @return Value of the parameter.
+ */
+static size_t bench_param(const MunitParameter params[], const char *key)
+{
+    return strtoul(munit_parameters_get(params, key), NULL, 10);
+}
+
+/**
+ * @brief Linear scan over parallel key/value arrays, the baseline for maps.
+ * 
+ * @param keys Array of keys.
+ * @param values Array of values, parallel to `keys`.
+ * @param key Key to look up.
+ * @return Pointer to the value, or NULL if the key is absent.
+ */
+static object_t *scan_get(object_t *keys, object_t *values, object_t *key)
+{
+    for (int i = 0; i < length(keys); i++)
+    {
+        if (object_equal(array_get(keys, i), key))
+        {
+            return array_get(values, i);
+        }
+    }
+    return NULL;
+}
+
+static MunitResult bench_map_insert_lookup(const MunitParameter params[], void *data)
+{
+    size_t n = bench_param(params, "entries");
+    object_t *map = new_map();
+    object_t *key = new_integer(0);
+
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < n; i++)
+    {
+        object_t *k = new_integer((int)i);
+        map_set(map, k, k);
+        release_reference(&k);
+    }
+    bench_report("map/insert", n, n, bench_now_ns() - start);
+
+    start = bench_now_ns();
+    for (size_t i = 0; i < n; i++)
+    {
+        key->data.v_int = (int)i;
+        munit_assert_not_null(map_get(map, key));
+    }
+    bench_report("map/lookup", n, n, bench_now_ns() - start);
+
+    object_free(&key);
+    object_free(&map);
+    return MUNIT_OK;
+}
+
+static MunitResult bench_array_scan_insert_lookup(const MunitParameter params[], void *data)
+{
+    size_t n = bench_param(params, "entries");
+    object_t *keys = new_array(0);
+    object_t *values = new_array(0);
+    object_t *key = new_integer(0);
+
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < n; i++)
+    {
+        object_t *k = new_integer((int)i);
+        // An insert has to scan for an existing key first
+        if (scan_get(keys, values, k) == NULL)
+        {
+            array_push(keys, k);
+            array_push(values, k);
+        }
+        release_reference(&k);
+    }
+    bench_report("array_scan/insert", n, n, bench_now_ns() - start);
+
+    start = bench_now_ns();
+    for (size_t i = 0; i < n; i++)
+    {
+        key->data.v_int = (int)i;
+        munit_assert_not_null(scan_get(keys, values, key));
+    }
+    bench_report("array_scan/lookup", n, n, bench_now_ns() - start);
+
+    object_free(&key);
+    object_free(&keys);
+    object_free(&values);
+    return MUNIT_OK;
+}
+
+static MunitResult bench_frame_call_return(const MunitParameter params[], void *data)
+{
+    size_t depth = bench_param(params, "depth");
+    size_t calls = 1000000 / depth;
+    vm_t *vm = vm_new(false);
+    object_t *arg = new_integer_ms(vm, 1);
+
+    // Each call pushes `depth` nested frames, each with a few roots, then returns
+    uint64_t start = bench_now_ns();
+    for (size_t c = 0; c < calls; c++)
+    {
+        for (size_t d = 0; d < depth; d++)
+        {
+            frame_t *frame = vm_new_frame(vm);
+            frame_reference_object(frame, arg);
+            frame_reference_object(frame, arg);
+            frame_reference_object(frame, arg);
+        }
+        for (size_t d = 0; d < depth; d++)
+        {
+            frame_free(vm_frame_pop(vm));
+        }
+    }
+    bench_report("frame/call_return", depth, calls * depth, bench_now_ns() - start);
+
+    vm_free(vm);
+    return MUNIT_OK;
+}
+
+static MunitResult bench_handle_scope(const MunitParameter params[], void *data)
+{
+    size_t depth = bench_param(params, "depth");
+    size_t calls = 1000000 / depth;
+    vm_t *vm = vm_new(false);
+    object_t *arg = new_integer_ms(vm, 1);
+    handle_scope_t scopes[256];
+
+    // Same shape as frame/call_return, rooting through handle scopes
+    uint64_t start = bench_now_ns();
+    for (size_t c = 0; c < calls; c++)
+    {
+        for (size_t d = 0; d < depth; d++)
+        {
+            vm_handle_scope_open(vm, &scopes[d]);
+            vm_handle(vm, arg);
+            vm_handle(vm, arg);
+            vm_handle(vm, arg);
+        }
+        for (size_t d = depth; d-- > 0;)
+        {
+            vm_handle_scope_close(vm, &scopes[d]);
+        }
+    }
+    bench_report("handle/scope", depth, calls * depth, bench_now_ns() - start);
+
+    vm_free(vm);
+    return MUNIT_OK;
+}
+
+static MunitResult bench_events_record(const MunitParameter params[], void *data)
+{
+    size_t events = 1000000;
+
+    // Cost of an event site while nothing is recording
+    uint64_t start = bench_now_ns();
+    for (size_t i = 0; i < events; i++)
+    {
+        event_instant("bench", "event", i);
+    }
+    bench_report("events/record_off", events, events, bench_now_ns() - start);
+
+    event_ring_start();
+    start = bench_now_ns();
+    for (size_t i = 0; i < events; i++)
+    {
+        event_instant("bench", "event", i);
+    }
+    bench_report("events/record_on", events, events, bench_now_ns() - start);
+    event_ring_stop();
+
+    return MUNIT_OK;
+}
+
+/**
+ * @brief Small xorshift generator, so graphs are the same on every run.
+ * 
+ * @param state Generator state, non-zero.
+ * @return Next pseudo-random value.
+ */
+static uint64_t bench_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static MunitResult bench_mark_random_graph(const MunitParameter params[], void *data)
+{
+    size_t n = bench_param(params, "nodes");
+    size_t degree = 4;
+    size_t reps = 5;
+    vm_t *vm = vm_new(false);
+    frame_t *frame = vm_new_frame(vm);
+    object_t **nodes = malloc(n * sizeof(object_t *));
+    munit_assert_not_null(nodes);
+
+    // Random edges, so tracing order has nothing to do with allocation order
+    for (size_t i = 0; i < n; i++)
+    {
+        nodes[i] = new_array_ms(vm, degree);
+    }
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t e = 0; e < degree; e++)
+        {
+            array_set_ms(vm, nodes[i], e, nodes[bench_rand(&state) % n]);
+        }
+    }
+    frame_reference_object(frame, nodes[0]);
+    vm_collect_garbage(vm);
+    size_t live = vm->live_objects;
+
+    const char *names[] = {"mark/random_graph/plain", "mark/random_graph/prefetch"};
+    for (int mode = 0; mode < 2; mode++)
+    {
+        vm->prefetch_marking = mode == 1;
+        uint64_t start = bench_now_ns();
+        for (size_t r = 0; r < reps; r++)
+        {
+            vm_collect_garbage(vm);
+        }
+        bench_report(names[mode], n, reps * live, bench_now_ns() - start);
+        munit_assert_size(vm->live_objects, ==, live);
+    }
+
+    free(nodes);
+    vm_free(vm);
+    return MUNIT_OK;
+}
+
+/**
+ * @brief Measurements of one run of a GC workload.
+ */
+typedef struct BenchRecord
+{
+    const char *model;       /**< "rc" or "ms" */
+    const char *workload;    /**< Shape of the heap */
+    size_t objects;          /**< Objects allocated by the workload */
+    size_t live;             /**< Objects reachable when the heap is released */
+    uint64_t alloc_ns;       /**< Time spent building the heap */
+    uint64_t collect_ns;     /**< Time of one collection of the live heap, 0 for rc */
+    uint64_t release_ns;     /**< Time spent reclaiming the live heap once unreachable */
+} bench_record_t;
+
+/**
+ * @brief Peak resident set size of this process.
+ * 
+ * @return Peak RSS in KiB.
+ */
+static long bench_peak_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * @brief Emit a record as one line of JSON.
+ * 
+ * The line is logged, and appended to the file named by `BENCH_RESULTS` when
+ * that variable is set, so results can be collected and compared across runs.
+ * 
+ * @param record Measurements to emit.
+ */
+static void bench_emit(const bench_record_t *record)
+{
+    char line[512];
+    char collect[32] = "null";
+    double seconds = (double)record->alloc_ns / 1e9;
+    if (record->collect_ns > 0)
+    {
+        snprintf(collect, sizeof(collect), "%.2f", (double)record->collect_ns / (double)record->live);
+    }
+    snprintf(line, sizeof(line),
+             "{\"model\":\"%s\",\"workload\":\"%s\",\"objects\":%zu,\"live\":%zu,"
+             "\"alloc_objects_per_sec\":%.0f,\"collect_ns_per_live\":%s,"
+             "\"release_ns_per_live\":%.2f,\"peak_rss_kb\":%ld}",
+             record->model, record->workload, record->objects, record->live,
+             seconds > 0 ? (double)record->objects / seconds : 0.0, collect,
+             (double)record->release_ns / (double)record->live, bench_peak_rss_kb());
+    munit_logf(MUNIT_LOG_INFO, "%s", line);
+
+    const char *path = getenv("BENCH_RESULTS");
+    if (path != NULL)
+    {
+        FILE *out = fopen(path, "a");
+        if (out != NULL)
+        {
+            fprintf(out, "%s\n", line);
+            fclose(out);
+        }
+    }
+}
+
+/**
+ * @brief Allocate a string for the churn workload.
+ * 
+ * @param vm VM to allocate in, or NULL for a reference-counted string.
+ * @param i Index of the string.
+ * @return The new string.
+ */
+static object_t *bench_churn_string(vm_t *vm, size_t i)
+{
+    char text[32];
+    int len = snprintf(text, sizeof(text), "churn-%zu", i);
+    return vm ? new_string_len_ms(vm, text, (size_t)len) : new_string_len(text, (size_t)len);
+}
+
+#define BENCH_CHURN_WINDOW 1024
+
+/**
+ * @brief Build a workload with reference counting.
+ * 
+ * Graphs only link to lower-numbered nodes, and cycles are not supported,
+ * since reference counting can not reclaim either.
+ * 
+ * @param workload Name of the workload.
+ * @param n Number of objects to allocate.
+ * @return Root of the heap, owning one reference.
+ */
+static object_t *bench_build_rc(const char *workload, size_t n)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+    if (strcmp(workload, "list") == 0)
+    {
+        object_t *head = NULL;
+        for (size_t i = 0; i < n; i++)
+        {
+            object_t *node = new_array(1);
+            if (head != NULL)
+            {
+                array_set(node, 0, head);
+                release_reference(&head);
+            }
+            head = node;
+        }
+        return head;
+    }
+    if (strcmp(workload, "tree") == 0 || strcmp(workload, "graph") == 0)
+    {
+        bool tree = workload[0] == 't';
+        size_t degree = tree ? 2 : 4;
+        object_t **nodes = malloc(n * sizeof(object_t *));
+        munit_assert_not_null(nodes);
+        object_t *root = tree ? NULL : new_array(n - 1);
+        for (size_t k = 0; k < n - (tree ? 0 : 1); k++)
+        {
+            // Trees are built bottom-up, graphs link each node to earlier ones
+            size_t i = tree ? n - 1 - k : k;
+            nodes[i] = new_array(degree);
+            for (size_t e = 0; e < degree; e++)
+            {
+                size_t child = tree ? degree * i + e + 1 : (i ? bench_rand(&state) % i : n);
+                if (child < n && (tree || child < i))
+                {
+                    array_set(nodes[i], e, nodes[child]);
+                }
+            }
+            if (tree)
+            {
+                for (size_t e = 0; e < degree && degree * i + e + 1 < n; e++)
+                {
+                    release_reference(&nodes[degree * i + e + 1]);
+                }
+            }
+            else
+            {
+                array_set(root, i, nodes[i]);
+            }
+        }
+        if (tree)
+        {
+            root = nodes[0];
+        }
+        else
+        {
+            for (size_t i = 0; i < n - 1; i++)
+            {
+                release_reference(&nodes[i]);
+            }
+        }
+        free(nodes);
+        return root;
+    }
+    if (strcmp(workload, "wide") == 0)
+    {
+        object_t *root = new_array(n - 1);
+        for (size_t i = 0; i < n - 1; i++)
+        {
+            object_t *value = new_integer((int)i);
+            array_set(root, i, value);
+            release_reference(&value);
+        }
+        return root;
+    }
+    if (strcmp(workload, "strings") == 0)
+    {
+        object_t *root = new_array(BENCH_CHURN_WINDOW);
+        for (size_t i = 0; i < n - 1; i++)
+        {
+            object_t *s = bench_churn_string(NULL, i);
+            array_set(root, i % BENCH_CHURN_WINDOW, s);
+            release_reference(&s);
+        }
+        return root;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Build a workload in a mark-sweep VM, rooted from `frame`.
+ * 
+ * @param vm VM to allocate in.
+ * @param frame Frame that roots the heap.
+ * @param workload Name of the workload.
+ * @param n Number of objects to allocate.
+ */
+static void bench_build_ms(vm_t *vm, frame_t *frame, const char *workload, size_t n)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    object_t *root = NULL;
+
+    if (strcmp(workload, "list") == 0 || strcmp(workload, "cycle") == 0)
+    {
+        object_t *last = new_array_ms(vm, 1);
+        root = last;
+        for (size_t i = 1; i < n; i++)
+        {
+            object_t *node = new_array_ms(vm, 1);
+            array_set_ms(vm, node, 0, root);
+            root = node;
+        }
+        if (workload[0] == 'c')
+        {
+            array_set_ms(vm, last, 0, root);
+        }
+    }
+    else if (strcmp(workload, "tree") == 0 || strcmp(workload, "graph") == 0)
+    {
+        bool tree = workload[0] == 't';
+        size_t degree = tree ? 2 : 4;
+        object_t **nodes = malloc(n * sizeof(object_t *));
+        munit_assert_not_null(nodes);
+        if (!tree)
+        {
+            root = new_array_ms(vm, n - 1);
+            frame_reference_object(frame, root);
+        }
+        for (size_t k = 0; k < n - (tree ? 0 : 1); k++)
+        {
+            size_t i = tree ? n - 1 - k : k;
+            nodes[i] = new_array_ms(vm, degree);
+            for (size_t e = 0; e < degree; e++)
+            {
+                size_t child = tree ? degree * i + e + 1 : (i ? bench_rand(&state) % i : n);
+                if (child < n && (tree || child < i))
+                {
+                    array_set_ms(vm, nodes[i], e, nodes[child]);
+                }
+            }
+            if (!tree)
+            {
+                array_set_ms(vm, root, i, nodes[i]);
+            }
+        }
+        root = tree ? nodes[0] : NULL;
+        free(nodes);
+    }
+    else if (strcmp(workload, "wide") == 0)
+    {
+        root = new_array_ms(vm, n - 1);
+        for (size_t i = 0; i < n - 1; i++)
+        {
+            array_set_ms(vm, root, i, new_integer_ms(vm, (int)i));
+        }
+    }
+    else if (strcmp(workload, "strings") == 0)
+    {
+        // Collect regularly, as a mutator that churns through strings would
+        object_t *window = new_array_ms(vm, BENCH_CHURN_WINDOW);
+        frame_reference_object(frame, window);
+        for (size_t i = 0; i < n - 1; i++)
+        {
+            array_set_ms(vm, window, i % BENCH_CHURN_WINDOW, bench_churn_string(vm, i));
+            if ((i + 1) % (16 * BENCH_CHURN_WINDOW) == 0)
+            {
+                vm_collect_garbage(vm);
+            }
+        }
+    }
+
+    if (root != NULL)
+    {
+        frame_reference_object(frame, root);
+    }
+}
+
+static MunitResult bench_gc_rc(const MunitParameter params[], void *data)
+{
+    const char *workload = munit_parameters_get(params, "workload");
+    size_t n = bench_param(params, "objects");
+    if (strcmp(workload, "cycle") == 0)
+    {
+        return MUNIT_SKIP;
+    }
+
+    // The churn window only keeps the most recent strings alive
+    size_t live = strcmp(workload, "strings") == 0 && n > BENCH_CHURN_WINDOW ? BENCH_CHURN_WINDOW + 1 : n;
+    bench_record_t record = {"rc", workload, n, live, 0, 0, 0};
+    uint64_t start = bench_now_ns();
+    object_t *root = bench_build_rc(workload, n);
+    record.alloc_ns = bench_now_ns() - start;
+    munit_assert_not_null(root);
+
+    // Lists are released one node at a time, releasing the head in one go recurses n deep
+    start = bench_now_ns();
+    if (strcmp(workload, "list") == 0)
+    {
+        while (root != NULL)
+        {
+            object_t *next = array_get(root, 0);
+            add_reference(next);
+            release_reference(&root);
+            root = next;
+        }
+    }
+    else
+    {
+        release_reference(&root);
+    }
+    record.release_ns = bench_now_ns() - start;
+
+    bench_emit(&record);
+    return MUNIT_OK;
+}
+
+static MunitResult bench_gc_ms(const MunitParameter params[], void *data)
+{
+    const char *workload = munit_parameters_get(params, "workload");
+    size_t n = bench_param(params, "objects");
+    size_t reps = 3;
+    vm_t *vm = vm_new(false);
+    frame_t *frame = vm_new_frame(vm);
+
+    bench_record_t record = {"ms", workload, n, 0, 0, 0, 0};
+    uint64_t start = bench_now_ns();
+    bench_build_ms(vm, frame, workload, n);
+    record.alloc_ns = bench_now_ns() - start;
+
+    vm_collect_garbage(vm);
+    record.live = vm->live_objects;
+    start = bench_now_ns();
+    for (size_t r = 0; r < reps; r++)
+    {
+        vm_collect_garbage(vm);
+    }
+    record.collect_ns = (bench_now_ns() - start) / reps;
+    munit_assert_size(vm->live_objects, ==, record.live);
+
+    frame_free(vm_frame_pop(vm));
+    start = bench_now_ns();
+    vm_collect_garbage(vm);
+    record.release_ns = bench_now_ns() - start;
+    munit_assert_size(vm->live_objects, ==, 0);
+
+    bench_emit(&record);
+    vm_free(vm);
+    return MUNIT_OK;
+}
+
+static char *entries_params[] = {(char *)"16", (char *)"256", (char *)"4096", NULL};
+
+static MunitParameterEnum map_params[] = {
+    {(char *)"entries", entries_params},
+    {NULL, NULL}};
+
+static char *depth_params[] = {(char *)"1", (char *)"16", (char *)"256", NULL};
+
+static MunitParameterEnum frame_params[] = {
+    {(char *)"depth", depth_params},
+    {NULL, NULL}};
+
+static char *nodes_params[] = {(char *)"10000", (char *)"100000", (char *)"1000000", NULL};
+
+static MunitParameterEnum graph_params[] = {
+    {(char *)"nodes", nodes_params},
+    {NULL, NULL}};
+
+static char *workload_params[] = {(char *)"list", (char *)"tree", (char *)"wide", (char *)"graph", (char *)"cycle", (char *)"strings", NULL};
+
+static char *objects_params[] = {(char *)"1000", (char *)"10000", (char *)"100000", (char *)"1000000", NULL};
+
+static MunitParameterEnum gc_params[] = {
+    {(char *)"workload", workload_params},
+    {(char *)"objects", objects_params},
+    {NULL, NULL}};
+
+static MunitTest bench_suite_tests[] = {
+    {(char *)"/map/insert_lookup", bench_map_insert_lookup, NULL, NULL, MUNIT_TEST_OPTION_NONE, map_params},
+    {(char *)"/array_scan/insert_lookup", bench_array_scan_insert_lookup, NULL, NULL, MUNIT_TEST_OPTION_NONE, map_params},
+    {(char *)"/frame/call_return", bench_frame_call_return, NULL, NULL, MUNIT_TEST_OPTION_NONE, frame_params},
+    {(char *)"/handle/scope", bench_handle_scope, NULL, NULL, MUNIT_TEST_OPTION_NONE, frame_params},
+    {(char *)"/events/record", bench_events_record, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/mark/random_graph", bench_mark_random_graph, NULL, NULL, MUNIT_TEST_OPTION_NONE, graph_params},
+    {(char *)"/gc/rc", bench_gc_rc, NULL, NULL, MUNIT_TEST_OPTION_NONE, gc_params},
+    {(char *)"/gc/ms", bench_gc_ms, NULL, NULL, MUNIT_TEST_OPTION_NONE, gc_params},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+static const MunitSuite bench_suite = {
+    (char *)"Bench",
+    bench_suite_tests,
+    NULL,
+    1,
+    MUNIT_SUITE_OPTION_NONE};
+
+int main(int argc, char *argv[MUNIT_ARRAY_PARAM(argc + 1)])
+{
+    return munit_suite_main(&bench_suite, NULL, argc, argv);
+}
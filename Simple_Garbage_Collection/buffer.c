@@ -0,0 +1,238 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "buffer.h"
+#include "event_ring.h"
+
+/**
+ * @brief Get the header of a buffer from its payload pointer.
+ * 
+ * @param data Payload pointer.
+ * @return Pointer to the buffer header.
+ */
+static buffer_t *_header(const void *data)
+{
+    return (buffer_t *)((unsigned char *)data - offsetof(buffer_t, data));
+}
+
+/**
+ * @brief Round an allocation size up to whole pages.
+ * 
+ * @param size Size in bytes.
+ * @return Multiple of the page size, at least `size`.
+ */
+static size_t _page_round(size_t size)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+/**
+ * @brief Allocate an uninitialised buffer, mapping large ones from the OS.
+ * 
+ * @param capacity Size of the payload in bytes.
+ * @return Pointer to the header with `capacity` and `mapped` set, or NULL if allocation fails.
+ * 
+ * @note Mapped payloads are always zero-filled.
+ */
+static buffer_t *_allocate(size_t capacity)
+{
+    size_t size = sizeof(buffer_t) + capacity;
+    buffer_t *buf;
+    if (size < BUFFER_LARGE_THRESHOLD)
+    {
+        buf = malloc(size);
+        if (buf == NULL)
+            return NULL;
+
+        buf->mapped = 0;
+    }
+    else
+    {
+        size = _page_round(size);
+        buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED)
+            return NULL;
+
+        buf->mapped = size;
+        event_instant("alloc", "mapped_buffer", size);
+    }
+
+    buf->capacity = capacity;
+    return buf;
+}
+
+/**
+ * @brief Return the memory of a buffer to the heap or to the OS.
+ * 
+ * @param buf Header of the buffer.
+ */
+static void _deallocate(buffer_t *buf)
+{
+    if (buf->mapped)
+        munmap(buf, buf->mapped);
+    else
+        free(buf);
+}
+
+/**
+ * @brief Resize a uniquely owned buffer, keeping the first `size` bytes.
+ * 
+ * @param buf Header of the buffer.
+ * @param size Number of bytes in use that must be preserved, at most `capacity`.
+ * @param capacity New payload size in bytes.
+ * @return Header of the (possibly moved) buffer, or NULL if allocation fails.
+ * 
+ * @note The bytes past the old capacity are not initialised.
+ */
+static buffer_t *_resize(buffer_t *buf, size_t size, size_t capacity)
+{
+    size_t bytes = sizeof(buffer_t) + capacity;
+    if (!buf->mapped && bytes < BUFFER_LARGE_THRESHOLD)
+    {
+        buffer_t *tmp = realloc(buf, bytes);
+        if (tmp != NULL)
+            tmp->capacity = capacity;
+
+        return tmp;
+    }
+
+    if (buf->mapped && bytes >= BUFFER_LARGE_THRESHOLD)
+    {
+        size_t length = _page_round(bytes);
+        if (length < buf->mapped)
+        {
+            // Give the unused tail pages back without moving the payload
+            munmap((unsigned char *)buf + length, buf->mapped - length);
+            buf->mapped = length;
+        }
+#if defined(__linux__)
+        else if (length > buf->mapped)
+        {
+            buffer_t *tmp = mremap(buf, buf->mapped, length, MREMAP_MAYMOVE);
+            if (tmp == MAP_FAILED)
+                return NULL;
+
+            buf = tmp;
+            buf->mapped = length;
+        }
+#endif
+        if (length <= buf->mapped)
+        {
+            buf->capacity = capacity;
+            return buf;
+        }
+    }
+
+    // Crossing the threshold, move between the heap and a mapping
+    buffer_t *tmp = _allocate(capacity);
+    if (tmp == NULL)
+        return NULL;
+
+    tmp->refcount = buf->refcount;
+    memcpy(tmp->data, buf->data, size);
+    _deallocate(buf);
+    return tmp;
+}
+
+void *buffer_new(size_t capacity)
+{
+    buffer_t *buf = _allocate(capacity);
+    if (buf == NULL)
+        return NULL;
+
+    buf->refcount = 1;
+    if (!buf->mapped)
+        memset(buf->data, 0, capacity);
+
+    return buf->data;
+}
+
+void *buffer_copy(const void *data, size_t size, size_t capacity)
+{
+    if (capacity < size)
+        capacity = size;
+
+    buffer_t *buf = _allocate(capacity);
+    if (buf == NULL)
+        return NULL;
+
+    buf->refcount = 1;
+    memcpy(buf->data, data, size);
+    if (!buf->mapped)
+        memset(buf->data + size, 0, capacity - size);
+
+    return buf->data;
+}
+
+void *buffer_reserve(void *data, size_t size, size_t capacity)
+{
+    buffer_t *buf = _header(data);
+    if (buf->refcount > 1)
+    {
+        void *copy = buffer_copy(data, size, capacity);
+        if (copy == NULL)
+            return NULL;
+
+        buf->refcount--;
+        return copy;
+    }
+
+    if (capacity <= buf->capacity)
+        return data;
+
+    size_t old_capacity = buf->capacity;
+    buffer_t *tmp = _resize(buf, old_capacity, capacity);
+    if (tmp == NULL)
+        return NULL;
+
+    memset(tmp->data + old_capacity, 0, capacity - old_capacity);
+    return tmp->data;
+}
+
+void *buffer_shrink(void *data, size_t capacity)
+{
+    buffer_t *buf = _header(data);
+    if (buf->refcount > 1 || capacity >= buf->capacity)
+        return data;
+
+    buffer_t *tmp = _resize(buf, capacity, capacity);
+    return tmp != NULL ? tmp->data : NULL;
+}
+
+void *buffer_retain(void *data)
+{
+    if (data != NULL)
+        _header(data)->refcount++;
+
+    return data;
+}
+
+void buffer_release(void *data)
+{
+    if (data == NULL)
+        return;
+
+    buffer_t *buf = _header(data);
+    buf->refcount--;
+    if (buf->refcount == 0)
+        _deallocate(buf);
+}
+
+bool buffer_is_shared(const void *data)
+{
+    return data != NULL && _header(data)->refcount > 1;
+}
+
+bool buffer_is_mapped(const void *data)
+{
+    return data != NULL && _header(data)->mapped != 0;
+}
+
+size_t buffer_capacity(const void *data)
+{
+    return data == NULL ? 0 : _header(data)->capacity;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Allocation size, header included, from which buffers are mapped directly from the OS.
+ * 
+ * Large buffers get their own `mmap` mapping, so freeing one returns its pages
+ * to the OS immediately instead of fragmenting the malloc heap.
+ */
+#define BUFFER_LARGE_THRESHOLD (128 * 1024)
+
+/**
+ * @struct Buffer
+ * @brief Header of a reference counted, copy-on-write backing buffer.
+ * 
+ * The header lives directly in front of the payload, so owners keep a plain
+ * pointer to the payload (e.g. `char *` for strings, `object_t **` for arrays)
+ * and all functions below take and return payload pointers.
+ */
+typedef struct Buffer
+{
+    size_t refcount;   /**< Number of owners sharing the payload */
+    size_t capacity;   /**< Size of the payload in bytes */
+    size_t mapped;     /**< Length of the `mmap` mapping, 0 for heap buffers */
+    unsigned char data[]; /**< Payload */
+} buffer_t;
+
+/**
+ * @brief Create a new zero-filled buffer with a single owner.
+ * 
+ * @param capacity Size of the payload in bytes.
+ * @return Pointer to the payload, or NULL if allocation fails.
+ */
+void *buffer_new(size_t capacity);
+
+/**
+ * @brief Create a new buffer holding a copy of the first `size` bytes of another.
+ * 
+ * @param data Payload to copy from.
+ * @param size Number of bytes to copy.
+ * @param capacity Size of the new payload in bytes, at least `size`.
+ * @return Pointer to the new payload with a single owner, or NULL if allocation fails.
+ * 
+ * @note The source buffer is left untouched.
+ */
+void *buffer_copy(const void *data, size_t size, size_t capacity);
+
+/**
+ * @brief Make sure a buffer is uniquely owned and holds at least `capacity` bytes.
+ * 
+ * @param data Payload owned by the caller.
+ * @param size Number of bytes in use that must be preserved.
+ * @param capacity Minimum payload size in bytes.
+ * @return Pointer to the (possibly moved) payload, or NULL if allocation fails.
+ * 
+ * @note A shared buffer is copied and the caller's share of the original is
+ *       released. On failure the caller still owns `data`.
+ */
+void *buffer_reserve(void *data, size_t size, size_t capacity);
+
+/**
+ * @brief Release the unused tail of a uniquely owned buffer.
+ * 
+ * @param data Payload owned by the caller.
+ * @param capacity New payload size in bytes.
+ * @return Pointer to the (possibly moved) payload, or NULL if allocation fails.
+ * 
+ * @note Shared buffers, and requests that would not shrink the buffer, are
+ *       returned unchanged. On failure the caller still owns `data`.
+ */
+void *buffer_shrink(void *data, size_t capacity);
+
+/**
+ * @brief Add an owner to a buffer.
+ * 
+ * @param data Payload to share.
+ * @return The same payload pointer.
+ */
+void *buffer_retain(void *data);
+
+/**
+ * @brief Drop one owner of a buffer, freeing it when the last owner is gone.
+ * 
+ * @param data Payload to release.
+ */
+void buffer_release(void *data);
+
+/**
+ * @brief Check whether a buffer has more than one owner.
+ * 
+ * @param data Payload to check.
+ * @return True if the payload must be copied before being mutated.
+ */
+bool buffer_is_shared(const void *data);
+
+/**
+ * @brief Check whether a buffer lives in its own `mmap` mapping.
+ * 
+ * @param data Payload to check.
+ * @return True for buffers of at least BUFFER_LARGE_THRESHOLD bytes.
+ */
+bool buffer_is_mapped(const void *data);
+
+/**
+ * @brief Get the size of a buffer's payload.
+ * 
+ * @param data Payload to query.
+ * @return Payload size in bytes.
+ */
+size_t buffer_capacity(const void *data);
@@ -0,0 +1,208 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "event_ring.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define EVENT_TSC
+#include <x86intrin.h>
+#endif
+
+/**
+ * @struct Event
+ * @brief One slot of the ring.
+ */
+typedef struct Event
+{
+    _Atomic uint64_t sequence; /**< Index of the event plus one once written, 0 while empty */
+    uint64_t ticks;            /**< Time of the event, see `_ticks` */
+    uint64_t value;            /**< Value of an instant event */
+    const char *category;      /**< Group of the event */
+    const char *name;          /**< Name of the event */
+    uint32_t thread;           /**< Recording thread, numbered from 1 */
+    uint8_t kind;              /**< An event_kind_t */
+} event_t;
+
+static event_t _ring[EVENT_RING_SIZE];
+static _Atomic uint64_t _head = 0;
+static atomic_bool _recording = false;
+static _Atomic uint32_t _threads = 0;
+static _Thread_local uint32_t _thread = 0;
+static uint64_t _start_ticks = 0;
+static uint64_t _start_ns = 0;
+
+/**
+ * @brief Read a monotonic clock.
+ * 
+ * @return CLOCK_MONOTONIC time in nanoseconds.
+ */
+static uint64_t _clock_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Read the clock stamped on events.
+ * 
+ * @return Time stamp counter on x86-64, which is several times cheaper than
+ *         `clock_gettime`; nanoseconds elsewhere.
+ * 
+ * @note Ticks are converted to nanoseconds at export, against the clock
+ *       readings taken by `event_ring_start` and by the export itself.
+ */
+static uint64_t _ticks(void)
+{
+#if defined(EVENT_TSC)
+    return __rdtsc();
+#else
+    return _clock_ns();
+#endif
+}
+
+/**
+ * @brief Claim a slot and fill it with an event.
+ * 
+ * @param kind Shape of the event.
+ * @param category Group of the event.
+ * @param name Name of the event.
+ * @param value Value of an instant event.
+ * 
+ * @note Writers never wait: each claims its own index with one atomic add,
+ *       and publishes the slot by storing the index last.
+ */
+static void _record(event_kind_t kind, const char *category, const char *name, uint64_t value)
+{
+    if (!atomic_load_explicit(&_recording, memory_order_relaxed))
+        return;
+
+    uint64_t ticks = _ticks();
+    if (_thread == 0)
+    {
+        _thread = atomic_fetch_add_explicit(&_threads, 1, memory_order_relaxed) + 1;
+    }
+
+    uint64_t index = atomic_fetch_add_explicit(&_head, 1, memory_order_relaxed);
+    event_t *event = &_ring[index & (EVENT_RING_SIZE - 1)];
+    atomic_store_explicit(&event->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    event->ticks = ticks;
+    event->value = value;
+    event->category = category;
+    event->name = name;
+    event->thread = _thread;
+    event->kind = kind;
+    atomic_store_explicit(&event->sequence, index + 1, memory_order_release);
+}
+
+void event_ring_start(void)
+{
+    for (size_t i = 0; i < EVENT_RING_SIZE; i++)
+    {
+        atomic_store_explicit(&_ring[i].sequence, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&_head, 0, memory_order_relaxed);
+    _start_ns = _clock_ns();
+    _start_ticks = _ticks();
+    atomic_store_explicit(&_recording, true, memory_order_release);
+}
+
+void event_ring_stop(void)
+{
+    atomic_store_explicit(&_recording, false, memory_order_release);
+}
+
+void event_begin(const char *category, const char *name)
+{
+    _record(EVENT_BEGIN, category, name, 0);
+}
+
+void event_end(const char *category, const char *name)
+{
+    _record(EVENT_END, category, name, 0);
+}
+
+void event_instant(const char *category, const char *name, uint64_t value)
+{
+    _record(EVENT_INSTANT, category, name, value);
+}
+
+size_t event_ring_count(void)
+{
+    uint64_t head = atomic_load_explicit(&_head, memory_order_acquire);
+    return head < EVENT_RING_SIZE ? (size_t)head : EVENT_RING_SIZE;
+}
+
+/**
+ * @brief Write a string as a JSON string literal.
+ * 
+ * @param out File to write to.
+ * @param text String to quote, NULL is written as an empty string.
+ */
+static void _write_json_string(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (const char *c = text; c != NULL && *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', out);
+        if ((unsigned char)*c < 0x20)
+            fprintf(out, "\\u%04x", *c);
+        else
+            fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+size_t event_ring_write_chrome(FILE *out)
+{
+    if (out == NULL)
+        return 0;
+
+    static const char phases[] = {[EVENT_BEGIN] = 'B', [EVENT_END] = 'E', [EVENT_INSTANT] = 'i'};
+    uint64_t head = atomic_load_explicit(&_head, memory_order_acquire);
+    uint64_t first = head > EVENT_RING_SIZE ? head - EVENT_RING_SIZE : 0;
+    long pid = (long)getpid();
+    uint64_t elapsed_ticks = _ticks() - _start_ticks;
+    uint64_t elapsed_ns = _clock_ns() - _start_ns;
+    double ns_per_tick = elapsed_ticks > 0 ? (double)elapsed_ns / (double)elapsed_ticks : 1.0;
+    size_t written = 0;
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+    for (uint64_t index = first; index < head; index++)
+    {
+        event_t *slot = &_ring[index & (EVENT_RING_SIZE - 1)];
+        if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != index + 1)
+            continue;
+
+        // Copy the slot, then check that no writer reused it meanwhile
+        uint64_t ticks = slot->ticks;
+        uint64_t value = slot->value;
+        const char *category = slot->category;
+        const char *name = slot->name;
+        uint32_t thread = slot->thread;
+        uint8_t kind = slot->kind;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != index + 1)
+            continue;
+
+        uint64_t timestamp_ns = _start_ns + (uint64_t)((double)(ticks - _start_ticks) * ns_per_tick);
+        fputs(written > 0 ? ",\n{" : "\n{", out);
+        fputs("\"name\":", out);
+        _write_json_string(out, name);
+        fputs(",\"cat\":", out);
+        _write_json_string(out, category);
+        fprintf(out, ",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%ld,\"tid\":%u",
+                phases[kind], (unsigned long long)(timestamp_ns / 1000),
+                (unsigned long long)(timestamp_ns % 1000), pid, thread);
+        if (kind == EVENT_INSTANT)
+            fprintf(out, ",\"s\":\"t\",\"args\":{\"value\":%llu}", (unsigned long long)value);
+        fputc('}', out);
+        written++;
+    }
+    fputs("\n]}\n", out);
+    return written;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Number of events kept; older events are overwritten. A power of two.
+ */
+#define EVENT_RING_SIZE (1 << 16)
+
+/**
+ * @enum EventKind
+ * Shape of an event on the timeline.
+ */
+typedef enum EventKind {
+    EVENT_BEGIN,           /**< Start of a span */
+    EVENT_END,             /**< End of the innermost open span of the same thread */
+    EVENT_INSTANT          /**< Point in time carrying a value */
+} event_kind_t;
+
+/**
+ * @brief Clear the ring and start recording events.
+ * 
+ * @note Not safe to call while other threads are recording.
+ */
+void event_ring_start(void);
+
+/**
+ * @brief Stop recording events; the ring keeps the events recorded so far.
+ */
+void event_ring_stop(void);
+
+/**
+ * @brief Record the start of a span.
+ * 
+ * @param category Group of the event, e.g. "gc" or "app".
+ * @param name Name of the span.
+ * 
+ * @note Strings are stored by pointer and must outlive the export, string
+ *       literals are the intended use. Does nothing unless recording.
+ */
+void event_begin(const char *category, const char *name);
+
+/**
+ * @brief Record the end of the innermost span opened by this thread.
+ * 
+ * @param category Group of the event.
+ * @param name Name of the span.
+ */
+void event_end(const char *category, const char *name);
+
+/**
+ * @brief Record an instant event.
+ * 
+ * @param category Group of the event.
+ * @param name Name of the event.
+ * @param value Value shown with the event, e.g. a size in bytes.
+ */
+void event_instant(const char *category, const char *name, uint64_t value);
+
+/**
+ * @brief Get the number of events that the ring currently holds.
+ * 
+ * @return Events recorded since `event_ring_start`, at most EVENT_RING_SIZE.
+ */
+size_t event_ring_count(void);
+
+/**
+ * @brief Write the events in the ring as Chrome trace event JSON.
+ * 
+ * The output opens in `chrome://tracing` and in Perfetto. Timestamps are
+ * CLOCK_MONOTONIC microseconds, so spans recorded by the application with
+ * `event_begin` and `event_end` line up with the collector's.
+ * 
+ * @param out File to write to.
+ * @return Number of events written.
+ * 
+ * @note Best called after `event_ring_stop`; events overwritten or still
+ *       being written by another thread during the export are skipped.
+ */
+size_t event_ring_write_chrome(FILE *out);
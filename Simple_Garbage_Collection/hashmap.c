@@ -0,0 +1,178 @@
+#include <stdlib.h>
+
+#include "hashmap.h"
+
+/**
+ * @brief Number of slots allocated on the first insert.
+ */
+#define HASHMAP_MIN_CAPACITY 8
+
+/**
+ * @brief Compare a stored entry with a key, using fast paths for common kinds.
+ * 
+ * @param entry Entry in use.
+ * @param key Key to compare with.
+ * @param hash Hash of `key`.
+ * @return True if the entry holds `key`.
+ */
+static bool _entry_matches(map_entry_t *entry, object_t *key, size_t hash)
+{
+    if (entry->key == key)
+        return true;
+
+    if (entry->hash != hash || entry->key->kind != key->kind)
+        return false;
+
+    switch (key->kind)
+    {
+    case INTEGER:
+        return entry->key->data.v_int == key->data.v_int;
+    case STRING:
+        return string_equal(entry->key, key);
+    default:
+        return object_equal(entry->key, key);
+    }
+}
+
+/**
+ * @brief Find the slot holding a key, or the empty slot where it would go.
+ * 
+ * @param map Map with at least one slot.
+ * @param key Key to look up.
+ * @param hash Hash of `key`.
+ * @return Index of the slot.
+ */
+static size_t _probe(map_t *map, object_t *key, size_t hash)
+{
+    size_t mask = map->capacity - 1;
+    size_t slot = hash & mask;
+    while (map->entries[slot].key != NULL && !_entry_matches(&map->entries[slot], key, hash))
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * @brief Rehash every entry into a table of a new size.
+ * 
+ * @param map Map to resize.
+ * @param capacity New number of slots, a power of two larger than `count`.
+ * @return True if successful, false if allocation fails.
+ */
+static bool _resize(map_t *map, size_t capacity)
+{
+    map_entry_t *entries = calloc(capacity, sizeof(map_entry_t));
+    if (entries == NULL)
+        return false;
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        map_entry_t *entry = &map->entries[i];
+        if (entry->key == NULL)
+            continue;
+
+        size_t slot = entry->hash & mask;
+        while (entries[slot].key != NULL)
+        {
+            slot = (slot + 1) & mask;
+        }
+        entries[slot] = *entry;
+    }
+
+    free(map->entries);
+    map->entries = entries;
+    map->capacity = capacity;
+    return true;
+}
+
+map_entry_t *hashmap_find(map_t *map, object_t *key)
+{
+    if (map == NULL || key == NULL || map->count == 0)
+        return NULL;
+
+    size_t slot = _probe(map, key, object_hash(key));
+    return map->entries[slot].key != NULL ? &map->entries[slot] : NULL;
+}
+
+bool hashmap_put(map_t *map, object_t *key, object_t *value, map_entry_t *old)
+{
+    old->key = NULL;
+    old->value = NULL;
+    if (map == NULL || key == NULL)
+        return false;
+
+    // Keep the load factor at or below 3/4
+    if ((map->count + 1) * 4 > map->capacity * 3)
+    {
+        size_t capacity = map->capacity ? map->capacity * 2 : HASHMAP_MIN_CAPACITY;
+        if (!_resize(map, capacity))
+            return false;
+    }
+
+    size_t hash = object_hash(key);
+    size_t slot = _probe(map, key, hash);
+    map_entry_t *entry = &map->entries[slot];
+    if (entry->key != NULL)
+    {
+        *old = *entry;
+    }
+    else
+    {
+        map->count++;
+    }
+
+    entry->hash = hash;
+    entry->key = key;
+    entry->value = value;
+    return true;
+}
+
+void hashmap_remove_slot(map_t *map, size_t slot)
+{
+    size_t mask = map->capacity - 1;
+    map->entries[slot].key = NULL;
+    map->entries[slot].value = NULL;
+    map->count--;
+
+    // Shift later members of the probe run back into the hole
+    size_t hole = slot;
+    for (size_t i = (slot + 1) & mask; map->entries[i].key != NULL; i = (i + 1) & mask)
+    {
+        size_t home = map->entries[i].hash & mask;
+        // The entry may move if its home is not cyclically within (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            map->entries[hole] = map->entries[i];
+            map->entries[i].key = NULL;
+            map->entries[i].value = NULL;
+            hole = i;
+        }
+    }
+}
+
+bool hashmap_remove(map_t *map, object_t *key, map_entry_t *old)
+{
+    old->key = NULL;
+    old->value = NULL;
+
+    map_entry_t *entry = hashmap_find(map, key);
+    if (entry == NULL)
+        return false;
+
+    *old = *entry;
+    hashmap_remove_slot(map, (size_t)(entry - map->entries));
+    return true;
+}
+
+void hashmap_free(map_t *map)
+{
+    if (map == NULL)
+        return;
+
+    free(map->entries);
+    map->entries = NULL;
+    map->count = 0;
+    map->capacity = 0;
+}
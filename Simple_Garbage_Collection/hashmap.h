@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "object.h"
+
+/**
+ * @brief Find the entry holding a key.
+ * 
+ * @param map Map to search.
+ * @param key Key to look up, compared with `object_equal`.
+ * @return Pointer to the entry, or NULL if the key is absent.
+ * 
+ * @note Integer and string keys are compared by value without a call, other
+ *       kinds by identity.
+ */
+map_entry_t *hashmap_find(map_t *map, object_t *key);
+
+/**
+ * @brief Insert or replace the value associated with a key.
+ * 
+ * @param map Map to update.
+ * @param key Key to insert.
+ * @param value Value to associate with the key.
+ * @param old Receives the replaced key/value when the key was present (key NULL otherwise).
+ * @return True if successful, false if allocation fails.
+ * 
+ * @note No reference counting is done here; the object models own that.
+ */
+bool hashmap_put(map_t *map, object_t *key, object_t *value, map_entry_t *old);
+
+/**
+ * @brief Remove a key from a map.
+ * 
+ * @param map Map to update.
+ * @param key Key to remove.
+ * @param old Receives the removed key/value (key NULL when absent).
+ * @return True if the key was present.
+ * 
+ * @note Uses backward-shift deletion, so the table never holds tombstones.
+ */
+bool hashmap_remove(map_t *map, object_t *key, map_entry_t *old);
+
+/**
+ * @brief Remove the entry stored at a slot.
+ * 
+ * @param map Map to update.
+ * @param slot Index of a slot in use.
+ */
+void hashmap_remove_slot(map_t *map, size_t slot);
+
+/**
+ * @brief Free the slots of a map, leaving it empty.
+ * 
+ * @param map Map to clear.
+ * 
+ * @note Keys and values are not released.
+ */
+void hashmap_free(map_t *map);
@@ -0,0 +1,559 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "object.h"
+#include "heap_dump.h"
+
+/**
+ * @file heap_analyze.c
+ * @brief Offline analyzer for the dumps written by `vm_heap_dump`.
+ * 
+ * Computes the dominator tree of the heap with the Lengauer-Tarjan algorithm
+ * and reports retained sizes: the bytes that would be freed if an object
+ * became unreachable. Every pass is iterative and runs in O(E log N) on flat
+ * arrays of 32-bit indices, so dumps of tens of millions of objects fit in memory.
+ * 
+ * Usage: `heap_analyze <dump> [top]`
+ */
+
+#define NONE UINT32_MAX
+
+/**
+ * @struct Heap
+ * @brief Heap graph read from a dump, as compressed adjacency lists.
+ * 
+ * Node `count` is a synthetic root with an edge to every root of the dump.
+ */
+typedef struct Heap {
+    uint32_t count;        /**< Number of objects */
+    uint64_t *ids;         /**< Address of each object */
+    uint8_t *kinds;        /**< Kind of each object */
+    uint64_t *sizes;       /**< Size of each object in bytes */
+    size_t *edge_start;    /**< First edge of each node, `count + 2` entries */
+    uint32_t *edges;       /**< Targets of the edges */
+    size_t *pred_start;    /**< First predecessor of each node, `count + 2` entries */
+    uint32_t *preds;       /**< Sources of the edges */
+    uint64_t roots;        /**< Number of roots */
+} heap_t;
+
+static const char *_kind_names[] = {
+    "INTEGER", "FLOAT", "STRING", "VECTOR3", "ARRAY", "INT_ARRAY",
+    "FLOAT_ARRAY", "VECTOR3I", "VECTOR3F", "MAP", "WEAK"};
+
+#define KIND_COUNT (sizeof(_kind_names) / sizeof(_kind_names[0]))
+
+/**
+ * @brief Allocate memory or exit.
+ * 
+ * @param size Number of bytes.
+ * @return The allocation.
+ */
+static void *_xmalloc(size_t size)
+{
+    void *ptr = malloc(size ? size : 1);
+    if (ptr == NULL)
+    {
+        fprintf(stderr, "heap_analyze: out of memory (%zu bytes)\n", size);
+        exit(1);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Read a little endian integer of `bytes` bytes.
+ * 
+ * @param in File to read from.
+ * @param bytes Width of the integer, at most 8.
+ * @return The value read.
+ */
+static uint64_t _read_le(FILE *in, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        value |= (uint64_t)(getc_unlocked(in) & 0xff) << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * @brief Read a little endian 64-bit integer.
+ * 
+ * @param in File to read from.
+ * @return The value read.
+ */
+static uint64_t _read_u64(FILE *in)
+{
+    return _read_le(in, 8);
+}
+
+/**
+ * @brief Read an unsigned LEB128 integer.
+ * 
+ * @param in File to read from.
+ * @return The value read, 0 at the end of the file.
+ */
+static uint64_t _read_varint(FILE *in)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    int byte;
+    do
+    {
+        byte = getc_unlocked(in);
+        if (byte == EOF)
+            return 0;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+/**
+ * @brief Hash an object address.
+ * 
+ * @param id Address to hash.
+ * @return Mixed bits of the address.
+ */
+static uint64_t _hash_id(uint64_t id)
+{
+    id ^= id >> 33;
+    id *= 0xff51afd7ed558ccdULL;
+    id ^= id >> 33;
+    return id;
+}
+
+/**
+ * @brief Build an open-addressing index from object address to node.
+ * 
+ * @param heap Heap being read, with every address filled in.
+ * @param mask Size of the index minus one, a power of two minus one.
+ * @return Slots holding a node, or NONE when empty.
+ */
+static uint32_t *_index_ids(const heap_t *heap, uint64_t mask)
+{
+    uint32_t *index = _xmalloc((mask + 1) * sizeof(uint32_t));
+    memset(index, 0xff, (mask + 1) * sizeof(uint32_t));
+    for (uint32_t v = 0; v < heap->count; v++)
+    {
+        uint64_t slot = _hash_id(heap->ids[v]) & mask;
+        while (index[slot] != NONE)
+        {
+            slot = (slot + 1) & mask;
+        }
+        index[slot] = v;
+    }
+    return index;
+}
+
+/**
+ * @brief Find the node of an object address.
+ * 
+ * @param heap Heap being read.
+ * @param index Index built by `_index_ids`.
+ * @param mask Size of the index minus one.
+ * @param id Address to look up.
+ * @return Node of the object, or NONE if the dump does not contain it.
+ */
+static uint32_t _find(const heap_t *heap, const uint32_t *index, uint64_t mask, uint64_t id)
+{
+    for (uint64_t slot = _hash_id(id) & mask; index[slot] != NONE; slot = (slot + 1) & mask)
+    {
+        if (heap->ids[index[slot]] == id)
+            return index[slot];
+    }
+    return NONE;
+}
+
+/**
+ * @brief Read a dump into a heap graph.
+ * 
+ * @param path Path of the dump.
+ * @param heap Graph to fill.
+ * @return True if successful, false if the file is not a valid dump.
+ */
+static bool _read_dump(const char *path, heap_t *heap)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL)
+        return false;
+
+    // The trailer sizes every table, so nothing grows while reading
+    char magic[4];
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, HEAP_DUMP_MAGIC, 4) != 0 ||
+        _read_le(in, 4) != HEAP_DUMP_VERSION || fseek(in, -(long)HEAP_DUMP_TRAILER_SIZE, SEEK_END) != 0)
+    {
+        fclose(in);
+        return false;
+    }
+    uint64_t objects = _read_u64(in);
+    uint64_t roots = _read_u64(in);
+    uint64_t edges = _read_u64(in);
+    if (objects >= NONE || fseek(in, 8, SEEK_SET) != 0)
+    {
+        fclose(in);
+        return false;
+    }
+
+    uint32_t n = (uint32_t)objects;
+    heap->count = n;
+    heap->roots = roots;
+    heap->ids = _xmalloc(n * sizeof(uint64_t));
+    heap->kinds = _xmalloc(n * sizeof(uint8_t));
+    heap->sizes = _xmalloc(n * sizeof(uint64_t));
+    heap->edge_start = _xmalloc((n + 2) * sizeof(size_t));
+    uint64_t *targets = _xmalloc((edges + roots) * sizeof(uint64_t));
+
+    uint32_t node = 0;
+    size_t edge = 0;
+    uint64_t root = 0;
+    for (int tag = getc_unlocked(in); tag != HEAP_DUMP_END; tag = getc_unlocked(in))
+    {
+        if (tag == HEAP_DUMP_OBJECT && node < n)
+        {
+            heap->ids[node] = _read_u64(in);
+            heap->kinds[node] = (uint8_t)getc_unlocked(in);
+            heap->sizes[node] = _read_varint(in);
+            uint64_t count = _read_varint(in);
+            heap->edge_start[node++] = edge;
+            for (uint64_t i = 0; i < count && edge < edges; i++)
+            {
+                targets[edge++] = _read_u64(in);
+            }
+        }
+        else if (tag == HEAP_DUMP_ROOT && root < roots)
+        {
+            getc_unlocked(in);
+            targets[edges + root++] = _read_u64(in);
+        }
+        else
+        {
+            free(targets);
+            fclose(in);
+            return false;
+        }
+    }
+    fclose(in);
+    heap->edge_start[n] = edges;
+    heap->edge_start[n + 1] = edges + roots;
+
+    // Translate addresses to nodes, dropping edges to objects outside the dump
+    uint64_t mask = 1;
+    while (mask < 2 * (uint64_t)n)
+    {
+        mask <<= 1;
+    }
+    mask--;
+    uint32_t *index = _index_ids(heap, mask);
+    heap->edges = _xmalloc((edges + roots) * sizeof(uint32_t));
+    for (size_t i = 0; i < edges + roots; i++)
+    {
+        heap->edges[i] = _find(heap, index, mask, targets[i]);
+    }
+    free(index);
+    free(targets);
+
+    // Predecessor lists, by counting then placing
+    heap->pred_start = _xmalloc((n + 2) * sizeof(size_t));
+    heap->preds = _xmalloc((edges + roots) * sizeof(uint32_t));
+    memset(heap->pred_start, 0, (n + 2) * sizeof(size_t));
+    for (size_t i = 0; i < edges + roots; i++)
+    {
+        if (heap->edges[i] != NONE)
+            heap->pred_start[heap->edges[i] + 1]++;
+    }
+    for (uint32_t v = 0; v <= n; v++)
+    {
+        heap->pred_start[v + 1] += heap->pred_start[v];
+    }
+    size_t *fill = _xmalloc((n + 1) * sizeof(size_t));
+    memcpy(fill, heap->pred_start, (n + 1) * sizeof(size_t));
+    for (uint32_t v = 0; v <= n; v++)
+    {
+        for (size_t i = heap->edge_start[v]; i < heap->edge_start[v + 1]; i++)
+        {
+            if (heap->edges[i] != NONE)
+                heap->preds[fill[heap->edges[i]]++] = v;
+        }
+    }
+    free(fill);
+    return true;
+}
+
+/**
+ * @struct LtNode
+ * @brief Lengauer-Tarjan state of one node, indexed and linked by preorder number.
+ * 
+ * Keeping the fields of a node together makes each visit a single cache miss
+ * on heaps far larger than the cache.
+ */
+typedef struct LtNode {
+    uint32_t parent;       /**< Parent in the DFS tree */
+    uint32_t semi;         /**< Semi-dominator */
+    uint32_t label;        /**< Node with the smallest semi-dominator on the path to `ancestor` */
+    uint32_t ancestor;     /**< Forest link, NONE for a tree root */
+    uint32_t idom;         /**< Immediate dominator */
+    uint32_t bucket;       /**< First node whose semi-dominator is this node */
+    uint32_t next;         /**< Next node in the same bucket */
+    uint32_t pad;          /**< Keeps nodes aligned to 32 bytes */
+} lt_node_t;
+
+/**
+ * @struct Dominators
+ * @brief Dominator tree of the nodes reachable from the synthetic root.
+ */
+typedef struct Dominators {
+    uint32_t *dfnum;       /**< Preorder number of each node, NONE if unreachable */
+    uint32_t *vertex;      /**< Node of each preorder number */
+    lt_node_t *lt;         /**< State of each preorder number, the root is 0 */
+    uint32_t *path;        /**< Scratch stack for `_compress` and the DFS */
+    size_t *iter;          /**< Next edge of each node on the DFS stack */
+    uint32_t reached;      /**< Number of nodes reached from the root */
+} dominators_t;
+
+/**
+ * @brief Compress the forest path above `v`, without recursion.
+ */
+static void _compress(dominators_t *d, uint32_t v)
+{
+    lt_node_t *lt = d->lt;
+    size_t top = 0;
+    while (lt[lt[v].ancestor].ancestor != NONE)
+    {
+        d->path[top++] = v;
+        v = lt[v].ancestor;
+    }
+
+    // Closest to the forest root first, as the recursive version unwinds
+    while (top > 0)
+    {
+        uint32_t x = d->path[--top];
+        uint32_t a = lt[x].ancestor;
+        if (lt[lt[a].label].semi < lt[lt[x].label].semi)
+            lt[x].label = lt[a].label;
+        lt[x].ancestor = lt[a].ancestor;
+    }
+}
+
+/**
+ * @brief Find the node with the smallest semi-dominator on the forest path above `v`.
+ */
+static uint32_t _eval(dominators_t *d, uint32_t v)
+{
+    if (d->lt[v].ancestor == NONE)
+        return v;
+
+    _compress(d, v);
+    return d->lt[v].label;
+}
+
+/**
+ * @brief Compute the immediate dominator of every node reachable from the synthetic root.
+ * 
+ * @param heap Heap graph.
+ * @param d Tree to fill, in preorder numbers.
+ */
+static void _dominators(const heap_t *heap, dominators_t *d)
+{
+    uint32_t nodes = heap->count + 1;
+    uint32_t root = heap->count;
+    d->dfnum = _xmalloc(nodes * sizeof(uint32_t));
+    d->vertex = _xmalloc(nodes * sizeof(uint32_t));
+    d->lt = _xmalloc(nodes * sizeof(lt_node_t));
+    d->path = _xmalloc(nodes * sizeof(uint32_t));
+    d->iter = _xmalloc(nodes * sizeof(size_t));
+    memset(d->dfnum, 0xff, nodes * sizeof(uint32_t));
+
+    // Preorder numbering with an explicit stack
+    size_t top = 0;
+    uint32_t reached = 0;
+    d->dfnum[root] = reached;
+    d->vertex[reached] = root;
+    d->lt[reached++].parent = NONE;
+    d->path[top] = root;
+    d->iter[top++] = heap->edge_start[root];
+    while (top > 0)
+    {
+        uint32_t v = d->path[top - 1];
+        if (d->iter[top - 1] == heap->edge_start[v + 1])
+        {
+            top--;
+            continue;
+        }
+        uint32_t w = heap->edges[d->iter[top - 1]++];
+        if (w == NONE || d->dfnum[w] != NONE)
+            continue;
+
+        d->dfnum[w] = reached;
+        d->vertex[reached] = w;
+        d->lt[reached++].parent = d->dfnum[v];
+        d->path[top] = w;
+        d->iter[top++] = heap->edge_start[w];
+    }
+    d->reached = reached;
+
+    lt_node_t *lt = d->lt;
+    for (uint32_t i = 0; i < reached; i++)
+    {
+        lt[i].semi = i;
+        lt[i].label = i;
+        lt[i].ancestor = NONE;
+        lt[i].idom = NONE;
+        lt[i].bucket = NONE;
+    }
+
+    for (uint32_t w = reached - 1; w > 0; w--)
+    {
+        uint32_t node = d->vertex[w];
+        for (size_t p = heap->pred_start[node]; p < heap->pred_start[node + 1]; p++)
+        {
+            uint32_t v = d->dfnum[heap->preds[p]];
+            if (v == NONE)
+                continue;
+
+            uint32_t u = _eval(d, v);
+            if (lt[u].semi < lt[w].semi)
+                lt[w].semi = lt[u].semi;
+        }
+
+        uint32_t s = lt[w].semi;
+        lt[w].next = lt[s].bucket;
+        lt[s].bucket = w;
+
+        uint32_t pw = lt[w].parent;
+        lt[w].ancestor = pw;
+        for (uint32_t v = lt[pw].bucket; v != NONE; v = lt[v].next)
+        {
+            uint32_t u = _eval(d, v);
+            lt[v].idom = lt[u].semi < lt[v].semi ? u : pw;
+        }
+        lt[pw].bucket = NONE;
+    }
+
+    for (uint32_t w = 1; w < reached; w++)
+    {
+        if (lt[w].idom != lt[w].semi)
+            lt[w].idom = lt[lt[w].idom].idom;
+    }
+}
+
+static const uint64_t *_sort_retained;
+
+/**
+ * @brief Order nodes by decreasing retained size, for `qsort`.
+ */
+static int _compare_retained(const void *a, const void *b)
+{
+    uint64_t x = _sort_retained[*(const uint32_t *)a];
+    uint64_t y = _sort_retained[*(const uint32_t *)b];
+    return (x < y) - (x > y);
+}
+
+/**
+ * @brief Name of an object kind, as in `object_kind_t`.
+ */
+static const char *_kind_name(uint8_t kind)
+{
+    return kind < KIND_COUNT ? _kind_names[kind] : "UNKNOWN";
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <dump> [top]\n", argv[0]);
+        return 2;
+    }
+    size_t top = argc > 2 ? strtoul(argv[2], NULL, 10) : 20;
+
+    heap_t heap;
+    if (!_read_dump(argv[1], &heap))
+    {
+        fprintf(stderr, "heap_analyze: %s is not a readable heap dump\n", argv[1]);
+        return 1;
+    }
+
+    dominators_t d;
+    _dominators(&heap, &d);
+
+    // Dominators are numbered before the nodes they dominate, so a reverse sweep sums subtrees
+    uint32_t root = heap.count;
+    uint64_t *retained = _xmalloc(d.reached * sizeof(uint64_t));
+    retained[0] = 0;
+    for (uint32_t i = 1; i < d.reached; i++)
+    {
+        retained[i] = heap.sizes[d.vertex[i]];
+    }
+    for (uint32_t i = d.reached - 1; i > 0; i--)
+    {
+        retained[d.lt[i].idom] += retained[i];
+    }
+
+    uint64_t total = 0;
+    size_t kind_count[KIND_COUNT + 1] = {0};
+    uint64_t kind_bytes[KIND_COUNT + 1] = {0};
+    for (uint32_t v = 0; v < heap.count; v++)
+    {
+        size_t kind = heap.kinds[v] < KIND_COUNT ? heap.kinds[v] : KIND_COUNT;
+        total += heap.sizes[v];
+        kind_count[kind]++;
+        kind_bytes[kind] += heap.sizes[v];
+    }
+
+    printf("objects %u, roots %llu, edges %zu\n", heap.count,
+           (unsigned long long)heap.roots, heap.edge_start[root]);
+    printf("heap %llu bytes, reachable %u objects / %llu bytes\n", (unsigned long long)total,
+           d.reached - 1, (unsigned long long)retained[0]);
+
+    printf("\n%-12s %12s %16s\n", "kind", "count", "bytes");
+    for (size_t k = 0; k <= KIND_COUNT; k++)
+    {
+        if (kind_count[k] > 0)
+            printf("%-12s %12zu %16llu\n", _kind_name((uint8_t)k),
+                   kind_count[k], (unsigned long long)kind_bytes[k]);
+    }
+
+    // Largest retainers among reachable objects
+    uint32_t live = d.reached - 1;
+    uint32_t *order = _xmalloc(live * sizeof(uint32_t));
+    for (uint32_t i = 0; i < live; i++)
+    {
+        order[i] = i + 1;
+    }
+    _sort_retained = retained;
+    qsort(order, live, sizeof(uint32_t), _compare_retained);
+
+    printf("\n%-18s %-12s %12s %16s  %s\n", "object", "kind", "self", "retained", "dominator");
+    for (uint32_t i = 0; i < live && i < top; i++)
+    {
+        uint32_t v = d.vertex[order[i]];
+        uint32_t dom = d.vertex[d.lt[order[i]].idom];
+        printf("0x%016llx %-12s %12llu %16llu  ", (unsigned long long)heap.ids[v],
+               _kind_name(heap.kinds[v]), (unsigned long long)heap.sizes[v],
+               (unsigned long long)retained[order[i]]);
+        if (dom == root)
+            printf("(root)\n");
+        else
+            printf("0x%016llx\n", (unsigned long long)heap.ids[dom]);
+    }
+
+    free(order);
+    free(retained);
+    free(d.dfnum);
+    free(d.vertex);
+    free(d.lt);
+    free(d.path);
+    free(d.iter);
+    free(heap.ids);
+    free(heap.kinds);
+    free(heap.sizes);
+    free(heap.edge_start);
+    free(heap.edges);
+    free(heap.pred_start);
+    free(heap.preds);
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include <stdio.h>
+
+#include "heap_dump.h"
+
+/**
+ * @brief Write a little endian 64-bit integer.
+ * 
+ * @param out File to write to.
+ * @param value Value to write.
+ */
+static void _write_u64(FILE *out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        fputc((int)(value >> (8 * i)) & 0xff, out);
+    }
+}
+
+/**
+ * @brief Write an unsigned LEB128 integer.
+ * 
+ * @param out File to write to.
+ * @param value Value to write.
+ */
+static void _write_varint(FILE *out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc((int)(value & 0x7f) | 0x80, out);
+        value >>= 7;
+    }
+    fputc((int)value, out);
+}
+
+/**
+ * @brief Count the strong references held by an object.
+ * 
+ * @param obj Object to inspect.
+ * @return Number of non-NULL outgoing edges.
+ */
+static size_t _edge_count(object_t *obj)
+{
+    size_t count = 0;
+    switch (obj->kind)
+    {
+    case VECTOR3:
+        count += obj->data.v_vector3.x != NULL;
+        count += obj->data.v_vector3.y != NULL;
+        count += obj->data.v_vector3.z != NULL;
+        break;
+    case ARRAY:
+        for (size_t i = 0; i < obj->data.v_array.size; i++)
+        {
+            count += obj->data.v_array.elements[i] != NULL;
+        }
+        break;
+    case MAP:
+        for (size_t i = 0; i < obj->data.v_map.capacity; i++)
+        {
+            if (obj->data.v_map.entries[i].key != NULL)
+            {
+                count += obj->data.v_map.weak_keys ? 1 : 2;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return count;
+}
+
+/**
+ * @brief Write an object record.
+ * 
+ * @param out File to write to.
+ * @param obj Object to write.
+ * @return Number of edges written.
+ */
+static size_t _write_object(FILE *out, object_t *obj)
+{
+    size_t count = _edge_count(obj);
+    fputc(HEAP_DUMP_OBJECT, out);
+    _write_u64(out, (uint64_t)(uintptr_t)obj);
+    fputc(obj->kind, out);
+    _write_varint(out, object_size(obj));
+    _write_varint(out, count);
+
+    switch (obj->kind)
+    {
+    case VECTOR3:
+    {
+        object_t *fields[] = {obj->data.v_vector3.x, obj->data.v_vector3.y, obj->data.v_vector3.z};
+        for (int i = 0; i < 3; i++)
+        {
+            if (fields[i] != NULL)
+                _write_u64(out, (uint64_t)(uintptr_t)fields[i]);
+        }
+        break;
+    }
+    case ARRAY:
+        for (size_t i = 0; i < obj->data.v_array.size; i++)
+        {
+            if (obj->data.v_array.elements[i] != NULL)
+                _write_u64(out, (uint64_t)(uintptr_t)obj->data.v_array.elements[i]);
+        }
+        break;
+    case MAP:
+        for (size_t i = 0; i < obj->data.v_map.capacity; i++)
+        {
+            map_entry_t *entry = &obj->data.v_map.entries[i];
+            if (entry->key == NULL)
+                continue;
+
+            if (!obj->data.v_map.weak_keys)
+                _write_u64(out, (uint64_t)(uintptr_t)entry->key);
+            _write_u64(out, (uint64_t)(uintptr_t)entry->value);
+        }
+        break;
+    default:
+        break;
+    }
+    return count;
+}
+
+/**
+ * @brief Write a root record.
+ * 
+ * @param out File to write to.
+ * @param kind Where the root comes from.
+ * @param obj Object referenced by the root.
+ */
+static void _write_root(FILE *out, heap_dump_root_t kind, object_t *obj)
+{
+    fputc(HEAP_DUMP_ROOT, out);
+    fputc(kind, out);
+    _write_u64(out, (uint64_t)(uintptr_t)obj);
+}
+
+bool vm_heap_dump(vm_t *vm, const char *path)
+{
+    if (vm == NULL || path == NULL)
+        return false;
+
+    FILE *out = fopen(path, "wb");
+    if (out == NULL)
+        return false;
+
+    uint64_t objects = 0;
+    uint64_t roots = 0;
+    uint64_t edges = 0;
+    fwrite(HEAP_DUMP_MAGIC, 1, 4, out);
+    for (int i = 0; i < 4; i++)
+    {
+        fputc((HEAP_DUMP_VERSION >> (8 * i)) & 0xff, out);
+    }
+
+    stack_t *spaces[] = {vm->objects, vm->large_objects};
+    for (int s = 0; s < 2; s++)
+    {
+        for (size_t i = 0; i < spaces[s]->count; i++)
+        {
+            edges += _write_object(out, spaces[s]->data[i]);
+            objects++;
+        }
+    }
+
+    for (size_t i = 0; i < vm->frames->count; i++)
+    {
+        frame_t *frame = vm->frames->data[i];
+        for (size_t j = 0; j < frame->reference->count; j++)
+        {
+            _write_root(out, HEAP_ROOT_FRAME, frame->reference->data[j]);
+            roots++;
+        }
+    }
+
+    // Same walk as the collector: blocks before the current one are full
+    for (size_t b = 0; b <= vm->handles.block && b < vm->handle_blocks->count; b++)
+    {
+        object_t **slots = vm->handle_blocks->data[b];
+        size_t used = b == vm->handles.block ? vm->handles.used : HANDLE_BLOCK_SLOTS;
+        for (size_t i = 0; i < used; i++)
+        {
+            if (slots[i] != NULL)
+            {
+                _write_root(out, HEAP_ROOT_HANDLE, slots[i]);
+                roots++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < vm->finalize_queue->count; i++)
+    {
+        finalizer_entry_t *entry = vm->finalize_queue->data[i];
+        _write_root(out, HEAP_ROOT_FINALIZER, entry->obj);
+        roots++;
+    }
+
+    fputc(HEAP_DUMP_END, out);
+    _write_u64(out, objects);
+    _write_u64(out, roots);
+    _write_u64(out, edges);
+
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vm.h"
+
+/**
+ * @brief Heap dump file format.
+ * 
+ * A dump is a header followed by a stream of tagged records and a fixed-size
+ * trailer, so it can be written in a single pass and a reader can size its
+ * tables by seeking to the trailer first. Fixed-width integers are little
+ * endian; `varint` is an unsigned LEB128 integer.
+ * 
+ * - Header: the 4 bytes of `HEAP_DUMP_MAGIC`, then `u32` `HEAP_DUMP_VERSION`.
+ * - `HEAP_DUMP_OBJECT`: `u64` id (the object's address), `u8` kind,
+ *   `varint` size in bytes (see `object_size`), `varint` edge count and one
+ *   `u64` id per outgoing strong reference.
+ * - `HEAP_DUMP_ROOT`: `u8` root kind (`heap_dump_root_t`), `u64` id.
+ * - `HEAP_DUMP_END`, then the trailer: `u64` object count, `u64` root count
+ *   and `u64` edge count.
+ */
+#define HEAP_DUMP_MAGIC "GCHD"
+#define HEAP_DUMP_VERSION 1
+#define HEAP_DUMP_TRAILER_SIZE (3 * sizeof(uint64_t))
+
+/**
+ * @enum HeapDumpTag
+ * Tag starting each record of a heap dump.
+ */
+typedef enum HeapDumpTag {
+    HEAP_DUMP_END,         /**< Last record, followed by the trailer */
+    HEAP_DUMP_OBJECT,      /**< A tracked object and its edges */
+    HEAP_DUMP_ROOT         /**< A reference from outside the heap */
+} heap_dump_tag_t;
+
+/**
+ * @enum HeapDumpRoot
+ * Where a root of a heap dump comes from.
+ */
+typedef enum HeapDumpRoot {
+    HEAP_ROOT_FRAME,       /**< Reference held by a stack frame */
+    HEAP_ROOT_HANDLE,      /**< Handle slot */
+    HEAP_ROOT_FINALIZER    /**< Object waiting for its finalizer */
+} heap_dump_root_t;
+
+/**
+ * @brief Write a snapshot of every object tracked by the virtual machine to a file.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param path Path of the file to create.
+ * @return True if successful, false if the file cannot be written.
+ * 
+ * @note Nothing is allocated on the GC heap, and the VM is not modified. Weak
+ *       references are not edges, and ephemeron maps only reference their values.
+ */
+bool vm_heap_dump(vm_t *vm, const char *path);
@@ -0,0 +1,282 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <execinfo.h>
+
+#include "heap_profile.h"
+#include "ptrmap.h"
+
+/**
+ * @struct HeapSample
+ * @brief Call stack of a sampled allocation.
+ */
+typedef struct HeapSample
+{
+    size_t bytes;                          /**< Estimated bytes the sample stands for */
+    int depth;                             /**< Number of frames */
+    void *frames[HEAP_PROFILE_MAX_DEPTH];  /**< Return addresses, innermost first */
+} heap_sample_t;
+
+static bool _active = false;
+static size_t _mean_bytes = 0;
+static int64_t _until_sample = 0;
+static uint64_t _rng = 0x2545f4914f6cdd1dULL;
+static ptrmap_t _samples = {0};
+static size_t _live_bytes = 0;
+
+/**
+ * @brief Draw a uniform random number.
+ * 
+ * @return Value in (0, 1].
+ */
+static double _uniform(void)
+{
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 7;
+    _rng ^= _rng << 17;
+    return (double)((_rng >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Natural logarithm, so the library does not need libm.
+ * 
+ * @param x Positive value.
+ * @return ln(x), accurate to about 1e-7.
+ */
+static double _log(double x)
+{
+    int exponent = 0;
+    while (x >= 2.0)
+    {
+        x *= 0.5;
+        exponent++;
+    }
+    while (x < 1.0)
+    {
+        x *= 2.0;
+        exponent--;
+    }
+
+    // ln(x) = 2 atanh(z) with z = (x - 1) / (x + 1) <= 1/3 for x in [1, 2)
+    double z = (x - 1.0) / (x + 1.0);
+    double z2 = z * z;
+    double series = z * (1.0 + z2 * (1.0 / 3 + z2 * (1.0 / 5 + z2 * (1.0 / 7 + z2 * (1.0 / 9 + z2 / 11)))));
+    return 2.0 * series + exponent * 0.6931471805599453;
+}
+
+/**
+ * @brief Negative exponential, so the library does not need libm.
+ * 
+ * @param x Non-negative value.
+ * @return exp(-x).
+ */
+static double _exp_neg(double x)
+{
+    if (x > 700.0)
+        return 0.0;
+
+    // exp(-x) = 2^-k * exp(-r), with r in [0, ln 2)
+    int k = (int)(x / 0.6931471805599453);
+    double r = x - k * 0.6931471805599453;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int i = 1; i <= 12; i++)
+    {
+        term *= -r / i;
+        sum += term;
+    }
+    while (k-- > 0)
+    {
+        sum *= 0.5;
+    }
+    return sum;
+}
+
+/**
+ * @brief Draw the number of bytes until the next sample.
+ * 
+ * @return Exponentially distributed distance of mean `_mean_bytes`.
+ */
+static int64_t _next_interval(void)
+{
+    if (_mean_bytes == 0)
+        return 0;
+
+    return (int64_t)(-_log(_uniform()) * (double)_mean_bytes) + 1;
+}
+
+/**
+ * @brief Estimate how many bytes a sample of `size` bytes stands for.
+ * 
+ * @param size Size of the sampled allocation.
+ * @return `size` divided by its probability of being sampled, 1 - exp(-size / mean).
+ */
+static size_t _estimate(size_t size)
+{
+    if (_mean_bytes == 0)
+        return size;
+
+    double probability = 1.0 - _exp_neg((double)size / (double)_mean_bytes);
+    return (size_t)((double)size / probability + 0.5);
+}
+
+void heap_profile_start(size_t sample_bytes)
+{
+    _mean_bytes = sample_bytes;
+    _until_sample = _next_interval();
+    _active = true;
+}
+
+void heap_profile_stop(void)
+{
+    _active = false;
+}
+
+void heap_profile_reset(void)
+{
+    for (size_t i = 0; i < _samples.capacity; i++)
+    {
+        if (_samples.entries[i].key != NULL)
+        {
+            free(_samples.entries[i].value);
+        }
+    }
+    ptrmap_free(&_samples);
+    _live_bytes = 0;
+}
+
+void heap_profile_sample(object_t *obj)
+{
+    if (!_active || obj == NULL)
+        return;
+
+    size_t size = object_size(obj);
+    _until_sample -= (int64_t)size;
+    if (_until_sample > 0)
+        return;
+    _until_sample = _next_interval();
+
+    heap_sample_t *sample = malloc(sizeof(heap_sample_t));
+    if (sample == NULL)
+        return;
+
+    // Drop this function's own frame
+    void *frames[HEAP_PROFILE_MAX_DEPTH + 1];
+    int depth = backtrace(frames, HEAP_PROFILE_MAX_DEPTH + 1);
+    sample->depth = depth > 1 ? depth - 1 : 0;
+    memcpy(sample->frames, frames + 1, sample->depth * sizeof(void *));
+    sample->bytes = _estimate(size);
+
+    // A stale sample at this address would belong to an object freed without profiling
+    heap_sample_t *stale = ptrmap_remove(&_samples, obj);
+    if (stale != NULL)
+    {
+        _live_bytes -= stale->bytes;
+        free(stale);
+    }
+    if (!ptrmap_put(&_samples, obj, sample))
+    {
+        free(sample);
+        return;
+    }
+    obj->flags |= OBJECT_FLAG_SAMPLED;
+    _live_bytes += sample->bytes;
+}
+
+void heap_profile_release(object_t *obj)
+{
+    obj->flags &= ~OBJECT_FLAG_SAMPLED;
+    heap_sample_t *sample = ptrmap_remove(&_samples, obj);
+    if (sample != NULL)
+    {
+        _live_bytes -= sample->bytes;
+        free(sample);
+    }
+}
+
+size_t heap_profile_live_bytes(void)
+{
+    return _live_bytes;
+}
+
+/**
+ * @brief Order samples by call stack, for `qsort`.
+ */
+static int _compare_stacks(const void *a, const void *b)
+{
+    const heap_sample_t *x = *(const heap_sample_t *const *)a;
+    const heap_sample_t *y = *(const heap_sample_t *const *)b;
+    if (x->depth != y->depth)
+        return x->depth < y->depth ? -1 : 1;
+    return memcmp(x->frames, y->frames, x->depth * sizeof(void *));
+}
+
+/**
+ * @brief Write the function name of a frame described by `backtrace_symbols`.
+ * 
+ * @param out File to write to.
+ * @param symbol Description such as `./vm(new_integer+0x1f) [0x55d0c3a1b2c4]`.
+ * @param frame Return address, written when the description has no name.
+ */
+static void _write_frame(FILE *out, const char *symbol, void *frame)
+{
+    const char *name = symbol != NULL ? strchr(symbol, '(') : NULL;
+    if (name != NULL)
+    {
+        size_t length = strcspn(name + 1, "+)");
+        if (length > 0)
+        {
+            fwrite(name + 1, 1, length, out);
+            return;
+        }
+    }
+    fprintf(out, "%p", frame);
+}
+
+size_t heap_profile_write_folded(FILE *out)
+{
+    if (out == NULL || _samples.count == 0)
+        return 0;
+
+    heap_sample_t **live = malloc(_samples.count * sizeof(heap_sample_t *));
+    if (live == NULL)
+        return 0;
+
+    size_t count = 0;
+    for (size_t i = 0; i < _samples.capacity; i++)
+    {
+        if (_samples.entries[i].key != NULL)
+        {
+            live[count++] = _samples.entries[i].value;
+        }
+    }
+    qsort(live, count, sizeof(heap_sample_t *), _compare_stacks);
+
+    size_t stacks = 0;
+    for (size_t i = 0; i < count;)
+    {
+        // Merge the samples sharing this stack
+        size_t bytes = 0;
+        size_t j = i;
+        for (; j < count && _compare_stacks(&live[i], &live[j]) == 0; j++)
+        {
+            bytes += live[j]->bytes;
+        }
+
+        heap_sample_t *sample = live[i];
+        char **symbols = backtrace_symbols(sample->frames, sample->depth);
+        for (int f = sample->depth - 1; f >= 0; f--)
+        {
+            _write_frame(out, symbols != NULL ? symbols[f] : NULL, sample->frames[f]);
+            fputc(f > 0 ? ';' : ' ', out);
+        }
+        fprintf(out, "%zu\n", bytes);
+        free(symbols);
+
+        stacks++;
+        i = j;
+    }
+
+    free(live);
+    return stacks;
+}
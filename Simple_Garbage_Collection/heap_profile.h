@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "object.h"
+
+/**
+ * @brief Deepest call stack kept for a sampled allocation.
+ */
+#define HEAP_PROFILE_MAX_DEPTH 32
+
+/**
+ * @brief Start sampling allocations, about one per `sample_bytes` bytes allocated.
+ * 
+ * Allocations are sampled as a Poisson process over the bytes allocated: the
+ * distance to the next sample is drawn from an exponential distribution of
+ * mean `sample_bytes`, so large objects are more likely to be sampled and
+ * sampling cannot lock onto a periodic allocation pattern. Each sample records
+ * the call stack of the allocation and stays live until the object is freed,
+ * by `object_free` or by a mark-and-sweep collection.
+ * 
+ * @param sample_bytes Mean number of bytes between samples, 0 to sample every allocation.
+ * 
+ * @note Samples taken before are kept; the profiler is not thread safe. Objects
+ *       are sized when created, so later growth of arrays and maps is not seen.
+ */
+void heap_profile_start(size_t sample_bytes);
+
+/**
+ * @brief Stop sampling new allocations.
+ * 
+ * @note Live samples are kept, and still dropped when their object is freed.
+ */
+void heap_profile_stop(void);
+
+/**
+ * @brief Drop every live sample.
+ */
+void heap_profile_reset(void);
+
+/**
+ * @brief Offer a newly created object to the profiler.
+ * 
+ * @param obj Fully initialised object, whose `object_size` is the allocation size.
+ * 
+ * @note Called by the `new_*` and `new_*_ms` constructors; does nothing unless started.
+ */
+void heap_profile_sample(object_t *obj);
+
+/**
+ * @brief Forget the sample of an object being freed.
+ * 
+ * @param obj Object carrying OBJECT_FLAG_SAMPLED.
+ */
+void heap_profile_release(object_t *obj);
+
+/**
+ * @brief Estimate the live bytes allocated since sampling started.
+ * 
+ * @return Sum of the estimated bytes of every live sample.
+ */
+size_t heap_profile_live_bytes(void);
+
+/**
+ * @brief Write the estimated live bytes of each allocation call stack in folded-stack format.
+ * 
+ * Each line is `outermost;...;allocating_function bytes`, the input format of
+ * `flamegraph.pl` and `speedscope`. Functions are named from the dynamic
+ * symbol table, so link with `-rdynamic` to see names rather than addresses.
+ * 
+ * @param out File to write to.
+ * @return Number of distinct stacks written.
+ */
+size_t heap_profile_write_folded(FILE *out);
@@ -1,10 +1,19 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "munit.h"
 #include "vm.h"
 #include "object_rc.h"
 #include "object_ms.h"
+#include "buffer.h"
+#include "rope.h"
+#include "heap_dump.h"
+#include "heap_profile.h"
+#include "event_ring.h"
+#include "recorder.h"
+#include "replayer.h"
 
 /*MSVC warning about conditional expressions being constant*/
 #if defined(_MSC_VER)
@@ -99,7 +108,7 @@ static MunitResult test_string_add(const MunitParameter params[], void *data)
     munit_assert_not_null(greeting);
     munit_assert_int(greeting->kind, ==, STRING);
     munit_assert_string_equal(
-        greeting->data.v_string, "hello, world");
+        string_chars(greeting), "hello, world");
 
     object_free(&hello);
     object_free(&world);
@@ -120,7 +129,7 @@ static MunitResult test_string_add_self(const MunitParameter params[], void *dat
     munit_assert_not_null(result);
     munit_assert_int(result->kind, ==, STRING);
     munit_assert_string_equal(
-        result->data.v_string,
+        string_chars(result),
         "(repeated)(repeated)");
 
     object_free(&repeated);
@@ -217,7 +226,7 @@ static MunitResult test_array_add(const MunitParameter params[], void *data)
 
     object_t *third = array_get(result, 2);
     munit_assert_not_null(third);
-    munit_assert_string_equal(third->data.v_string, "hi");
+    munit_assert_string_equal(string_chars(third), "hi");
 
     // Check for deeply nested reference
     munit_assert_int(one->refcount, ==, 5);
@@ -244,6 +253,1329 @@ static MunitResult test_array_add(const MunitParameter params[], void *data)
     return MUNIT_OK;
 }
 
+static MunitResult test_add_consume(const MunitParameter params[], void *data)
+{
+    object_t *acc = new_integer(0);
+    object_t *one = new_integer(1);
+    void *acc_k = acc;
+    for (int i = 0; i < 10; i++)
+    {
+        munit_assert_not_null(add_consume(&acc, one));
+    }
+    // Uniquely owned accumulator is updated in place
+    munit_assert_ptr_equal(acc, acc_k);
+    munit_assert_int(acc->data.v_int, ==, 10);
+    munit_assert_int(one->refcount, ==, 1);
+
+    object_t *s = new_string("ab");
+    munit_assert_not_null(add_consume(&s, s));
+    munit_assert_string_equal(string_chars(s), "abab");
+
+    // Shared accumulator falls back to a new object
+    object_t *shared = s;
+    add_reference(shared);
+    object_t *cd = new_string("cd");
+    munit_assert_not_null(add_consume(&s, cd));
+    munit_assert_ptr_not_equal(s, shared);
+    munit_assert_string_equal(string_chars(s), "ababcd");
+    munit_assert_string_equal(string_chars(shared), "abab");
+    munit_assert_int(shared->refcount, ==, 1);
+
+    // Incompatible kinds leave the accumulator untouched
+    munit_assert_null(add_consume(&acc, s));
+    munit_assert_ptr_equal(acc, acc_k);
+
+    // A failing vector component leaves every component untouched
+    object_t *x = new_integer(1);
+    object_t *y = new_array(1);
+    object_t *z = new_integer(3);
+    array_set(y, 0, one);
+    object_t *vec = new_vector3(x, y, z);
+    object_t *dx = new_integer(10);
+    object_t *huge = new_array(1);
+    object_t *dz = new_integer(30);
+    array_set(huge, 0, one);
+    object_t *delta = new_vector3(dx, huge, dz);
+    release_reference(&y);
+    release_reference(&huge);
+    release_reference(&dx);
+    release_reference(&dz);
+    release_reference(&x);
+    release_reference(&z);
+    x = vec->data.v_vector3.x;
+    y = vec->data.v_vector3.y;
+    huge = delta->data.v_vector3.y;
+    huge->data.v_array.size = SIZE_MAX / 16; // Too large to allocate
+    munit_assert_null(add_consume(&vec, delta));
+    huge->data.v_array.size = 1;
+    munit_assert_ptr_equal(vec->data.v_vector3.x, x);
+    munit_assert_ptr_equal(vec->data.v_vector3.y, y);
+    munit_assert_int(vec->data.v_vector3.x->data.v_int, ==, 1);
+    munit_assert_int(vec->data.v_vector3.z->data.v_int, ==, 3);
+    munit_assert_size(y->data.v_array.size, ==, 1);
+
+    // Once it can succeed, numbers are updated in place and the rest rebuilt
+    munit_assert_not_null(add_consume(&vec, delta));
+    munit_assert_ptr_equal(vec->data.v_vector3.x, x);
+    munit_assert_int(x->data.v_int, ==, 11);
+    munit_assert_size(vec->data.v_vector3.y->data.v_array.size, ==, 2);
+    munit_assert_int(vec->data.v_vector3.z->data.v_int, ==, 33);
+    object_free(&vec);
+    object_free(&delta);
+    munit_assert_int(one->refcount, ==, 1);
+
+    object_free(&acc);
+    object_free(&one);
+    object_free(&s);
+    object_free(&shared);
+    object_free(&cd);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_copy_on_write(const MunitParameter params[], void *data)
+{
+    object_t *one = new_integer(1);
+    object_t *two = new_integer(2);
+    object_t *array = new_array(2);
+    array_set(array, 0, one);
+    array_set(array, 1, one);
+    munit_assert_int(one->refcount, ==, 3);
+
+    // Copies share the elements buffer and its references
+    object_t *copy = object_copy(array);
+    munit_assert_ptr_equal(copy->data.v_array.elements, array->data.v_array.elements);
+    munit_assert_true(buffer_is_shared(array->data.v_array.elements));
+    munit_assert_int(one->refcount, ==, 3);
+
+    // Mutating the copy gives it a private buffer
+    munit_assert_true(array_set(copy, 1, two));
+    munit_assert_ptr_not_equal(copy->data.v_array.elements, array->data.v_array.elements);
+    munit_assert_false(buffer_is_shared(array->data.v_array.elements));
+    munit_assert_ptr_equal(array_get(array, 1), one);
+    munit_assert_ptr_equal(array_get(copy, 1), two);
+    munit_assert_int(one->refcount, ==, 4);
+    munit_assert_int(two->refcount, ==, 2);
+
+    // Derived strings share storage with their source
+    object_t *hello = new_string("hello");
+    object_t *empty = new_string("");
+    object_t *derived = add(hello, empty);
+    munit_assert_ptr_equal(derived->data.v_string.chars, hello->data.v_string.chars);
+    munit_assert_not_null(add_consume(&derived, hello));
+    munit_assert_string_equal(string_chars(derived), "hellohello");
+    munit_assert_string_equal(string_chars(hello), "hello");
+
+    object_free(&copy);
+    object_free(&array);
+    munit_assert_int(one->refcount, ==, 1);
+    munit_assert_int(two->refcount, ==, 1);
+
+    object_free(&one);
+    object_free(&two);
+    object_free(&hello);
+    object_free(&empty);
+    object_free(&derived);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_string_rope(const MunitParameter params[], void *data)
+{
+    object_t *piece = new_string("0123456789");
+    object_t *acc = new_string("");
+    for (int i = 0; i < 2000; i++)
+    {
+        object_t *next = add(acc, piece);
+        munit_assert_not_null(next);
+        release_reference(&acc);
+        acc = next;
+    }
+    munit_assert_not_null(acc->data.v_string.rope);
+    munit_assert_null(acc->data.v_string.chars);
+    munit_assert_int(length(acc), ==, 20000);
+    // Rebalancing keeps the tree shallow
+    munit_assert_size(acc->data.v_string.rope->depth, <=, 32);
+    munit_assert_char(rope_index(acc->data.v_string.rope, 12345), ==, '5');
+
+    munit_assert_not_null(add_consume(&acc, piece));
+    munit_assert_int(length(acc), ==, 20010);
+
+    // Flattened lazily on first contiguous access
+    char *chars = string_chars(acc);
+    munit_assert_not_null(chars);
+    munit_assert_null(acc->data.v_string.rope);
+    munit_assert_size(strlen(chars), ==, 20010);
+    munit_assert_memory_equal(10, chars + 19990, "0123456789");
+
+    object_free(&acc);
+    object_free(&piece);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_string_counted(const MunitParameter params[], void *data)
+{
+    // Embedded NULs are part of the contents
+    object_t *bin = new_string_len("a\0b", 3);
+    munit_assert_int(length(bin), ==, 3);
+    munit_assert_size(string_length(bin), ==, 3);
+
+    object_t *long_a = new_string_len("0123456789012345678901234567890123456789", 40);
+    object_t *long_b = new_string_len("abcdefghijklmnopqrstuvwxyzabcdefghijklmn", 40);
+    object_t *rope = add(long_a, long_b);
+    munit_assert_not_null(rope->data.v_string.rope);
+    munit_assert_int(length(rope), ==, 80);
+
+    object_t *flat = new_string("0123456789012345678901234567890123456789"
+                                "abcdefghijklmnopqrstuvwxyzabcdefghijklmn");
+    // Hashing a rope does not flatten it
+    munit_assert_size(string_hash(rope), ==, string_hash(flat));
+    munit_assert_not_null(rope->data.v_string.rope);
+    munit_assert_true(string_equal(rope, flat));
+    munit_assert_false(string_equal(long_a, long_b));
+    munit_assert_false(string_equal(bin, long_a));
+    munit_assert_size(string_hash(bin), !=, string_hash(long_a));
+
+    object_free(&bin);
+    object_free(&long_a);
+    object_free(&long_b);
+    object_free(&rope);
+    object_free(&flat);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_packed_array_add(const MunitParameter params[], void *data)
+{
+    object_t *ints = new_int_array(13);
+    object_t *floats = new_float_array(13);
+    int *iv = ints->data.v_packed.values;
+    float *fv = floats->data.v_packed.values;
+    for (int i = 0; i < 13; i++)
+    {
+        iv[i] = i;
+        fv[i] = i * 0.5f;
+    }
+
+    object_t *doubled = add(ints, ints);
+    munit_assert_not_null(doubled);
+    munit_assert_int(doubled->kind, ==, INT_ARRAY);
+    munit_assert_int(length(doubled), ==, 13);
+    munit_assert_int(((int *)doubled->data.v_packed.values)[12], ==, 24);
+
+    object_t *mixed = add(floats, ints);
+    munit_assert_not_null(mixed);
+    munit_assert_int(mixed->kind, ==, FLOAT_ARRAY);
+    munit_assert_float(((float *)mixed->data.v_packed.values)[11], ==, 16.5f);
+
+    // Sizes must match for element-wise addition
+    object_t *short_ints = new_int_array(3);
+    munit_assert_null(add(ints, short_ints));
+
+    // Uniquely owned accumulator is widened in place
+    void *doubled_k = doubled;
+    munit_assert_not_null(add_consume(&doubled, floats));
+    munit_assert_ptr_equal(doubled, doubled_k);
+    munit_assert_int(doubled->kind, ==, FLOAT_ARRAY);
+    munit_assert_float(((float *)doubled->data.v_packed.values)[12], ==, 30.0f);
+
+    object_free(&ints);
+    object_free(&floats);
+    object_free(&doubled);
+    object_free(&mixed);
+    object_free(&short_ints);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_packed_vector3_add(const MunitParameter params[], void *data)
+{
+    object_t *vi = new_vector3i(1, 2, 3);
+    object_t *vf = new_vector3f(0.5f, 1.5f, 2.5f);
+
+    object_t *sum_i = add(vi, vi);
+    munit_assert_not_null(sum_i);
+    munit_assert_int(sum_i->kind, ==, VECTOR3I);
+    munit_assert_int(sum_i->data.v_packed_vector3.i[0], ==, 2);
+    munit_assert_int(sum_i->data.v_packed_vector3.i[2], ==, 6);
+
+    object_t *sum_f = add(vi, vf);
+    munit_assert_not_null(sum_f);
+    munit_assert_int(sum_f->kind, ==, VECTOR3F);
+    munit_assert_int(length(sum_f), ==, 3);
+    munit_assert_float(sum_f->data.v_packed_vector3.f[0], ==, 1.5f);
+    munit_assert_float(sum_f->data.v_packed_vector3.f[1], ==, 3.5f);
+    munit_assert_float(sum_f->data.v_packed_vector3.f[2], ==, 5.5f);
+
+    munit_assert_not_null(add_consume(&sum_f, vf));
+    munit_assert_float(sum_f->data.v_packed_vector3.f[2], ==, 8.0f);
+
+    // Unboxed vectors do not mix with boxed ones
+    object_t *one = new_integer(1);
+    object_t *boxed = new_vector3(one, one, one);
+    munit_assert_null(add(vi, boxed));
+
+    object_free(&boxed);
+    object_free(&one);
+    object_free(&vi);
+    object_free(&vf);
+    object_free(&sum_i);
+    object_free(&sum_f);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_add_batch(const MunitParameter params[], void *data)
+{
+    object_t *one = new_integer(1);
+    object_t *half = new_float(0.5f);
+    object_t *vi = new_vector3i(1, 2, 3);
+    object_t *vf = new_vector3f(0.5f, 0.5f, 0.5f);
+    object_t *hi = new_string("hi");
+
+    object_t *a[] = {one, half, vi, half, hi, vf, one, NULL};
+    object_t *b[] = {one, one, vi, one, hi, vi, hi, one};
+    object_t *out[8];
+
+    munit_assert_size(add_batch(out, a, b, 8), ==, 6);
+    munit_assert_int(out[0]->kind, ==, INTEGER);
+    munit_assert_int(out[0]->data.v_int, ==, 2);
+    munit_assert_float(out[1]->data.v_float, ==, 1.5f);
+    munit_assert_int(out[2]->kind, ==, VECTOR3I);
+    munit_assert_int(out[2]->data.v_packed_vector3.i[2], ==, 6);
+    munit_assert_float(out[3]->data.v_float, ==, 1.5f);
+    munit_assert_string_equal(string_chars(out[4]), "hihi");
+    munit_assert_int(out[5]->kind, ==, VECTOR3F);
+    munit_assert_float(out[5]->data.v_packed_vector3.f[1], ==, 2.5f);
+    munit_assert_null(out[6]);
+    munit_assert_null(out[7]);
+
+    // Same kind pairs share one allocation
+    munit_assert_true(out[1]->flags & OBJECT_FLAG_BATCHED);
+    munit_assert_ptr_equal(out[3], out[1] + 1);
+
+    for (int i = 0; i < 8; i++)
+    {
+        release_reference(&out[i]);
+    }
+    object_free(&one);
+    object_free(&half);
+    object_free(&vi);
+    object_free(&vf);
+    object_free(&hi);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_array_push_pop(const MunitParameter params[], void *data)
+{
+    object_t *one = new_integer(1);
+    object_t *array = new_array(0);
+    for (int i = 0; i < 100; i++)
+    {
+        munit_assert_true(array_push(array, one));
+    }
+    munit_assert_int(length(array), ==, 100);
+    munit_assert_size(array_capacity(array), >=, 100);
+    munit_assert_int(one->refcount, ==, 101);
+
+    // Pushing onto a copy leaves the original untouched
+    object_t *copy = object_copy(array);
+    munit_assert_true(array_push(copy, one));
+    munit_assert_int(length(array), ==, 100);
+    munit_assert_int(length(copy), ==, 101);
+    munit_assert_int(one->refcount, ==, 202);
+
+    object_t *popped = array_pop(copy);
+    munit_assert_ptr_equal(popped, one);
+    release_reference(&popped);
+    munit_assert_int(one->refcount, ==, 201);
+    object_free(&copy);
+
+    for (int i = 0; i < 90; i++)
+    {
+        object_t *value = array_pop(array);
+        release_reference(&value);
+    }
+    munit_assert_true(array_shrink_to_fit(array));
+    munit_assert_size(array_capacity(array), ==, 10);
+    munit_assert_true(array_reserve(array, 64));
+    munit_assert_size(array_capacity(array), ==, 64);
+    munit_assert_int(one->refcount, ==, 11);
+
+    object_free(&array);
+    munit_assert_int(one->refcount, ==, 1);
+    object_free(&one);
+
+    // VM flavor: popped elements become garbage
+    vm_t *vm = vm_new(true);
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *list = new_array_ms(vm, 0);
+    frame_reference_object(f1, list);
+    object_t *kept = new_integer_ms(vm, 1);
+    object_t *dropped = new_integer_ms(vm, 2);
+    munit_assert_true(array_push_ms(vm, list, kept));
+    munit_assert_true(array_push_ms(vm, list, dropped));
+    munit_assert_ptr_equal(array_pop_ms(vm, list), dropped);
+    vm_collect_garbage(vm);
+    munit_assert_true(vm_debug_was_freed(vm, dropped));
+    munit_assert_false(vm_debug_was_freed(vm, kept));
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_map(const MunitParameter params[], void *data)
+{
+    object_t *map = new_map();
+    object_t *value = new_string("value");
+    for (int i = 0; i < 1000; i++)
+    {
+        object_t *key = new_integer(i);
+        munit_assert_true(map_set(map, key, value));
+        release_reference(&key);
+    }
+    munit_assert_int(length(map), ==, 1000);
+    munit_assert_int(value->refcount, ==, 1001);
+
+    // Keys are compared by value
+    object_t *probe = new_integer(500);
+    munit_assert_ptr_equal(map_get(map, probe), value);
+    for (int i = 0; i < 1000; i += 2)
+    {
+        probe->data.v_int = i;
+        munit_assert_true(map_remove(map, probe));
+    }
+    munit_assert_int(length(map), ==, 500);
+    munit_assert_int(value->refcount, ==, 501);
+    for (int i = 0; i < 1000; i++)
+    {
+        probe->data.v_int = i;
+        if (i % 2 == 0)
+            munit_assert_null(map_get(map, probe));
+        else
+            munit_assert_ptr_equal(map_get(map, probe), value);
+    }
+
+    // String keys, including ropes, hash by contents
+    object_t *name = new_string("name");
+    object_t *flat = new_string("0123456789012345678901234567890123456789""0123456789012345678901234567890123456789");
+    object_t *half = new_string("0123456789012345678901234567890123456789");
+    object_t *rope = add(half, half);
+    munit_assert_true(map_set(map, name, name));
+    munit_assert_true(map_set(map, flat, probe));
+    munit_assert_ptr_equal(map_get(map, rope), probe);
+    munit_assert_true(map_set(map, rope, value));
+    munit_assert_ptr_equal(map_get(map, flat), value);
+    munit_assert_int(probe->refcount, ==, 1);
+
+    object_free(&map);
+    munit_assert_int(value->refcount, ==, 1);
+    object_free(&value);
+    object_free(&probe);
+    object_free(&name);
+    object_free(&flat);
+    object_free(&half);
+    object_free(&rope);
+
+    // Float keys: 0.0 and -0.0 are one key, and a NaN key can be found again
+    map = new_map();
+    object_t *zero = new_float(0.0f);
+    object_t *negative_zero = new_float(-0.0f);
+    object_t *nan = new_float(0.0f / 0.0f);
+    object_t *other_nan = new_float(-(0.0f / 0.0f));
+    munit_assert_true(map_set(map, zero, zero));
+    munit_assert_true(map_set(map, negative_zero, negative_zero));
+    munit_assert_true(map_set(map, nan, nan));
+    munit_assert_true(map_set(map, other_nan, other_nan));
+    munit_assert_int(length(map), ==, 2);
+    munit_assert_ptr_equal(map_get(map, zero), negative_zero);
+    munit_assert_ptr_equal(map_get(map, nan), other_nan);
+    object_free(&map);
+    object_free(&zero);
+    object_free(&negative_zero);
+    object_free(&nan);
+    object_free(&other_nan);
+
+    // VM flavor: entries are traced from the map
+    vm_t *vm = vm_new(true);
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *map_ms = new_map_ms(vm);
+    frame_reference_object(f1, map_ms);
+    object_t *k1 = new_string_ms(vm, "kept");
+    object_t *v1 = new_integer_ms(vm, 1);
+    object_t *k2 = new_string_ms(vm, "dropped");
+    object_t *v2 = new_integer_ms(vm, 2);
+    munit_assert_true(map_set_ms(vm, map_ms, k1, v1));
+    munit_assert_true(map_set_ms(vm, map_ms, k2, v2));
+    munit_assert_true(map_remove_ms(vm, map_ms, k2));
+    vm_collect_garbage(vm);
+    munit_assert_false(vm_debug_was_freed(vm, k1));
+    munit_assert_false(vm_debug_was_freed(vm, v1));
+    munit_assert_true(vm_debug_was_freed(vm, k2));
+    munit_assert_true(vm_debug_was_freed(vm, v2));
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_weak(const MunitParameter params[], void *data)
+{
+    object_t *target = new_string("cached");
+    object_t *weak = new_weak(target);
+    munit_assert_ptr_equal(weak_get(weak), target);
+    munit_assert_int(target->refcount, ==, 1);
+    release_reference(&target);
+    munit_assert_null(weak_get(weak));
+    object_free(&weak);
+
+    // Ephemeron entries go away with their keys, releasing the values
+    object_t *cache = new_ephemeron_map();
+    object_t *key = new_string("key");
+    object_t *value = new_integer(42);
+    object_t *other = new_string("other");
+    munit_assert_true(map_set(cache, key, value));
+    munit_assert_true(map_set(cache, other, value));
+    munit_assert_int(key->refcount, ==, 1);
+    munit_assert_int(value->refcount, ==, 3);
+    munit_assert_ptr_equal(map_get(cache, key), value);
+    release_reference(&key);
+    munit_assert_int(length(cache), ==, 1);
+    munit_assert_int(value->refcount, ==, 2);
+    object_free(&cache);
+    munit_assert_int(value->refcount, ==, 1);
+    munit_assert_int(other->flags & OBJECT_FLAG_WEAK_TARGET, ==, 0);
+    object_free(&other);
+    object_free(&value);
+
+    // VM flavor: cleared by sweep, ephemeron values traced through live keys only
+    vm_t *vm = vm_new(true);
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *kept = new_integer_ms(vm, 1);
+    object_t *dropped = new_integer_ms(vm, 2);
+    object_t *weak_kept = new_weak_ms(vm, kept);
+    object_t *weak_dropped = new_weak_ms(vm, dropped);
+    object_t *cache_ms = new_ephemeron_map_ms(vm);
+    object_t *v_kept = new_string_ms(vm, "kept");
+    object_t *v_dropped = new_vector3_ms(vm, dropped, dropped, dropped);
+    munit_assert_true(map_set_ms(vm, cache_ms, kept, v_kept));
+    munit_assert_true(map_set_ms(vm, cache_ms, dropped, v_dropped));
+    frame_reference_object(f1, weak_kept);
+    frame_reference_object(f1, weak_dropped);
+    frame_reference_object(f1, cache_ms);
+    frame_reference_object(f1, kept);
+    vm_collect_garbage(vm);
+    munit_assert_ptr_equal(weak_get_ms(vm, weak_kept), kept);
+    munit_assert_null(weak_get_ms(vm, weak_dropped));
+    munit_assert_true(vm_debug_was_freed(vm, dropped));
+    munit_assert_true(vm_debug_was_freed(vm, v_dropped));
+    munit_assert_false(vm_debug_was_freed(vm, v_kept));
+    munit_assert_int(length(cache_ms), ==, 1);
+    munit_assert_ptr_equal(map_get_ms(vm, cache_ms, kept), v_kept);
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static void count_finalized(object_t *obj, void *context)
+{
+    (*(int *)context)++;
+}
+
+static void resurrect_finalized(object_t *obj, void *context)
+{
+    // Registers again on its first run only
+    if (++*(int *)context == 1)
+        object_set_finalizer(obj, resurrect_finalized, context);
+}
+
+static MunitResult test_finalizer(const MunitParameter params[], void *data)
+{
+    int finalized = 0;
+    object_t *x = new_integer(1);
+    object_t *v = new_vector3(x, x, x);
+    munit_assert_true(object_set_finalizer(v, count_finalized, &finalized));
+    release_reference(&v);
+    munit_assert_null(v);
+    munit_assert_int(finalized, ==, 0);
+    munit_assert_int(x->refcount, ==, 4); // Queued, not freed yet
+    munit_assert_size(run_finalizers(), ==, 1);
+    munit_assert_int(finalized, ==, 1);
+    munit_assert_int(x->refcount, ==, 1);
+
+    // A finalizer registering itself again runs once per call
+    int resurrected = 0;
+    object_t *again = new_integer(2);
+    munit_assert_true(object_set_finalizer(again, resurrect_finalized, &resurrected));
+    release_reference(&again);
+    munit_assert_size(run_finalizers(), ==, 1);
+    munit_assert_size(run_finalizers(), ==, 1);
+    munit_assert_size(run_finalizers(), ==, 0);
+    munit_assert_int(resurrected, ==, 2);
+
+    // Removing the finalizer frees as usual
+    munit_assert_true(object_set_finalizer(x, count_finalized, &finalized));
+    munit_assert_true(object_set_finalizer(x, NULL, NULL));
+    release_reference(&x);
+    munit_assert_size(run_finalizers(), ==, 0);
+
+    // VM flavor: the dead object and what it references survive until finalized
+    vm_t *vm = vm_new(true);
+    object_t *i1 = new_integer_ms(vm, 1);
+    object_t *v_ms = new_vector3_ms(vm, i1, i1, i1);
+    munit_assert_true(vm_set_finalizer(vm, v_ms, count_finalized, &finalized));
+    vm_collect_garbage(vm);
+    munit_assert_false(vm_debug_was_freed(vm, v_ms));
+    munit_assert_false(vm_debug_was_freed(vm, i1));
+    munit_assert_int(finalized, ==, 1);
+    vm_collect_garbage(vm);
+    munit_assert_false(vm_debug_was_freed(vm, v_ms));
+    munit_assert_size(vm_run_finalizers(vm), ==, 1);
+    munit_assert_int(finalized, ==, 2);
+    vm_collect_garbage(vm);
+    munit_assert_true(vm_debug_was_freed(vm, v_ms));
+    munit_assert_true(vm_debug_was_freed(vm, i1));
+
+    // Outstanding finalizers run when the VM is freed
+    object_t *s1 = new_string_ms(vm, "resource");
+    munit_assert_true(vm_set_finalizer(vm, s1, count_finalized, &finalized));
+    vm_free(vm);
+    munit_assert_int(finalized, ==, 3);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_large_object(const MunitParameter params[], void *data)
+{
+    // Buffers cross between the heap and a mapping as they grow and shrink
+    object_t *array = new_array(0);
+    object_t *x = new_integer(7);
+    size_t large = BUFFER_LARGE_THRESHOLD / sizeof(object_t *);
+    for (size_t i = 0; i < large; i++)
+    {
+        munit_assert_true(array_push(array, x));
+    }
+    munit_assert_true(buffer_is_mapped(array->data.v_array.elements));
+    munit_assert_ptr_equal(array_get(array, large - 1), x);
+    munit_assert_true(array_reserve(array, 4 * large));
+    munit_assert_ptr_equal(array_get(array, 0), x);
+    for (size_t i = 0; i < large - 16; i++)
+    {
+        object_t *popped = array_pop(array);
+        release_reference(&popped);
+    }
+    munit_assert_true(array_shrink_to_fit(array));
+    munit_assert_false(buffer_is_mapped(array->data.v_array.elements));
+    munit_assert_ptr_equal(array_get(array, 15), x);
+    object_free(&array);
+    munit_assert_int(x->refcount, ==, 1);
+    object_free(&x);
+
+    // VM flavor: large objects have their own list and are swept from it
+    vm_t *vm = vm_new(true);
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *small = new_array_ms(vm, 4);
+    object_t *big = new_array_ms(vm, large);
+    munit_assert_int(vm->objects->count, ==, 1);
+    munit_assert_int(vm->large_objects->count, ==, 1);
+    munit_assert_true(array_set_ms(vm, big, 0, small));
+    frame_reference_object(f1, big);
+    vm_collect_garbage(vm);
+    munit_assert_false(vm_debug_was_freed(vm, small));
+    munit_assert_int(vm->large_objects->count, ==, 1);
+
+    frame_free(vm_frame_pop(vm));
+    vm_collect_garbage(vm);
+    munit_assert_true(vm_debug_was_freed(vm, big));
+    munit_assert_true(vm_debug_was_freed(vm, small));
+    munit_assert_int(vm->large_objects->count, ==, 0);
+
+    // Arrays change space when a resize crosses the threshold
+    frame_t *f2 = vm_new_frame(vm);
+    object_t *grown = new_array_ms(vm, 0);
+    object_t *y = new_integer_ms(vm, 7);
+    frame_reference_object(f2, grown);
+    frame_reference_object(f2, y);
+    for (size_t i = 0; i < large; i++)
+    {
+        munit_assert_true(array_push_ms(vm, grown, y));
+    }
+    munit_assert_true(buffer_is_mapped(grown->data.v_array.elements));
+    munit_assert_int(vm->large_objects->count, ==, 1);
+    munit_assert_int(vm->objects->count, ==, 1);
+    for (size_t i = 0; i < large - 16; i++)
+    {
+        array_pop_ms(vm, grown);
+    }
+    munit_assert_true(array_shrink_to_fit_ms(vm, grown));
+    munit_assert_false(buffer_is_mapped(grown->data.v_array.elements));
+    munit_assert_int(vm->large_objects->count, ==, 0);
+    munit_assert_int(vm->objects->count, ==, 2);
+    vm_collect_garbage(vm);
+    munit_assert_false(vm_debug_was_freed(vm, grown));
+    munit_assert_ptr_equal(array_get(grown, 15), y);
+    munit_assert_ptr_equal(vm_frame_pop(vm), f2);
+    frame_free(f2);
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_frame_pool(const MunitParameter params[], void *data)
+{
+    vm_t *vm = vm_new(true);
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *s = new_string_ms(vm, "only rooted by the first frame");
+    frame_reference_object(f1, s);
+    stack_t *reference = f1->reference;
+    frame_free(vm_frame_pop(vm));
+
+    // The pooled frame comes back empty, with its reference stack
+    frame_t *f2 = vm_new_frame(vm);
+    munit_assert_ptr_equal(f2, f1);
+    munit_assert_ptr_equal(f2->reference, reference);
+    munit_assert_size(f2->reference->count, ==, 0);
+    vm_collect_garbage(vm);
+    munit_assert_true(vm_debug_was_freed(vm, s));
+
+    frame_t *f3 = vm_new_frame(vm);
+    munit_assert_ptr_not_equal(f3, f2);
+    frame_free(vm_frame_pop(vm));
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_handle_scope(const MunitParameter params[], void *data)
+{
+    vm_t *vm = vm_new(true);
+    handle_scope_t outer;
+    vm_handle_scope_open(vm, &outer);
+    object_t *kept = new_integer_ms(vm, 1);
+    object_t *dropped = new_integer_ms(vm, 2);
+    object_t **h_kept = vm_handle(vm, kept);
+    object_t **h_dropped = vm_handle(vm, dropped);
+    munit_assert_ptr_equal(*h_kept, kept);
+
+    // Drop one root without closing the scope
+    handle_clear(h_dropped);
+    vm_collect_garbage(vm);
+    munit_assert_false(vm_debug_was_freed(vm, kept));
+    munit_assert_true(vm_debug_was_freed(vm, dropped));
+
+    // A nested scope spanning several blocks
+    handle_scope_t inner;
+    vm_handle_scope_open(vm, &inner);
+    object_t *last = NULL;
+    for (int i = 0; i < 3 * HANDLE_BLOCK_SLOTS; i++)
+    {
+        last = new_integer_ms(vm, i);
+        munit_assert_not_null(vm_handle(vm, last));
+    }
+    vm_collect_garbage(vm);
+    munit_assert_false(vm_debug_was_freed(vm, last));
+    vm_handle_scope_close(vm, &inner);
+    vm_collect_garbage(vm);
+    munit_assert_true(vm_debug_was_freed(vm, last));
+    munit_assert_false(vm_debug_was_freed(vm, kept));
+
+    // Handles created inside a frame are released with it
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *local = new_integer_ms(vm, 3);
+    vm_handle(vm, local);
+    munit_assert_ptr_equal(vm_frame_pop(vm), f1);
+    frame_free(f1);
+    vm_handle_scope_close(vm, &outer);
+    vm_collect_garbage(vm);
+    munit_assert_true(vm_debug_was_freed(vm, local));
+    munit_assert_true(vm_debug_was_freed(vm, kept));
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+/**
+ * @brief Allocator hooks counting calls, failing once `budget` bytes are exceeded.
+ */
+typedef struct CountingAllocator {
+    size_t resizes;
+    size_t budget;
+} counting_allocator_t;
+
+static void *counting_resize(void *context, void *ptr, size_t old_size, size_t new_size)
+{
+    counting_allocator_t *counter = context;
+    if (new_size > counter->budget)
+        return NULL;
+
+    counter->resizes++;
+    return realloc(ptr, new_size);
+}
+
+static void counting_release(void *context, void *ptr, size_t size)
+{
+    free(ptr);
+}
+
+static MunitResult test_stack(const MunitParameter params[], void *data)
+{
+    int items[100];
+    void *ptrs[100];
+    for (int i = 0; i < 100; i++)
+    {
+        ptrs[i] = &items[i];
+    }
+
+    // A stack created empty still grows
+    stack_t *stack = stack_new(0);
+    munit_assert_not_null(stack);
+    munit_assert_true(stack_push(stack, ptrs[0]));
+    munit_assert_true(stack_push_many(stack, ptrs + 1, 99));
+    munit_assert_size(stack->count, ==, 100);
+    for (int i = 99; i >= 0; i--)
+    {
+        munit_assert_ptr_equal(stack_pop(stack), ptrs[i]);
+    }
+    munit_assert_true(stack_shrink_to_fit(stack));
+    munit_assert_size(stack->capacity, ==, 0);
+    munit_assert_true(stack_reserve(stack, 64));
+    munit_assert_size(stack->capacity, ==, 64);
+    stack_free(stack);
+
+    // Custom policy and allocator, failures leave the stack untouched
+    counting_allocator_t counter = {0, 15 * sizeof(void *)};
+    stack_allocator_t allocator = {counting_resize, counting_release, &counter};
+    stack = stack_new_with(0, stack_growth_half, &allocator);
+    munit_assert_true(stack_push_many(stack, ptrs, 10));
+    munit_assert_size(counter.resizes, ==, 1);
+    for (int i = 10; i < 15; i++)
+    {
+        munit_assert_true(stack_push(stack, ptrs[i]));
+    }
+    munit_assert_size(stack->capacity, ==, 15); // 10 + 10 / 2
+    munit_assert_size(counter.resizes, ==, 2);
+    munit_assert_false(stack_push(stack, ptrs[15]));
+    munit_assert_false(stack_push_many(stack, ptrs, 2));
+    munit_assert_size(stack->count, ==, 15);
+    munit_assert_ptr_equal(stack_pop(stack), ptrs[14]);
+    stack_free(stack);
+
+    // The collector remembers how many objects survived, to size its gray stack
+    vm_t *vm = vm_new(false);
+    frame_t *f1 = vm_new_frame(vm);
+    for (int i = 0; i < 100; i++)
+    {
+        object_t *obj = new_integer_ms(vm, i);
+        if (i % 4 == 0)
+            munit_assert_true(frame_reference_object(f1, obj));
+    }
+    vm_collect_garbage(vm);
+    munit_assert_size(vm->live_objects, ==, 25);
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_mark_stack_overflow(const MunitParameter params[], void *data)
+{
+    vm_t *vm = vm_new(true);
+    frame_t *f1 = vm_new_frame(vm);
+
+    // A wide array of short chains needs far more than one chunk of gray objects
+    size_t width = 4 * MARK_STACK_CHUNK_SLOTS;
+    object_t *wide = new_array_ms(vm, width);
+    object_t *tail = NULL;
+    for (size_t i = 0; i < width; i++)
+    {
+        tail = new_integer_ms(vm, (int)i);
+        object_t *link = new_vector3_ms(vm, tail, tail, tail);
+        munit_assert_true(array_set_ms(vm, wide, i, link));
+    }
+    object_t *garbage = new_integer_ms(vm, -1);
+    frame_reference_object(f1, wide);
+
+    vm->gray.chunk_limit = 1;
+    vm_collect_garbage(vm);
+    munit_assert_false(vm_debug_was_freed(vm, tail));
+    munit_assert_true(vm_debug_was_freed(vm, garbage));
+    munit_assert_size(vm->live_objects, ==, 1 + 2 * width);
+    munit_assert_size(vm->gray.chunks, ==, 1);
+
+    // Chunks are recycled, and trimmed to the size of the live heap
+    vm->gray.chunk_limit = 0;
+    vm_collect_garbage(vm);
+    munit_assert_size(vm->live_objects, ==, 1 + 2 * width);
+    munit_assert_size(vm->gray.chunks, <=, vm->live_objects / MARK_STACK_CHUNK_SLOTS + 1);
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_prefetch_marking(const MunitParameter params[], void *data)
+{
+    vm_t *vm = vm_new(true);
+    frame_t *f1 = vm_new_frame(vm);
+    vm->prefetch_marking = true;
+
+    // A cycle of arrays with cross links, more than the prefetch window deep
+    size_t count = 4 * TRACE_PREFETCH_DISTANCE;
+    object_t *nodes[4 * TRACE_PREFETCH_DISTANCE];
+    for (size_t i = 0; i < count; i++)
+    {
+        nodes[i] = new_array_ms(vm, 2);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        munit_assert_true(array_set_ms(vm, nodes[i], 0, nodes[(i + 1) % count]));
+        munit_assert_true(array_set_ms(vm, nodes[i], 1, nodes[(i * 7) % count]));
+    }
+    object_t *garbage = new_array_ms(vm, 1);
+    munit_assert_true(array_set_ms(vm, garbage, 0, nodes[0]));
+    frame_reference_object(f1, nodes[count / 2]);
+
+    vm_collect_garbage(vm);
+    munit_assert_true(vm_debug_was_freed(vm, garbage));
+    munit_assert_false(vm_debug_was_freed(vm, nodes[0]));
+    munit_assert_size(vm->live_objects, ==, count);
+
+    // Same result with the prefetching FIFO switched off
+    vm->prefetch_marking = false;
+    vm_collect_garbage(vm);
+    munit_assert_size(vm->live_objects, ==, count);
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_gc_stats(const MunitParameter params[], void *data)
+{
+    vm_t *vm = vm_new(true);
+    frame_t *f1 = vm_new_frame(vm);
+
+    object_t *kept = new_array_ms(vm, 2);
+    frame_reference_object(f1, kept);
+    munit_assert_true(array_set_ms(vm, kept, 0, new_integer_ms(vm, 1)));
+    for (int i = 0; i < 7; i++)
+    {
+        new_integer_ms(vm, i);
+    }
+    new_string_ms(vm, "garbage");
+    munit_assert_size(vm->debug->total_allocations, ==, 10);
+
+    vm_collect_garbage(vm);
+    const gc_stats_t *stats = vm_gc_stats(vm);
+    munit_assert_size(stats->collections, ==, 1);
+    munit_assert_size(stats->objects_allocated, ==, 10);
+    munit_assert_size(stats->last.objects_reclaimed, ==, 8);
+    munit_assert_size(stats->last.bytes_reclaimed, >, 8 * sizeof(object_t));
+    munit_assert_uint64(stats->last.pause_ns, >=, stats->last.mark_ns + stats->last.trace_ns + stats->last.sweep_ns);
+    munit_assert_uint64(stats->max_pause_ns, ==, stats->last.pause_ns);
+
+    // Nothing left to reclaim, and every pause is in the histogram
+    vm_collect_garbage(vm);
+    munit_assert_size(stats->collections, ==, 2);
+    munit_assert_size(stats->last.objects_reclaimed, ==, 0);
+    munit_assert_size(stats->total.objects_reclaimed, ==, 8);
+    size_t pauses = 0;
+    for (size_t i = 0; i < GC_PAUSE_BUCKETS; i++)
+    {
+        pauses += stats->pause_histogram[i];
+    }
+    munit_assert_size(pauses, ==, 2);
+    munit_assert_uint64(gc_stats_pause_percentile(stats, 100), >=, stats->max_pause_ns);
+
+    vm_gc_stats_reset(vm);
+    munit_assert_size(stats->collections, ==, 0);
+    munit_assert_uint64(gc_stats_pause_percentile(stats, 50), ==, 0);
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_debug_quarantine(const MunitParameter params[], void *data)
+{
+    vm_t *vm = vm_new(true);
+    munit_assert_true(vm_debug_configure(vm, 4, 1));
+
+    // Swept in allocation order, the first two are evicted from the quarantine
+    object_t *garbage[6];
+    for (int i = 0; i < 6; i++)
+    {
+        garbage[i] = new_integer_ms(vm, i);
+    }
+    vm_collect_garbage(vm);
+    munit_assert_size(vm->debug->total_frees, ==, 6);
+    munit_assert_size(vm->debug->tracked_count, ==, 4);
+    munit_assert_false(vm_debug_was_freed(vm, garbage[1]));
+    for (int i = 2; i < 6; i++)
+    {
+        munit_assert_true(vm_debug_was_freed(vm, garbage[i]));
+    }
+
+    // Only one free in two is sampled
+    munit_assert_true(vm_debug_configure(vm, 8, 2));
+    munit_assert_size(vm->debug->tracked_count, ==, 0);
+    for (int i = 0; i < 6; i++)
+    {
+        new_integer_ms(vm, i);
+    }
+    vm_collect_garbage(vm);
+    munit_assert_size(vm->debug->tracked_count, ==, 3);
+    vm_free(vm);
+
+    vm = vm_new(false);
+    munit_assert_false(vm_debug_configure(vm, 4, 1));
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_heap_dump(const MunitParameter params[], void *data)
+{
+    vm_t *vm = vm_new(false);
+    frame_t *f1 = vm_new_frame(vm);
+
+    // Root -> array -> {vector -> 3 x integer, string}, and one unreachable integer
+    object_t *one = new_integer_ms(vm, 1);
+    object_t *vector = new_vector3_ms(vm, one, one, one);
+    object_t *array = new_array_ms(vm, 3);
+    munit_assert_true(array_set_ms(vm, array, 0, vector));
+    munit_assert_true(array_set_ms(vm, array, 1, new_string_ms(vm, "dumped")));
+    new_integer_ms(vm, 2);
+    frame_reference_object(f1, array);
+    object_t **handle = vm_handle(vm, one);
+
+    char path[] = "/tmp/heap_dumpXXXXXX";
+    int fd = mkstemp(path);
+    munit_assert_int(fd, >=, 0);
+    close(fd);
+    munit_assert_true(vm_heap_dump(vm, path));
+
+    FILE *in = fopen(path, "rb");
+    unsigned char header[8];
+    munit_assert_size(fread(header, 1, 8, in), ==, 8);
+    munit_assert_memory_equal(4, header, HEAP_DUMP_MAGIC);
+    munit_assert_int(header[4], ==, HEAP_DUMP_VERSION);
+
+    uint64_t trailer[3];
+    fseek(in, -(long)HEAP_DUMP_TRAILER_SIZE, SEEK_END);
+    munit_assert_size(fread(trailer, sizeof(uint64_t), 3, in), ==, 3);
+    fclose(in);
+    remove(path);
+    munit_assert_uint64(trailer[0], ==, 5);
+    munit_assert_uint64(trailer[1], ==, 2);
+    munit_assert_uint64(trailer[2], ==, 5);
+
+    handle_clear(handle);
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_heap_profile(const MunitParameter params[], void *data)
+{
+    // Every allocation is sampled with a mean of 0 bytes, so estimates are exact
+    heap_profile_reset();
+    heap_profile_start(0);
+    object_t *integer = new_integer(1);
+    object_t *values = new_int_array(16);
+    vm_t *vm = vm_new(false);
+    frame_t *f1 = vm_new_frame(vm);
+    frame_reference_object(f1, new_string_ms(vm, "sampled"));
+    heap_profile_stop();
+    object_t *unsampled = new_integer(2);
+
+    size_t rc_bytes = object_size(integer) + object_size(values);
+    size_t live = heap_profile_live_bytes();
+    munit_assert_true(integer->flags & OBJECT_FLAG_SAMPLED);
+    munit_assert_false(unsampled->flags & OBJECT_FLAG_SAMPLED);
+    munit_assert_size(live, >, rc_bytes);
+
+    FILE *out = tmpfile();
+    munit_assert_size(heap_profile_write_folded(out), >=, 2);
+    rewind(out);
+    char line[4096];
+    size_t total = 0;
+    while (fgets(line, sizeof(line), out) != NULL)
+    {
+        char *bytes = strrchr(line, ' ');
+        munit_assert_not_null(bytes);
+        total += strtoul(bytes + 1, NULL, 10);
+    }
+    fclose(out);
+    munit_assert_size(total, ==, live);
+
+    // Samples die with their objects, whichever model frees them
+    vm_free(vm);
+    munit_assert_size(heap_profile_live_bytes(), ==, rc_bytes);
+    object_free(&integer);
+    object_free(&values);
+    object_free(&unsampled);
+    munit_assert_size(heap_profile_live_bytes(), ==, 0);
+
+    // Sampled by bytes, the weighted estimate stays close to the real size
+    size_t count = 20000;
+    object_t **objects = malloc(count * sizeof(object_t *));
+    size_t allocated = 0;
+    heap_profile_start(4096);
+    for (size_t i = 0; i < count; i++)
+    {
+        objects[i] = i % 2 ? new_integer((int)i) : new_int_array(i % 64);
+        allocated += object_size(objects[i]);
+    }
+    heap_profile_stop();
+    live = heap_profile_live_bytes();
+    munit_assert_size(live, >, allocated * 3 / 4);
+    munit_assert_size(live, <, allocated * 5 / 4);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        object_free(&objects[i]);
+    }
+    free(objects);
+    munit_assert_size(heap_profile_live_bytes(), ==, 0);
+    heap_profile_reset();
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_event_ring(const MunitParameter params[], void *data)
+{
+    event_ring_start();
+    event_begin("app", "request");
+    vm_t *vm = vm_new(false);
+    frame_t *f1 = vm_new_frame(vm);
+    frame_reference_object(f1, new_array_ms(vm, BUFFER_LARGE_THRESHOLD / sizeof(object_t *)));
+    vm_collect_garbage(vm);
+    frame_free(vm_frame_pop(vm));
+    event_end("app", "request");
+    event_ring_stop();
+    event_instant("app", "ignored", 0);
+
+    // Request, frame, 5 collection spans, and the mapped elements buffer
+    munit_assert_size(event_ring_count(), ==, 15);
+    FILE *out = tmpfile();
+    munit_assert_size(event_ring_write_chrome(out), ==, 15);
+    size_t size = (size_t)ftell(out);
+    rewind(out);
+    char *json = calloc(size + 1, 1);
+    munit_assert_size(fread(json, 1, size, out), ==, size);
+    fclose(out);
+    munit_assert_not_null(strstr(json, "\"traceEvents\":["));
+    munit_assert_not_null(strstr(json, "\"name\":\"sweep\",\"cat\":\"gc\",\"ph\":\"E\""));
+    munit_assert_not_null(strstr(json, "\"name\":\"mapped_buffer\",\"cat\":\"alloc\",\"ph\":\"i\""));
+    munit_assert_null(strstr(json, "ignored"));
+    free(json);
+    vm_free(vm);
+
+    // Only the newest events are kept once the ring wraps around
+    event_ring_start();
+    for (size_t i = 0; i < EVENT_RING_SIZE + 10; i++)
+    {
+        event_instant("app", "tick", i);
+    }
+    event_ring_stop();
+    munit_assert_size(event_ring_count(), ==, EVENT_RING_SIZE);
+    out = tmpfile();
+    munit_assert_size(event_ring_write_chrome(out), ==, EVENT_RING_SIZE);
+    fclose(out);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_heap_stats(const MunitParameter params[], void *data)
+{
+    vm_t *vm = vm_new(false);
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *array = new_array_ms(vm, 0);
+    object_t *map = new_map_ms(vm);
+    frame_reference_object(f1, array);
+    frame_reference_object(f1, map);
+    for (int i = 0; i < 100; i++)
+    {
+        object_t *value = new_integer_ms(vm, i);
+        munit_assert_true(array_push_ms(vm, array, value));
+        munit_assert_true(map_set_ms(vm, map, value, new_string_ms(vm, "value")));
+    }
+
+    // Counters match a walk of the heap, payloads included
+    const heap_stats_t *heap = vm_heap_stats(vm);
+    size_t walked = 0;
+    for (size_t i = 0; i < vm->objects->count; i++)
+    {
+        walked += object_size(vm->objects->data[i]);
+    }
+    munit_assert_size(heap->objects, ==, 202);
+    munit_assert_size(heap->bytes, ==, walked);
+    munit_assert_size(heap->kinds[INTEGER].objects, ==, 100);
+    munit_assert_size(heap->kinds[INTEGER].payload_bytes, ==, 0);
+    munit_assert_size(heap->kinds[STRING].objects, ==, 100);
+    munit_assert_size(heap->kinds[STRING].payload_bytes, >=, 100 * 6);
+    munit_assert_size(heap->kinds[ARRAY].bytes, ==, object_size(array));
+    munit_assert_size(heap->kinds[MAP].payload_bytes, ==, map->data.v_map.capacity * sizeof(map_entry_t));
+    munit_assert_size(heap->peak_bytes, ==, heap->bytes);
+
+    // Reclaimed objects are uncounted, the peak stays until reset
+    size_t peak = heap->peak_bytes;
+    frame_free(vm_frame_pop(vm));
+    vm_collect_garbage(vm);
+    munit_assert_size(heap->objects, ==, 0);
+    munit_assert_size(heap->bytes, ==, 0);
+    munit_assert_size(heap->kinds[STRING].payload_bytes, ==, 0);
+    munit_assert_size(heap->peak_bytes, ==, peak);
+    munit_assert_size(heap->peak_objects, ==, 202);
+    vm_heap_stats_reset_peak(vm);
+    munit_assert_size(heap->peak_bytes, ==, 0);
+
+    // Weak objects that cannot be registered are neither tracked nor counted
+    counting_allocator_t counter = {0, 0};
+    stack_allocator_t allocator = {counting_resize, counting_release, &counter};
+    stack_t *weak_refs = vm->weak_refs;
+    stack_t *ephemerons = vm->ephemerons;
+    vm->weak_refs = stack_new_with(0, NULL, &allocator);
+    vm->ephemerons = stack_new_with(0, NULL, &allocator);
+    size_t allocated = vm->stats.objects_allocated;
+    object_t *target = new_integer_ms(vm, 1);
+    munit_assert_null(new_weak_ms(vm, target));
+    munit_assert_null(new_ephemeron_map_ms(vm));
+    munit_assert_size(vm->objects->count, ==, 1);
+    munit_assert_size(heap->objects, ==, 1);
+    munit_assert_size(heap->kinds[WEAK].objects, ==, 0);
+    munit_assert_size(heap->kinds[MAP].objects, ==, 0);
+    munit_assert_size(vm->stats.objects_allocated, ==, allocated + 1);
+    stack_free(vm->weak_refs);
+    stack_free(vm->ephemerons);
+    vm->weak_refs = weak_refs;
+    vm->ephemerons = ephemerons;
+
+    vm_free(vm);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_recorder(const MunitParameter params[], void *data)
+{
+    char path[] = "/tmp/recorderXXXXXX";
+    int fd = mkstemp(path);
+    munit_assert_int(fd, >=, 0);
+    close(fd);
+
+    vm_t *vm = vm_new(false);
+    object_t *before = new_integer_ms(vm, 7);
+    munit_assert_true(recorder_start(path));
+    munit_assert_false(recorder_start(path));
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *array = new_array_ms(vm, 2);
+    frame_reference_object(f1, array);
+    array_set_ms(vm, array, 1, new_integer_ms(vm, -2));
+    array_set_ms(vm, array, 0, before);
+    vm_collect_garbage(vm);
+    frame_free(vm_frame_pop(vm));
+    munit_assert_true(recorder_stop());
+    munit_assert_false(recorder_stop());
+    vm_free(vm);
+
+    // Objects are numbered in creation order, those created before recording are 0
+    const unsigned char expected[] = {
+        REC_FRAME_PUSH,
+        REC_NEW, ARRAY, 2,
+        REC_FRAME_REFERENCE, 0, 1,
+        REC_NEW, INTEGER, 3,
+        REC_ARRAY_SET, 1, 1, 2,
+        REC_ARRAY_SET, 1, 0, 0,
+        REC_COLLECT,
+        REC_FRAME_POP};
+    unsigned char trace[64];
+    FILE *in = fopen(path, "rb");
+    size_t size = fread(trace, 1, sizeof(trace), in);
+    fclose(in);
+    remove(path);
+    munit_assert_size(size, ==, 8 + sizeof(expected));
+    munit_assert_memory_equal(4, trace, RECORDER_MAGIC);
+    munit_assert_int(trace[4], ==, RECORDER_VERSION);
+    munit_assert_memory_equal(sizeof(expected), trace + 8, expected);
+
+    return MUNIT_OK;
+}
+
+static MunitResult test_replay(const MunitParameter params[], void *data)
+{
+    char path[] = "/tmp/replayXXXXXX";
+    int fd = mkstemp(path);
+    munit_assert_int(fd, >=, 0);
+    close(fd);
+
+    vm_t *vm = vm_new(false);
+    frame_t *f1 = vm_new_frame(vm);
+    object_t *before = new_array_ms(vm, 0);
+    frame_reference_object(f1, before);
+    munit_assert_true(recorder_start(path));
+
+    handle_scope_t scope;
+    vm_handle_scope_open(vm, &scope);
+    object_t *a = new_array_ms(vm, 1);
+    object_t *b = new_array_ms(vm, 1);
+    object_t **handle = vm_handle(vm, a);
+    vm_handle(vm, b);
+    object_t *x = new_integer_ms(vm, 1);
+    array_set_ms(vm, a, 0, x);
+    vm_collect_garbage(vm);
+
+    // Dropped objects may be stored again until the next collection
+    array_set_ms(vm, a, 0, new_integer_ms(vm, 2));
+    array_set_ms(vm, b, 0, x);
+    object_t *map = new_map_ms(vm);
+    object_t *key = new_string_ms(vm, "key");
+    array_push_ms(vm, b, map);
+    map_set_ms(vm, map, key, x);
+    vm_collect_garbage(vm);
+    map_remove_ms(vm, map, key);
+    array_push_ms(vm, a, key);
+    munit_assert_ptr_equal(array_pop_ms(vm, a), key);
+    array_push_ms(vm, before, key);
+    handle_clear(handle);
+    array_push_ms(vm, b, a);
+    vm_collect_garbage(vm);
+    vm_handle_scope_close(vm, &scope);
+    vm_collect_garbage(vm);
+    munit_assert_true(recorder_stop());
+
+    // The key outlives the handles, held by an array created before recording
+    munit_assert_size(vm->live_objects, ==, 2);
+    frame_free(vm_frame_pop(vm));
+    vm_free(vm);
+
+    uint8_t trace[512];
+    FILE *in = fopen(path, "rb");
+    size_t size = fread(trace, 1, sizeof(trace), in);
+    fclose(in);
+    remove(path);
+    munit_assert_size(size, <, sizeof(trace));
+
+    munit_assert_size(replayer_backend_count(), ==, 3);
+    for (size_t backend = 0; backend < replayer_backend_count(); backend++)
+    {
+        replay_result_t result;
+        munit_assert_true(replayer_run(backend, trace, size, &result));
+        munit_assert_size(result.objects, ==, 6);
+        munit_assert_size(result.pauses, ==, 4);
+        replayer_result_free(&result);
+    }
+
+    // Truncated traces and other versions are rejected
+    replay_result_t result;
+    trace[8] = REC_NEW;
+    trace[9] = ARRAY;
+    munit_assert_false(replayer_run(0, trace, 10, &result));
+    replayer_result_free(&result);
+    trace[4]++;
+    munit_assert_false(replayer_run(0, trace, size, &result));
+    munit_assert_null(replayer_backend_name(replayer_backend_count()));
+
+    return MUNIT_OK;
+}
+
 static MunitResult test_mark_sweep_simple(const MunitParameter params[], void *data)
 {
     vm_t *vm = vm_new(true);
@@ -343,6 +1675,31 @@ static MunitTest test_suite_tests[] = {
     {(char *)"/test/string_self_add", test_string_add_self, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {(char *)"/test/vetor3_add", test_vector3_add, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {(char *)"/test/array_add", test_array_add, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/add_consume", test_add_consume, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/copy_on_write", test_copy_on_write, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/string_rope", test_string_rope, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/string_counted", test_string_counted, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/packed_array_add", test_packed_array_add, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/packed_vector3_add", test_packed_vector3_add, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/add_batch", test_add_batch, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/array_push_pop", test_array_push_pop, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/map", test_map, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/weak", test_weak, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/finalizer", test_finalizer, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/large_object", test_large_object, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/frame_pool", test_frame_pool, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/handle_scope", test_handle_scope, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/stack", test_stack, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/mark_stack_overflow", test_mark_stack_overflow, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/prefetch_marking", test_prefetch_marking, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/gc_stats", test_gc_stats, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/debug_quarantine", test_debug_quarantine, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/heap_dump", test_heap_dump, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/heap_profile", test_heap_profile, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/event_ring", test_event_ring, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/heap_stats", test_heap_stats, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/recorder", test_recorder, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {(char *)"/test/replay", test_replay, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {(char *)"/test/mark_sweep_simple", test_mark_sweep_simple, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {(char *)"/test/mark_sweep_full", test_mark_sweep_full, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
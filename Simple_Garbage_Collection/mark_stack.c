@@ -0,0 +1,93 @@
+#include <stdlib.h>
+
+#include "mark_stack.h"
+
+/**
+ * @brief Get an empty chunk, recycled if possible.
+ * 
+ * @param stack Mark stack.
+ * @return Pointer to the chunk, or NULL if the limit is reached or allocation fails.
+ */
+static mark_chunk_t *_take_chunk(mark_stack_t *stack)
+{
+    mark_chunk_t *chunk = stack->free_chunks;
+    if (chunk != NULL)
+    {
+        stack->free_chunks = chunk->prev;
+        return chunk;
+    }
+
+    if (stack->chunk_limit != 0 && stack->chunks >= stack->chunk_limit)
+        return NULL;
+
+    chunk = malloc(sizeof(mark_chunk_t));
+    if (chunk != NULL)
+        stack->chunks++;
+
+    return chunk;
+}
+
+bool mark_stack_push(mark_stack_t *stack, object_t *obj)
+{
+    mark_chunk_t *chunk = stack->top;
+    if (chunk == NULL || chunk->count == MARK_STACK_CHUNK_SLOTS)
+    {
+        chunk = _take_chunk(stack);
+        if (chunk == NULL)
+        {
+            stack->overflowed = true;
+            return false;
+        }
+        chunk->prev = stack->top;
+        chunk->count = 0;
+        stack->top = chunk;
+    }
+
+    chunk->slots[chunk->count++] = obj;
+    return true;
+}
+
+object_t *mark_stack_pop(mark_stack_t *stack)
+{
+    mark_chunk_t *chunk = stack->top;
+    if (chunk == NULL)
+        return NULL;
+
+    object_t *obj = chunk->slots[--chunk->count];
+    if (chunk->count == 0)
+    {
+        // Recycle the emptied chunk
+        stack->top = chunk->prev;
+        chunk->prev = stack->free_chunks;
+        stack->free_chunks = chunk;
+    }
+    return obj;
+}
+
+bool mark_stack_is_empty(const mark_stack_t *stack)
+{
+    return stack->top == NULL;
+}
+
+void mark_stack_trim(mark_stack_t *stack, size_t keep)
+{
+    while (stack->chunks > keep && stack->free_chunks != NULL)
+    {
+        mark_chunk_t *chunk = stack->free_chunks;
+        stack->free_chunks = chunk->prev;
+        free(chunk);
+        stack->chunks--;
+    }
+}
+
+void mark_stack_free(mark_stack_t *stack)
+{
+    while (stack->top != NULL)
+    {
+        mark_chunk_t *chunk = stack->top;
+        stack->top = chunk->prev;
+        chunk->prev = stack->free_chunks;
+        stack->free_chunks = chunk;
+    }
+    mark_stack_trim(stack, 0);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "object.h"
+
+/**
+ * @brief Number of objects held by each chunk of a mark stack.
+ */
+#define MARK_STACK_CHUNK_SLOTS 1024
+
+/**
+ * @struct MarkChunk
+ * @brief Fixed-size segment of a mark stack.
+ */
+typedef struct MarkChunk
+{
+    struct MarkChunk *prev;  /**< Chunk below this one, or next recycled chunk */
+    size_t count;            /**< Number of slots in use */
+    object_t *slots[MARK_STACK_CHUNK_SLOTS]; /**< Gray objects */
+} mark_chunk_t;
+
+/**
+ * @struct MarkStack
+ * @brief Segmented stack of gray objects for the collector.
+ * 
+ * Growing links a new chunk instead of copying, and emptied chunks are kept
+ * for reuse. When no chunk can be had the push fails and `overflowed` is set,
+ * leaving the object marked but untraced for the collector to rescan.
+ * A zero-initialised `mark_stack_t` is an empty stack without a chunk limit.
+ */
+typedef struct MarkStack
+{
+    mark_chunk_t *top;       /**< Chunk holding the top of the stack, NULL when empty */
+    mark_chunk_t *free_chunks; /**< Recycled chunks */
+    size_t chunks;           /**< Number of chunks allocated, in use or recycled */
+    size_t chunk_limit;      /**< Maximum number of chunks, 0 for no limit */
+    bool overflowed;         /**< Set when a push failed since it was last cleared */
+} mark_stack_t;
+
+/**
+ * @brief Push a gray object.
+ * 
+ * @param stack Mark stack.
+ * @param obj Object to push.
+ * @return True if successful, false (setting `overflowed`) if no chunk is available.
+ */
+bool mark_stack_push(mark_stack_t *stack, object_t *obj);
+
+/**
+ * @brief Pop a gray object.
+ * 
+ * @param stack Mark stack.
+ * @return The object on top, or NULL if the stack is empty.
+ */
+object_t *mark_stack_pop(mark_stack_t *stack);
+
+/**
+ * @brief Check whether a mark stack is empty.
+ * 
+ * @param stack Mark stack.
+ * @return True if no object is on the stack.
+ */
+bool mark_stack_is_empty(const mark_stack_t *stack);
+
+/**
+ * @brief Free recycled chunks until at most `keep` chunks are allocated.
+ * 
+ * @param stack Mark stack.
+ * @param keep Number of chunks to keep for the next collection.
+ */
+void mark_stack_trim(mark_stack_t *stack, size_t keep);
+
+/**
+ * @brief Free every chunk of a mark stack, leaving it empty.
+ * 
+ * @param stack Mark stack.
+ */
+void mark_stack_free(mark_stack_t *stack);
@@ -0,0 +1,217 @@
+#include <string.h>
+
+#include "object.h"
+#include "rope.h"
+#include "buffer.h"
+
+char *string_chars(object_t *obj)
+{
+    if (obj == NULL || obj->kind != STRING)
+        return NULL;
+
+    if (obj->data.v_string.chars == NULL)
+    {
+        char *chars = rope_flatten(obj->data.v_string.rope);
+        if (chars == NULL)
+            return NULL;
+
+        // Keep the flat copy, the tree is no longer needed
+        obj->data.v_string.chars = chars;
+        rope_release(obj->data.v_string.rope);
+        obj->data.v_string.rope = NULL;
+    }
+    return obj->data.v_string.chars;
+}
+
+size_t string_length(object_t *obj)
+{
+    if (obj == NULL || obj->kind != STRING)
+        return 0;
+
+    return obj->data.v_string.length;
+}
+
+/**
+ * @brief Feed bytes into a 64-bit FNV-1a hash.
+ * 
+ * @param hash Running hash.
+ * @param bytes Bytes to hash.
+ * @param length Number of bytes.
+ * @return Updated hash.
+ */
+static size_t _hash_bytes(size_t hash, const char *bytes, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Feed the leaves of a rope, left to right, into a hash.
+ * 
+ * @param hash Running hash.
+ * @param rope Rope to hash.
+ * @return Updated hash.
+ */
+static size_t _hash_rope(size_t hash, rope_t *rope)
+{
+    if (rope->chars != NULL)
+        return _hash_bytes(hash, rope->chars, rope->length);
+
+    hash = _hash_rope(hash, rope->left);
+    return _hash_rope(hash, rope->right);
+}
+
+size_t string_hash(object_t *obj)
+{
+    if (obj == NULL || obj->kind != STRING)
+        return 0;
+
+    if (obj->data.v_string.hash == 0)
+    {
+        size_t hash = 14695981039346656037ULL;
+        if (obj->data.v_string.chars != NULL)
+            hash = _hash_bytes(hash, obj->data.v_string.chars, obj->data.v_string.length);
+        else
+            hash = _hash_rope(hash, obj->data.v_string.rope);
+
+        // 0 marks "not computed yet"
+        obj->data.v_string.hash = hash == 0 ? 1 : hash;
+    }
+    return obj->data.v_string.hash;
+}
+
+bool string_equal(object_t *a, object_t *b)
+{
+    if (a == NULL || b == NULL || a->kind != STRING || b->kind != STRING)
+        return false;
+
+    if (a == b)
+        return true;
+
+    if (a->data.v_string.length != b->data.v_string.length)
+        return false;
+
+    // Copy-on-write copies share their buffer
+    if (a->data.v_string.chars != NULL && a->data.v_string.chars == b->data.v_string.chars)
+        return true;
+
+    if (a->data.v_string.hash != 0 && b->data.v_string.hash != 0 &&
+        a->data.v_string.hash != b->data.v_string.hash)
+        return false;
+
+    char *chars_a = string_chars(a);
+    char *chars_b = string_chars(b);
+    if (chars_a == NULL || chars_b == NULL)
+        return false;
+
+    return memcmp(chars_a, chars_b, a->data.v_string.length) == 0;
+}
+
+/**
+ * @brief Scramble the bits of a word so that nearby keys spread over the table.
+ * 
+ * @param x Word to mix.
+ * @return Mixed word (splitmix64 finaliser).
+ */
+static size_t _mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (size_t)x;
+}
+
+/**
+ * @brief Get the bits identifying a float map key.
+ * 
+ * @param value Key value.
+ * @return Raw bits, with -0.0 folded onto 0.0 and every NaN onto one quiet NaN.
+ * 
+ * @note Hashing and equality both use these bits, so equal keys always hash alike.
+ */
+static uint32_t _float_key_bits(float value)
+{
+    if (value == 0.0f)
+        return 0;
+    if (value != value)
+        return 0x7fc00000u;
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+size_t object_hash(object_t *obj)
+{
+    if (obj == NULL)
+        return 0;
+
+    switch (obj->kind)
+    {
+    case INTEGER:
+        return _mix((uint64_t)(int64_t)obj->data.v_int);
+    case FLOAT:
+        return _mix(_float_key_bits(obj->data.v_float) ^ 0x5bd1e995ULL);
+    case STRING:
+        return string_hash(obj);
+    default:
+        return _mix((uint64_t)(uintptr_t)obj);
+    }
+}
+
+bool object_equal(object_t *a, object_t *b)
+{
+    if (a == b)
+        return true;
+
+    if (a == NULL || b == NULL || a->kind != b->kind)
+        return false;
+
+    switch (a->kind)
+    {
+    case INTEGER:
+        return a->data.v_int == b->data.v_int;
+    case FLOAT:
+        return _float_key_bits(a->data.v_float) == _float_key_bits(b->data.v_float);
+    case STRING:
+        return string_equal(a, b);
+    default:
+        return false;
+    }
+}
+
+size_t object_size(object_t *obj)
+{
+    if (obj == NULL)
+        return 0;
+
+    size_t bytes = sizeof(object_t);
+    switch (obj->kind)
+    {
+    case STRING:
+        if (!buffer_is_shared(obj->data.v_string.chars))
+            bytes += buffer_capacity(obj->data.v_string.chars);
+        break;
+    case ARRAY:
+        if (!buffer_is_shared(obj->data.v_array.elements))
+            bytes += buffer_capacity(obj->data.v_array.elements);
+        break;
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        // Values are allocated inline with the object, `int` and `float` are the same size
+        bytes += obj->data.v_packed.size * sizeof(int);
+        break;
+    case MAP:
+        bytes += obj->data.v_map.capacity * sizeof(map_entry_t);
+        break;
+    default:
+        break;
+    }
+    return bytes;
+}
@@ -1,8 +1,10 @@
 #pragma once
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct Object object_t;
+typedef struct Rope rope_t;
 
 /**
  * @enum ObjectKind
@@ -13,7 +15,13 @@ typedef enum ObjectKind {
     FLOAT,     /**< Float type */
     STRING,    /**< String type */
     VECTOR3,   /**< 3D vector type */
-    ARRAY      /**< Array type */
+    ARRAY,     /**< Array type */
+    INT_ARRAY, /**< Packed array of raw `int` values */
+    FLOAT_ARRAY, /**< Packed array of raw `float` values */
+    VECTOR3I,  /**< Unboxed 3D vector of `int` components */
+    VECTOR3F,  /**< Unboxed 3D vector of `float` components */
+    MAP,       /**< Hash map from objects to objects */
+    WEAK       /**< Weak reference that does not keep its target alive */
 } object_kind_t;
 
 /**
@@ -26,6 +34,28 @@ typedef struct Vector {
     object_t *z; /**< Z coordinate */
 } vector_t;
 
+/**
+ * @struct String
+ * Structure to represent a string, either flat or as a rope.
+ */
+typedef struct String {
+    char *chars;   /**< NUL terminated contents (`buffer_t` payload), NULL until a rope is flattened */
+    rope_t *rope;  /**< Concatenation tree, NULL for flat strings */
+    size_t length; /**< Number of bytes, which may include embedded NULs */
+    size_t hash;   /**< Cached hash of the contents, 0 until computed */
+} string_t;
+
+/**
+ * @union PackedVector
+ * Union to hold the components of an unboxed 3D vector inline.
+ * 
+ * The fourth lane is padding so a vector fits one SIMD register.
+ */
+typedef union PackedVector {
+    int i[4];              /**< Components of a VECTOR3I */
+    float f[4];            /**< Components of a VECTOR3F */
+} packed_vector_t;
+
 /**
  * @struct Array
  * Structure to represent an array of objects.
@@ -35,6 +65,42 @@ typedef struct Array {
     object_t **elements;   /**< Pointer to array elements */
 } array_t;
 
+/**
+ * @struct PackedArray
+ * Structure to represent an unboxed array of numbers.
+ * 
+ * The values are allocated inline, right after the owning `object_t`, so the
+ * object and its payload are released with a single `free`.
+ */
+typedef struct PackedArray {
+    size_t size;           /**< Number of values */
+    void *values;          /**< `int *` for INT_ARRAY, `float *` for FLOAT_ARRAY */
+} packed_array_t;
+
+/**
+ * @struct MapEntry
+ * Structure to represent one slot of a map.
+ */
+typedef struct MapEntry {
+    size_t hash;           /**< Cached hash of the key */
+    object_t *key;         /**< Key, NULL for an empty slot */
+    object_t *value;       /**< Value associated with the key */
+} map_entry_t;
+
+/**
+ * @struct Map
+ * Structure to represent an open-addressing hash map with linear probing.
+ * 
+ * Entries are stored inline in one flat array so a lookup touches a single,
+ * mostly contiguous run of memory.
+ */
+typedef struct Map {
+    size_t count;          /**< Number of entries in use */
+    size_t capacity;       /**< Number of slots, 0 or a power of two */
+    map_entry_t *entries;  /**< Slots of the table */
+    bool weak_keys;        /**< Ephemeron table: an entry lives only as long as its key */
+} map_t;
+
 /**
  * @union ObjectData
  * Union to hold data for different object types.
@@ -42,11 +108,26 @@ typedef struct Array {
 typedef union ObjectData {
     int v_int;             /**< Integer value */
     float v_float;         /**< Float value */
-    char *v_string;        /**< String value */
+    string_t v_string;     /**< String value */
     vector_t v_vector3;    /**< 3D vector */
+    packed_vector_t v_packed_vector3; /**< Unboxed 3D vector */
+    map_t v_map;           /**< Hash map */
     array_t v_array;       /**< Array of objects */
+    packed_array_t v_packed; /**< Packed array of numbers */
+    object_t *v_weak;      /**< Target of a weak reference, NULL once collected */
 } object_data_t;
 
+/**
+ * @enum ObjectFlags
+ * Bits stored in `object_t.flags`.
+ */
+typedef enum ObjectFlags {
+    OBJECT_FLAG_BATCHED = 1 << 0,    /**< Allocated inside a block by `add_batch` */
+    OBJECT_FLAG_WEAK_TARGET = 1 << 1, /**< Referenced weakly, by a WEAK object or an ephemeron key */
+    OBJECT_FLAG_FINALIZABLE = 1 << 2, /**< Has a finalizer that has not been queued yet */
+    OBJECT_FLAG_SAMPLED = 1 << 3      /**< Has a live sample in the heap profiler */
+} object_flags_t;
+
 /**
  * @struct Object
  * Structure to represent a generic object with a type and data.
@@ -56,4 +137,92 @@ typedef struct Object {
     object_data_t data;    /**< Data of the object */
     size_t refcount;       /**< Reference count */
     bool is_marked;        /**< Mark for garbage collection */
+    uint8_t flags;         /**< Combination of `object_flags_t` bits */
+    uint32_t block_index;  /**< Position inside its block when OBJECT_FLAG_BATCHED is set */
 } object_t;
+
+/**
+ * @brief Function releasing the external resources of a dead object.
+ * 
+ * @param obj Object about to be freed, still intact.
+ * @param context Pointer given when the finalizer was registered.
+ */
+typedef void (*finalizer_t)(object_t *obj, void *context);
+
+/**
+ * @struct Finalizer
+ * Structure to represent a registered, or queued, finalizer.
+ */
+typedef struct Finalizer {
+    object_t *obj;         /**< Object to finalize */
+    finalizer_t fn;        /**< Function to run */
+    void *context;         /**< Argument passed to `fn` */
+} finalizer_entry_t;
+
+/**
+ * @brief Get the contiguous contents of a string object.
+ * 
+ * @param obj String object.
+ * @return NUL terminated contents, or NULL if `obj` is not a string or allocation fails.
+ * 
+ * @note A rope is flattened (and cached) on first access.
+ */
+char *string_chars(object_t *obj);
+
+/**
+ * @brief Get the length of a string object in constant time.
+ * 
+ * @param obj String object.
+ * @return Number of bytes in the string, or 0 if `obj` is not a string.
+ */
+size_t string_length(object_t *obj);
+
+/**
+ * @brief Get the hash of a string object's contents.
+ * 
+ * @param obj String object.
+ * @return Non-zero hash of the contents, or 0 if `obj` is not a string.
+ * 
+ * @note Computed on first use (without flattening ropes) and cached in the object.
+ */
+size_t string_hash(object_t *obj);
+
+/**
+ * @brief Compare the contents of two string objects.
+ * 
+ * @param a First string object.
+ * @param b Second string object.
+ * @return True if both are strings with the same bytes.
+ * 
+ * @note Lengths and cached hashes are compared before any byte is touched.
+ */
+bool string_equal(object_t *a, object_t *b);
+
+/**
+ * @brief Hash an object for use as a map key.
+ * 
+ * @param obj Object to hash.
+ * @return Hash of the value for numbers and strings, of the identity otherwise.
+ */
+size_t object_hash(object_t *obj);
+
+/**
+ * @brief Compare two objects as map keys.
+ * 
+ * @param a First object.
+ * @param b Second object.
+ * @return True if both are numbers/strings of the same kind and value, or the same object.
+ * 
+ * @note Float keys follow the hash: 0.0 equals -0.0, and NaN equals NaN.
+ */
+bool object_equal(object_t *a, object_t *b);
+
+/**
+ * @brief Number of bytes owned by an object.
+ * 
+ * @param obj Object to measure.
+ * @return Size of the object, plus its payload unless the payload is shared.
+ * 
+ * @note Rope nodes of unflattened strings are not counted.
+ */
+size_t object_size(object_t *obj);
@@ -1,6 +1,10 @@
 #include <string.h>
 
 #include "object_ms.h"
+#include "buffer.h"
+#include "hashmap.h"
+#include "heap_profile.h"
+#include "recorder.h"
 
 /**
  * @brief Create a new object within a specific virtual machine context and track it.
@@ -18,7 +22,63 @@ static object_t *_new_object_tr(vm_t *vm)
         return NULL;
 
     obj->is_marked = false;
-    vm_track_object(vm, obj);
+    if (!vm_track_object(vm, obj))
+    {
+        free(obj);
+        return NULL;
+    }
+    return obj;
+}
+
+/**
+ * @brief Take back an object from `_new_object_tr` whose construction failed.
+ * 
+ * @param vm Pointer to the virtual machine tracking the object.
+ * @param obj Object without payload, not yet accounted, freed here.
+ */
+static void _discard_tr(vm_t *vm, object_t *obj)
+{
+    vm_untrack_object(vm, obj);
+    free(obj);
+}
+
+/**
+ * @brief Finish creating an object: count it in the live heap, offer it to the
+ *        heap profiler and record it.
+ * 
+ * @param vm Pointer to the virtual machine tracking the object.
+ * @param obj Fully initialised object.
+ */
+static void _account_tr(vm_t *vm, object_t *obj)
+{
+    vm_heap_account(vm, obj);
+    heap_profile_sample(obj);
+    recorder_new(obj);
+}
+
+/**
+ * @brief Create a new object owning a buffer payload and track it in the matching space.
+ * 
+ * @param vm Pointer to the virtual machine context used to track the object.
+ * @param payload Buffer payload that the object will own.
+ * @return Pointer to the newly allocated object, or NULL if allocation fails.
+ * 
+ * @note Objects with a mapped payload go to the large object space.
+ */
+static object_t *_new_payload_object_tr(vm_t *vm, void *payload)
+{
+    if (!buffer_is_mapped(payload))
+        return _new_object_tr(vm);
+
+    object_t *obj = calloc(1, sizeof(object_t));
+    if (obj == NULL)
+        return NULL;
+
+    if (!vm_track_large_object(vm, obj))
+    {
+        free(obj);
+        return NULL;
+    }
     return obj;
 }
 
@@ -31,6 +91,7 @@ object_t *new_integer_ms(vm_t *vm, int value)
     ptr->kind = INTEGER;
     ptr->data.v_int = value;
 
+    _account_tr(vm, ptr);
     return ptr;
 }
 
@@ -43,26 +104,34 @@ object_t *new_float_ms(vm_t *vm, float value)
     ptr->kind = FLOAT;
     ptr->data.v_float = value;
 
+    _account_tr(vm, ptr);
     return ptr;
 }
 
 object_t *new_string_ms(vm_t *vm, char *value)
 {
-    object_t *ptr = _new_object_tr(vm);
-    if (ptr == NULL)
-        return NULL;
+    return new_string_len_ms(vm, value, strlen(value));
+}
 
-    char *dst = malloc(strlen(value) + 1);
+object_t *new_string_len_ms(vm_t *vm, const char *bytes, size_t length)
+{
+    char *dst = buffer_new(length + 1);
     if (dst == NULL)
+        return NULL;
+    memcpy(dst, bytes, length);
+
+    object_t *ptr = _new_payload_object_tr(vm, dst);
+    if (ptr == NULL)
     {
-        free(ptr);
+        buffer_release(dst);
         return NULL;
     }
-    strcpy(dst, value);
 
     ptr->kind = STRING;
-    ptr->data.v_string = dst;
+    ptr->data.v_string.chars = dst;
+    ptr->data.v_string.length = length;
 
+    _account_tr(vm, ptr);
     return ptr;
 }
 
@@ -83,21 +152,52 @@ object_t *new_vector3_ms(vm_t *vm, object_t *x, object_t *y, object_t *z)
     ptr->data.v_vector3.z = z;
     ptr->kind = VECTOR3;
 
+    _account_tr(vm, ptr);
     return ptr;
 }
 
-object_t *new_array_ms(vm_t *vm, size_t size)
+object_t *new_vector3i_ms(vm_t *vm, int x, int y, int z)
 {
     object_t *ptr = _new_object_tr(vm);
     if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = VECTOR3I;
+    ptr->data.v_packed_vector3.i[0] = x;
+    ptr->data.v_packed_vector3.i[1] = y;
+    ptr->data.v_packed_vector3.i[2] = z;
+
+    _account_tr(vm, ptr);
+    return ptr;
+}
+
+object_t *new_vector3f_ms(vm_t *vm, float x, float y, float z)
+{
+    object_t *ptr = _new_object_tr(vm);
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = VECTOR3F;
+    ptr->data.v_packed_vector3.f[0] = x;
+    ptr->data.v_packed_vector3.f[1] = y;
+    ptr->data.v_packed_vector3.f[2] = z;
+
+    _account_tr(vm, ptr);
+    return ptr;
+}
+
+object_t *new_array_ms(vm_t *vm, size_t size)
+{
+    object_t **elem_ptr = buffer_new(size * sizeof(object_t *));
+    if (elem_ptr == NULL)
     {
         return NULL;
     }
 
-    object_t **elem_ptr = calloc(size, sizeof(object_t *));
-    if (elem_ptr == NULL)
+    object_t *ptr = _new_payload_object_tr(vm, elem_ptr);
+    if (ptr == NULL)
     {
-        free(ptr);
+        buffer_release(elem_ptr);
         return NULL;
     }
 
@@ -105,5 +205,282 @@ object_t *new_array_ms(vm_t *vm, size_t size)
     ptr->data.v_array.size = size;
     ptr->data.v_array.elements = elem_ptr;
 
+    _account_tr(vm, ptr);
     return ptr;
 }
+
+/**
+ * @brief Account for a resized array and keep it in the space its payload belongs to.
+ * 
+ * @param vm Pointer to the virtual machine tracking the array.
+ * @param array Array object whose elements buffer was just replaced.
+ * @param old_size Size of the array before the resize.
+ * @param was_mapped Whether the old elements buffer was mapped.
+ */
+static void _array_resized_tr(vm_t *vm, object_t *array, size_t old_size, bool was_mapped)
+{
+    vm_heap_resize(vm, array, old_size);
+    if (buffer_is_mapped(array->data.v_array.elements) != was_mapped)
+    {
+        vm_move_object_space(vm, array, !was_mapped);
+    }
+}
+
+/**
+ * @brief Make sure an array owns its elements buffer and can hold `capacity` elements.
+ * 
+ * @param vm Pointer to the virtual machine tracking the array.
+ * @param array Array object.
+ * @param capacity Minimum number of element slots.
+ * @return True if successful, false if allocation fails.
+ */
+static bool _array_reserve_tr(vm_t *vm, object_t *array, size_t capacity)
+{
+    size_t old_size = object_size(array);
+    bool was_mapped = buffer_is_mapped(array->data.v_array.elements);
+    object_t **elements = buffer_reserve(array->data.v_array.elements,
+                                         array->data.v_array.size * sizeof(object_t *),
+                                         capacity * sizeof(object_t *));
+    if (elements == NULL)
+    {
+        return false;
+    }
+    array->data.v_array.elements = elements;
+    _array_resized_tr(vm, array, old_size, was_mapped);
+    return true;
+}
+
+bool array_set_ms(vm_t *vm, object_t *array, size_t index, object_t *value)
+{
+    if (array == NULL || value == NULL || array->kind != ARRAY)
+    {
+        return false;
+    }
+
+    if (index >= array->data.v_array.size)
+    {
+        return false;
+    }
+
+    if (!_array_reserve_tr(vm, array, array->data.v_array.size))
+    {
+        return false;
+    }
+
+    array->data.v_array.elements[index] = value;
+    recorder_array_set(array, index, value);
+    return true;
+}
+
+bool array_push_ms(vm_t *vm, object_t *array, object_t *value)
+{
+    if (array == NULL || value == NULL || array->kind != ARRAY)
+    {
+        return false;
+    }
+
+    size_t needed = array->data.v_array.size + 1;
+    size_t capacity = buffer_capacity(array->data.v_array.elements) / sizeof(object_t *);
+    if (needed > capacity)
+    {
+        capacity = (needed > capacity * 2) ? needed : capacity * 2;
+    }
+    if (!_array_reserve_tr(vm, array, capacity))
+    {
+        return false;
+    }
+
+    array->data.v_array.elements[array->data.v_array.size++] = value;
+    recorder_array_push(array, value);
+    return true;
+}
+
+object_t *array_pop_ms(vm_t *vm, object_t *array)
+{
+    if (array == NULL || array->kind != ARRAY || array->data.v_array.size == 0)
+    {
+        return NULL;
+    }
+
+    if (!_array_reserve_tr(vm, array, array->data.v_array.size))
+    {
+        return NULL;
+    }
+
+    size_t last = --array->data.v_array.size;
+    object_t *value = array->data.v_array.elements[last];
+    array->data.v_array.elements[last] = NULL;
+    recorder_array_pop(array);
+    return value;
+}
+
+bool array_reserve_ms(vm_t *vm, object_t *array, size_t capacity)
+{
+    if (array == NULL || array->kind != ARRAY)
+    {
+        return false;
+    }
+
+    if (capacity < array->data.v_array.size)
+    {
+        capacity = array->data.v_array.size;
+    }
+    return _array_reserve_tr(vm, array, capacity);
+}
+
+bool array_shrink_to_fit_ms(vm_t *vm, object_t *array)
+{
+    if (array == NULL || array->kind != ARRAY)
+    {
+        return false;
+    }
+
+    size_t old_size = object_size(array);
+    bool was_mapped = buffer_is_mapped(array->data.v_array.elements);
+    object_t **elements = buffer_shrink(array->data.v_array.elements,
+                                        array->data.v_array.size * sizeof(object_t *));
+    if (elements == NULL)
+    {
+        return false;
+    }
+    array->data.v_array.elements = elements;
+    _array_resized_tr(vm, array, old_size, was_mapped);
+    return true;
+}
+
+/**
+ * @brief Create a new packed array object with its values allocated inline and track it.
+ * 
+ * @param vm Pointer to the virtual machine context used to track the object.
+ * @param kind INT_ARRAY or FLOAT_ARRAY.
+ * @param size Number of values, initialised to 0.
+ * @return Pointer to the new object, or NULL if allocation fails.
+ */
+static object_t *_new_packed_array_tr(vm_t *vm, object_kind_t kind, size_t size)
+{
+    size_t elem_size = kind == INT_ARRAY ? sizeof(int) : sizeof(float);
+    object_t *ptr = calloc(1, sizeof(object_t) + size * elem_size);
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = kind;
+    ptr->data.v_packed.size = size;
+    ptr->data.v_packed.values = ptr + 1;
+    if (!vm_track_object(vm, ptr))
+    {
+        free(ptr);
+        return NULL;
+    }
+    _account_tr(vm, ptr);
+    return ptr;
+}
+
+object_t *new_int_array_ms(vm_t *vm, size_t size)
+{
+    return _new_packed_array_tr(vm, INT_ARRAY, size);
+}
+
+object_t *new_float_array_ms(vm_t *vm, size_t size)
+{
+    return _new_packed_array_tr(vm, FLOAT_ARRAY, size);
+}
+
+object_t *new_map_ms(vm_t *vm)
+{
+    object_t *ptr = _new_object_tr(vm);
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = MAP;
+    _account_tr(vm, ptr);
+    return ptr;
+}
+
+object_t *new_ephemeron_map_ms(vm_t *vm)
+{
+    object_t *ptr = _new_object_tr(vm);
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = MAP;
+    ptr->data.v_map.weak_keys = true;
+    if (!vm_track_weak(vm, ptr))
+    {
+        _discard_tr(vm, ptr);
+        return NULL;
+    }
+    _account_tr(vm, ptr);
+    return ptr;
+}
+
+bool map_set_ms(vm_t *vm, object_t *map, object_t *key, object_t *value)
+{
+    if (map == NULL || key == NULL || value == NULL || map->kind != MAP)
+    {
+        return false;
+    }
+
+    size_t old_size = object_size(map);
+    map_entry_t old;
+    if (!hashmap_put(&map->data.v_map, key, value, &old))
+    {
+        return false;
+    }
+    vm_heap_resize(vm, map, old_size);
+    recorder_map_set(map, key, value);
+    return true;
+}
+
+object_t *map_get_ms(vm_t *vm, object_t *map, object_t *key)
+{
+    if (map == NULL || map->kind != MAP)
+    {
+        return NULL;
+    }
+
+    map_entry_t *entry = hashmap_find(&map->data.v_map, key);
+    return entry != NULL ? entry->value : NULL;
+}
+
+bool map_remove_ms(vm_t *vm, object_t *map, object_t *key)
+{
+    if (map == NULL || map->kind != MAP)
+    {
+        return false;
+    }
+
+    map_entry_t old;
+    if (!hashmap_remove(&map->data.v_map, key, &old))
+    {
+        return false;
+    }
+    recorder_map_remove(map, key);
+    return true;
+}
+
+object_t *new_weak_ms(vm_t *vm, object_t *target)
+{
+    object_t *ptr = _new_object_tr(vm);
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = WEAK;
+    ptr->data.v_weak = target;
+    if (!vm_track_weak(vm, ptr))
+    {
+        _discard_tr(vm, ptr);
+        return NULL;
+    }
+    _account_tr(vm, ptr);
+    return ptr;
+}
+
+object_t *weak_get_ms(vm_t *vm, object_t *weak)
+{
+    if (weak == NULL || weak->kind != WEAK)
+    {
+        return NULL;
+    }
+
+    return weak->data.v_weak;
+}
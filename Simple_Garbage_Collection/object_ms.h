@@ -29,6 +29,16 @@ object_t *new_float_ms(vm_t *vm, float value);
  */
 object_t *new_string_ms(vm_t *vm, char *value);
 
+/**
+ * @brief Create a new string object from raw bytes within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param bytes Bytes to initialize the object with, may contain NULs.
+ * @param length Number of bytes.
+ * @return Pointer to the new string object.
+ */
+object_t *new_string_len_ms(vm_t *vm, const char *bytes, size_t length);
+
 /**
  * @brief Create a new 3D vector object within a specific virtual machine context.
  * 
@@ -40,6 +50,28 @@ object_t *new_string_ms(vm_t *vm, char *value);
  */
 object_t *new_vector3_ms(vm_t *vm, object_t *x, object_t *y, object_t *z);
 
+/**
+ * @brief Create a new unboxed 3D vector of integers within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param x X coordinate of the vector.
+ * @param y Y coordinate of the vector.
+ * @param z Z coordinate of the vector.
+ * @return Pointer to the new VECTOR3I object.
+ */
+object_t *new_vector3i_ms(vm_t *vm, int x, int y, int z);
+
+/**
+ * @brief Create a new unboxed 3D vector of floats within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param x X coordinate of the vector.
+ * @param y Y coordinate of the vector.
+ * @param z Z coordinate of the vector.
+ * @return Pointer to the new VECTOR3F object.
+ */
+object_t *new_vector3f_ms(vm_t *vm, float x, float y, float z);
+
 /**
  * @brief Create a new array object within a specific virtual machine context.
  * 
@@ -48,3 +80,144 @@ object_t *new_vector3_ms(vm_t *vm, object_t *x, object_t *y, object_t *z);
  * @return Pointer to the new array object.
  */
 object_t *new_array_ms(vm_t *vm, size_t size);
+
+/**
+ * @brief Set an element in an array object within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param array Array object.
+ * @param index Index at which to set the value.
+ * @param value Value to set at the specified index.
+ * @return True if successful, false otherwise.
+ * 
+ * @note A shared elements buffer is copied before being modified.
+ */
+bool array_set_ms(vm_t *vm, object_t *array, size_t index, object_t *value);
+
+/**
+ * @brief Append an element to an array object, growing it when needed.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param array Array object.
+ * @param value Value to append.
+ * @return True if successful, false otherwise.
+ * 
+ * @note Capacity grows geometrically, so repeated pushes are amortised O(1).
+ */
+bool array_push_ms(vm_t *vm, object_t *array, object_t *value);
+
+/**
+ * @brief Remove the last element of an array object.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param array Array object.
+ * @return The removed element, or NULL if the array is empty.
+ */
+object_t *array_pop_ms(vm_t *vm, object_t *array);
+
+/**
+ * @brief Make room for at least `capacity` elements without changing the size.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param array Array object.
+ * @param capacity Number of elements to make room for.
+ * @return True if successful, false otherwise.
+ */
+bool array_reserve_ms(vm_t *vm, object_t *array, size_t capacity);
+
+/**
+ * @brief Release the unused capacity of an array object.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param array Array object.
+ * @return True if successful, false otherwise.
+ */
+bool array_shrink_to_fit_ms(vm_t *vm, object_t *array);
+
+/**
+ * @brief Create a new packed array of `int` values within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param size Number of values, initialised to 0.
+ * @return Pointer to the new INT_ARRAY object.
+ */
+object_t *new_int_array_ms(vm_t *vm, size_t size);
+
+/**
+ * @brief Create a new packed array of `float` values within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param size Number of values, initialised to 0.
+ * @return Pointer to the new FLOAT_ARRAY object.
+ */
+object_t *new_float_array_ms(vm_t *vm, size_t size);
+
+/**
+ * @brief Create a new, empty map object within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @return Pointer to the new MAP object.
+ */
+object_t *new_map_ms(vm_t *vm);
+
+/**
+ * @brief Create a new, empty ephemeron map within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @return Pointer to the new MAP object.
+ * 
+ * @note Keys are held weakly: a value is traced only while its key is reachable
+ *       otherwise, and `sweep` removes the entries of unreachable keys.
+ */
+object_t *new_ephemeron_map_ms(vm_t *vm);
+
+/**
+ * @brief Associate a value with a key in a map object.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param map Map object.
+ * @param key Key, any object; numbers and strings are compared by value.
+ * @param value Value to associate with the key.
+ * @return True if successful, false otherwise.
+ */
+bool map_set_ms(vm_t *vm, object_t *map, object_t *key, object_t *value);
+
+/**
+ * @brief Get the value associated with a key in a map object.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param map Map object.
+ * @param key Key to look up.
+ * @return Pointer to the value, or NULL if the key is absent.
+ */
+object_t *map_get_ms(vm_t *vm, object_t *map, object_t *key);
+
+/**
+ * @brief Remove a key from a map object.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param map Map object.
+ * @param key Key to remove.
+ * @return True if the key was present, false otherwise.
+ */
+bool map_remove_ms(vm_t *vm, object_t *map, object_t *key);
+
+/**
+ * @brief Create a new weak reference within a specific virtual machine context.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param target Object to refer to without keeping it alive.
+ * @return Pointer to the new WEAK object.
+ * 
+ * @note The reference is cleared by `sweep` when the target is unmarked.
+ */
+object_t *new_weak_ms(vm_t *vm, object_t *target);
+
+/**
+ * @brief Get the target of a weak reference.
+ * 
+ * @param vm Pointer to the virtual machine context.
+ * @param weak WEAK object.
+ * @return Pointer to the target, or NULL if it has been collected.
+ */
+object_t *weak_get_ms(vm_t *vm, object_t *weak);
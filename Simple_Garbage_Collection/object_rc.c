@@ -1,6 +1,33 @@
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include "object_rc.h"
+#include "buffer.h"
+#include "rope.h"
+#include "simd.h"
+#include "hashmap.h"
+#include "ptrmap.h"
+#include "stack.h"
+#include "heap_profile.h"
+
+/**
+ * @brief Weak holders of every weakly referenced object.
+ * 
+ * Maps a target to a `stack_t` of the WEAK objects and ephemeron maps that
+ * refer to it; targets carry OBJECT_FLAG_WEAK_TARGET so that freeing any
+ * other object skips the lookup.
+ */
+static ptrmap_t _weak_registry;
+
+/**
+ * @brief Registered finalizers, mapping an object to its `finalizer_entry_t`.
+ */
+static ptrmap_t _finalizers;
+
+/**
+ * @brief Finalizers of dead objects, waiting for `run_finalizers`.
+ */
+static stack_t *_finalize_queue;
 
 /**
  * @brief Create a new object with an initial reference count of 1.
@@ -20,6 +47,265 @@ static object_t *_new_object(void)
     return ptr;
 }
 
+/**
+ * @brief Create a new packed array object with its values allocated inline.
+ * 
+ * @param kind INT_ARRAY or FLOAT_ARRAY.
+ * @param size Number of values, initialised to 0.
+ * @return Pointer to the new object, or NULL if allocation fails.
+ * 
+ * @note The values live right after the `object_t`, so `free(obj)` releases both.
+ */
+static object_t *_new_packed_array(object_kind_t kind, size_t size)
+{
+    size_t elem_size = kind == INT_ARRAY ? sizeof(int) : sizeof(float);
+    object_t *ptr = calloc(1, sizeof(object_t) + size * elem_size);
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->refcount = 1;
+    ptr->kind = kind;
+    ptr->data.v_packed.size = size;
+    ptr->data.v_packed.values = ptr + 1;
+    heap_profile_sample(ptr);
+    return ptr;
+}
+
+/**
+ * @brief Run the element-wise SIMD kernel for two packed arrays of the same size.
+ * 
+ * @param dst Packed array receiving the sums, of the result kind; may be `a` or `b`.
+ * @param a First packed array.
+ * @param b Second packed array.
+ */
+static void _add_packed(object_t *dst, object_t *a, object_t *b)
+{
+    size_t n = a->data.v_packed.size;
+    if (a->kind == INT_ARRAY && b->kind == INT_ARRAY)
+    {
+        simd_add_int(dst->data.v_packed.values, a->data.v_packed.values, b->data.v_packed.values, n);
+    }
+    else if (a->kind == INT_ARRAY)
+    {
+        simd_add_int_float(dst->data.v_packed.values, a->data.v_packed.values, b->data.v_packed.values, n);
+    }
+    else if (b->kind == INT_ARRAY)
+    {
+        simd_add_int_float(dst->data.v_packed.values, b->data.v_packed.values, a->data.v_packed.values, n);
+    }
+    else
+    {
+        simd_add_float(dst->data.v_packed.values, a->data.v_packed.values, b->data.v_packed.values, n);
+    }
+}
+
+/**
+ * @brief Add two unboxed vectors with a single SIMD operation.
+ * 
+ * @param dst Vector receiving the sum, of the result kind; may be `a` or `b`.
+ * @param a First unboxed vector.
+ * @param b Second unboxed vector.
+ */
+static void _add_packed_vector3(object_t *dst, object_t *a, object_t *b)
+{
+    packed_vector_t *va = &a->data.v_packed_vector3;
+    packed_vector_t *vb = &b->data.v_packed_vector3;
+    packed_vector_t *vd = &dst->data.v_packed_vector3;
+    if (a->kind == VECTOR3I && b->kind == VECTOR3I)
+    {
+        simd_add_int4(vd->i, va->i, vb->i);
+    }
+    else if (a->kind == VECTOR3I)
+    {
+        simd_add_int_float4(vd->f, va->i, vb->f);
+    }
+    else if (b->kind == VECTOR3I)
+    {
+        simd_add_int_float4(vd->f, vb->i, va->f);
+    }
+    else
+    {
+        simd_add_float4(vd->f, va->f, vb->f);
+    }
+}
+
+/**
+ * @brief Record that `holder` refers weakly to `target`.
+ * 
+ * @param target Object referred to.
+ * @param holder WEAK object or ephemeron map.
+ * @return True if successful, false if allocation fails.
+ */
+static bool _weak_register(object_t *target, object_t *holder)
+{
+    stack_t *holders = ptrmap_get(&_weak_registry, target);
+    if (holders == NULL)
+    {
+        holders = stack_new(2);
+        if (holders == NULL)
+            return false;
+
+        if (!ptrmap_put(&_weak_registry, target, holders))
+        {
+            stack_free(holders);
+            return false;
+        }
+    }
+
+    if (!stack_push(holders, holder))
+    {
+        if (holders->count == 0)
+        {
+            stack_free(ptrmap_remove(&_weak_registry, target));
+        }
+        return false;
+    }
+    target->flags |= OBJECT_FLAG_WEAK_TARGET;
+    return true;
+}
+
+/**
+ * @brief Forget one weak reference from `holder` to `target`.
+ * 
+ * @param target Object referred to.
+ * @param holder WEAK object or ephemeron map.
+ */
+static void _weak_unregister(object_t *target, object_t *holder)
+{
+    stack_t *holders = ptrmap_get(&_weak_registry, target);
+    if (holders == NULL)
+        return;
+
+    for (size_t i = 0; i < holders->count; i++)
+    {
+        if (holders->data[i] == holder)
+        {
+            holders->data[i] = holders->data[--holders->count];
+            break;
+        }
+    }
+
+    if (holders->count == 0)
+    {
+        stack_free(ptrmap_remove(&_weak_registry, target));
+        target->flags &= ~OBJECT_FLAG_WEAK_TARGET;
+    }
+}
+
+/**
+ * @brief Clear every weak reference to an object that is being freed.
+ * 
+ * @param target Object about to be freed.
+ * 
+ * @note WEAK objects are set to NULL and ephemeron entries keyed by `target`
+ *       are removed. Releasing such an entry's value can free other holders,
+ *       which unregister themselves, so the list is re-read on every step.
+ */
+static void _weak_clear(object_t *target)
+{
+    stack_t *holders;
+    while ((holders = ptrmap_get(&_weak_registry, target)) != NULL && holders->count > 0)
+    {
+        object_t *holder = stack_pop(holders);
+        if (holder->kind == WEAK)
+        {
+            holder->data.v_weak = NULL;
+        }
+        else
+        {
+            map_entry_t old;
+            if (hashmap_remove(&holder->data.v_map, target, &old))
+            {
+                release_reference(&old.value);
+            }
+        }
+    }
+
+    stack_free(ptrmap_remove(&_weak_registry, target));
+    target->flags &= ~OBJECT_FLAG_WEAK_TARGET;
+}
+
+bool object_set_finalizer(object_t *obj, finalizer_t fn, void *context)
+{
+    if (obj == NULL)
+        return false;
+
+    finalizer_entry_t *entry = ptrmap_get(&_finalizers, obj);
+    if (fn == NULL)
+    {
+        free(ptrmap_remove(&_finalizers, obj));
+        obj->flags &= ~OBJECT_FLAG_FINALIZABLE;
+        return true;
+    }
+
+    if (entry == NULL)
+    {
+        entry = malloc(sizeof(finalizer_entry_t));
+        if (entry == NULL)
+            return false;
+
+        if (!ptrmap_put(&_finalizers, obj, entry))
+        {
+            free(entry);
+            return false;
+        }
+    }
+
+    entry->obj = obj;
+    entry->fn = fn;
+    entry->context = context;
+    obj->flags |= OBJECT_FLAG_FINALIZABLE;
+    return true;
+}
+
+/**
+ * @brief Move the finalizer of a dead object to the queue, keeping the object alive.
+ * 
+ * @param obj Finalizable object whose last reference was released.
+ * @return True if queued, false if the queue could not grow, in which case the
+ *         finalizer is dropped and the object must be freed as usual.
+ */
+static bool _finalize_enqueue(object_t *obj)
+{
+    finalizer_entry_t *entry = ptrmap_remove(&_finalizers, obj);
+    obj->flags &= ~OBJECT_FLAG_FINALIZABLE;
+
+    if (_finalize_queue == NULL)
+        _finalize_queue = stack_new(8);
+
+    if (_finalize_queue == NULL || !stack_push(_finalize_queue, entry))
+    {
+        free(entry);
+        return false;
+    }
+
+    // The queue owns the object until its finalizer has run
+    obj->refcount = 1;
+    return true;
+}
+
+size_t run_finalizers(void)
+{
+    // Objects queued while finalizing go to a fresh queue and wait for the next call
+    stack_t *queue = _finalize_queue;
+    _finalize_queue = NULL;
+    size_t count = 0;
+    while (queue != NULL && queue->count > 0)
+    {
+        finalizer_entry_t *entry = stack_pop(queue);
+        object_t *obj = entry->obj;
+        entry->fn(obj, entry->context);
+        free(entry);
+        count++;
+
+        // Frees the object, unless the finalizer kept a reference or registered again
+        release_reference(&obj);
+    }
+
+    stack_free(queue);
+    return count;
+}
+
 void add_reference(object_t *obj)
 {
     if (obj == NULL)
@@ -49,6 +335,7 @@ object_t *new_integer(int value)
     ptr->kind = INTEGER;
     ptr->data.v_int = value;
 
+    heap_profile_sample(ptr);
     return ptr;
 }
 
@@ -61,247 +348,1270 @@ object_t *new_float(float value)
     ptr->kind = FLOAT;
     ptr->data.v_float = value;
 
+    heap_profile_sample(ptr);
     return ptr;
 }
 
-object_t *new_string(char *value)
+/**
+ * @brief Wrap a string buffer and/or rope into a new string object.
+ * 
+ * @param chars NUL terminated payload of a `buffer_t` (or NULL), ownership is transferred.
+ * @param rope Concatenation tree (or NULL), ownership is transferred.
+ * @param length Number of bytes in the string.
+ * @return Pointer to the new string object, or NULL if allocation fails.
+ * 
+ * @note On failure the caller's shares of `chars` and `rope` are released.
+ */
+static object_t *_new_string_value(char *chars, rope_t *rope, size_t length)
 {
     object_t *ptr = _new_object();
     if (ptr == NULL)
-        return NULL;
-
-    char *dst = malloc(strlen(value) + 1);
-    if (dst == NULL)
     {
-        free(ptr);
+        buffer_release(chars);
+        rope_release(rope);
         return NULL;
     }
-    strcpy(dst, value);
 
     ptr->kind = STRING;
-    ptr->data.v_string = dst;
+    ptr->data.v_string.chars = chars;
+    ptr->data.v_string.rope = rope;
+    ptr->data.v_string.length = length;
 
+    heap_profile_sample(ptr);
     return ptr;
 }
 
-object_t *new_vector3(object_t *x, object_t *y, object_t *z)
+/**
+ * @brief Get a string object as a rope.
+ * 
+ * @param str String object.
+ * @return New reference to the string's rope (a leaf sharing the buffer of a
+ *         flat string), or NULL if allocation fails.
+ */
+static rope_t *_string_rope(object_t *str)
 {
-
-    if (x == NULL || y == NULL || z == NULL)
-        return NULL;
-
-    object_t *ptr = _new_object();
-    if (ptr == NULL)
+    if (str->data.v_string.rope != NULL)
     {
-        return NULL;
+        return rope_retain(str->data.v_string.rope);
     }
-
-    ptr->data.v_vector3.x = x;
-    add_reference(x);
-    ptr->data.v_vector3.y = y;
-    add_reference(y);
-    ptr->data.v_vector3.z = z;
-    add_reference(z);
-    ptr->kind = VECTOR3;
-
-    return ptr;
+    return rope_leaf(str->data.v_string.chars, str->data.v_string.length);
 }
 
-object_t *new_array(size_t size)
+/**
+ * @brief Wrap an elements buffer into a new array object.
+ * 
+ * @param elements Payload of a `buffer_t` holding `size` element pointers,
+ *        ownership is transferred.
+ * @param size Number of elements in the array.
+ * @return Pointer to the new array object, or NULL if allocation fails.
+ * 
+ * @note On failure the caller's share of `elements` is released.
+ */
+static object_t *_new_array_buffer(object_t **elements, size_t size)
 {
     object_t *ptr = _new_object();
     if (ptr == NULL)
     {
-        return NULL;
-    }
-
-    object_t **elem_ptr = calloc(size, sizeof(object_t *));
-    if (elem_ptr == NULL)
-    {
-        free(ptr);
+        buffer_release(elements);
         return NULL;
     }
 
     ptr->kind = ARRAY;
     ptr->data.v_array.size = size;
-    ptr->data.v_array.elements = elem_ptr;
+    ptr->data.v_array.elements = elements;
 
+    heap_profile_sample(ptr);
     return ptr;
 }
 
-bool array_set(object_t *array, size_t index, object_t *value)
+/**
+ * @brief Make sure an array owns its elements buffer and can hold `capacity` elements.
+ * 
+ * @param array Array object.
+ * @param capacity Minimum number of element slots.
+ * @return True if successful, false if allocation fails.
+ * 
+ * @note Element references are held by the buffer, so un-sharing a buffer
+ *       adds a reference to every element of the private copy.
+ */
+static bool _array_reserve(object_t *array, size_t capacity)
 {
-    if (array == NULL || value == NULL || array->kind != ARRAY)
+    object_t **elements = array->data.v_array.elements;
+    bool shared = buffer_is_shared(elements);
+    if (!shared && capacity * sizeof(object_t *) <= buffer_capacity(elements))
     {
-        return false;
+        return true;
     }
 
-    if (index >= array->data.v_array.size)
+    elements = buffer_reserve(elements, array->data.v_array.size * sizeof(object_t *),
+                              capacity * sizeof(object_t *));
+    if (elements == NULL)
     {
         return false;
     }
-    
-    // Object already at index
-    if (array->data.v_array.elements[index] != NULL)
+
+    if (shared)
     {
-        release_reference(&array->data.v_array.elements[index]);
+        for (size_t i = 0; i < array->data.v_array.size; i++)
+        {
+            add_reference(elements[i]);
+        }
     }
-    
-    array->data.v_array.elements[index] = value;
-    add_reference(array->data.v_array.elements[index]);
+    array->data.v_array.elements = elements;
     return true;
 }
 
-object_t *array_get(object_t *array, size_t index)
+/**
+ * @brief Grow an array geometrically so that it can hold `needed` elements.
+ * 
+ * @param array Array object.
+ * @param needed Number of elements the array must be able to hold.
+ * @return True if successful, false if allocation fails.
+ * 
+ * @note Doubling keeps repeated appends amortised O(1).
+ */
+static bool _array_grow(object_t *array, size_t needed)
 {
-    if (array == NULL || array->kind != ARRAY)
+    size_t capacity = buffer_capacity(array->data.v_array.elements) / sizeof(object_t *);
+    if (needed > capacity)
     {
-        return NULL;
+        capacity = (needed > capacity * 2) ? needed : capacity * 2;
     }
+    return _array_reserve(array, capacity);
+}
 
-    if (index >= array->data.v_array.size)
-    {
-        return NULL;
-    }
-    
-    return array->data.v_array.elements[index];
+object_t *new_string(char *value)
+{
+    return new_string_len(value, strlen(value));
 }
 
-int length(object_t *obj)
+object_t *new_string_len(const char *bytes, size_t length)
 {
-    if (obj == NULL)
-    {
-        return -1;
-    }
+    char *dst = buffer_new(length + 1);
+    if (dst == NULL)
+        return NULL;
 
-    switch (obj->kind)
-    {
-    case INTEGER:
-        return 1;
-    case FLOAT:
-        return 1;
-    case STRING:
-        return strlen(obj->data.v_string);
-    case VECTOR3:
-        return 3;
-    case ARRAY:
-        return obj->data.v_array.size;
-    default:
-        return -1;
-    }
+    memcpy(dst, bytes, length);
+
+    return _new_string_value(dst, NULL, length);
 }
 
-object_t *add(object_t *a, object_t *b)
+object_t *new_vector3(object_t *x, object_t *y, object_t *z)
 {
-    if (a == NULL || b == NULL)
+
+    if (x == NULL || y == NULL || z == NULL)
+        return NULL;
+
+    object_t *ptr = _new_object();
+    if (ptr == NULL)
     {
         return NULL;
     }
 
-    object_t *ptr = NULL;
+    ptr->data.v_vector3.x = x;
+    add_reference(x);
+    ptr->data.v_vector3.y = y;
+    add_reference(y);
+    ptr->data.v_vector3.z = z;
+    add_reference(z);
+    ptr->kind = VECTOR3;
 
-    switch (a->kind)
-    {
-    case INTEGER:
-        if (b->kind == INTEGER)
+    heap_profile_sample(ptr);
+    return ptr;
+}
+
+object_t *new_vector3i(int x, int y, int z)
+{
+    object_t *ptr = _new_object();
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = VECTOR3I;
+    ptr->data.v_packed_vector3.i[0] = x;
+    ptr->data.v_packed_vector3.i[1] = y;
+    ptr->data.v_packed_vector3.i[2] = z;
+
+    heap_profile_sample(ptr);
+    return ptr;
+}
+
+object_t *new_vector3f(float x, float y, float z)
+{
+    object_t *ptr = _new_object();
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = VECTOR3F;
+    ptr->data.v_packed_vector3.f[0] = x;
+    ptr->data.v_packed_vector3.f[1] = y;
+    ptr->data.v_packed_vector3.f[2] = z;
+
+    heap_profile_sample(ptr);
+    return ptr;
+}
+
+object_t *new_array(size_t size)
+{
+    object_t **elem_ptr = buffer_new(size * sizeof(object_t *));
+    if (elem_ptr == NULL)
+    {
+        return NULL;
+    }
+
+    return _new_array_buffer(elem_ptr, size);
+}
+
+object_t *new_int_array(size_t size)
+{
+    return _new_packed_array(INT_ARRAY, size);
+}
+
+object_t *new_float_array(size_t size)
+{
+    return _new_packed_array(FLOAT_ARRAY, size);
+}
+
+object_t *new_map(void)
+{
+    object_t *ptr = _new_object();
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = MAP;
+    heap_profile_sample(ptr);
+    return ptr;
+}
+
+object_t *new_ephemeron_map(void)
+{
+    object_t *ptr = new_map();
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->data.v_map.weak_keys = true;
+    return ptr;
+}
+
+object_t *new_weak(object_t *target)
+{
+    object_t *ptr = _new_object();
+    if (ptr == NULL)
+        return NULL;
+
+    ptr->kind = WEAK;
+    ptr->data.v_weak = target;
+    if (target != NULL && !_weak_register(target, ptr))
+    {
+        free(ptr);
+        return NULL;
+    }
+    heap_profile_sample(ptr);
+    return ptr;
+}
+
+object_t *weak_get(object_t *weak)
+{
+    if (weak == NULL || weak->kind != WEAK)
+    {
+        return NULL;
+    }
+
+    return weak->data.v_weak;
+}
+
+/**
+ * @brief Associate a value with a key in an ephemeron map.
+ * 
+ * @param map Map object with weak keys.
+ * @param key Key, registered as a weak reference instead of being referenced.
+ * @param value Value to associate with the key, a reference is added.
+ * @return True if successful, false otherwise.
+ */
+static bool _ephemeron_set(object_t *map, object_t *key, object_t *value)
+{
+    if (!_weak_register(key, map))
+    {
+        return false;
+    }
+
+    map_entry_t old;
+    if (!hashmap_put(&map->data.v_map, key, value, &old))
+    {
+        _weak_unregister(key, map);
+        return false;
+    }
+    add_reference(value);
+
+    // Key already present, the replaced key (possibly `key` itself) was registered once
+    if (old.key != NULL)
+    {
+        _weak_unregister(old.key, map);
+    }
+    release_reference(&old.value);
+    return true;
+}
+
+bool map_set(object_t *map, object_t *key, object_t *value)
+{
+    if (map == NULL || key == NULL || value == NULL || map->kind != MAP)
+    {
+        return false;
+    }
+
+    if (map->data.v_map.weak_keys)
+    {
+        return _ephemeron_set(map, key, value);
+    }
+
+    map_entry_t old;
+    if (!hashmap_put(&map->data.v_map, key, value, &old))
+    {
+        return false;
+    }
+    add_reference(key);
+    add_reference(value);
+
+    // Key already present, drop the references to the replaced pair
+    release_reference(&old.key);
+    release_reference(&old.value);
+    return true;
+}
+
+object_t *map_get(object_t *map, object_t *key)
+{
+    if (map == NULL || map->kind != MAP)
+    {
+        return NULL;
+    }
+
+    map_entry_t *entry = hashmap_find(&map->data.v_map, key);
+    return entry != NULL ? entry->value : NULL;
+}
+
+bool map_remove(object_t *map, object_t *key)
+{
+    if (map == NULL || map->kind != MAP)
+    {
+        return false;
+    }
+
+    map_entry_t old;
+    if (!hashmap_remove(&map->data.v_map, key, &old))
+    {
+        return false;
+    }
+
+    if (map->data.v_map.weak_keys)
+    {
+        _weak_unregister(old.key, map);
+    }
+    else
+    {
+        release_reference(&old.key);
+    }
+    release_reference(&old.value);
+    return true;
+}
+
+object_t *object_copy(object_t *obj)
+{
+    if (obj == NULL)
+    {
+        return NULL;
+    }
+
+    switch (obj->kind)
+    {
+    case INTEGER:
+        return new_integer(obj->data.v_int);
+    case FLOAT:
+        return new_float(obj->data.v_float);
+    case STRING:
+    {
+        object_t *copy = _new_string_value(buffer_retain(obj->data.v_string.chars),
+                                           rope_retain(obj->data.v_string.rope),
+                                           obj->data.v_string.length);
+        if (copy != NULL)
+        {
+            copy->data.v_string.hash = obj->data.v_string.hash;
+        }
+        return copy;
+    }
+    case VECTOR3:
+        return new_vector3(obj->data.v_vector3.x, obj->data.v_vector3.y, obj->data.v_vector3.z);
+    case ARRAY:
+        return _new_array_buffer(buffer_retain(obj->data.v_array.elements), obj->data.v_array.size);
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+    {
+        object_t *copy = _new_packed_array(obj->kind, obj->data.v_packed.size);
+        if (copy != NULL)
+        {
+            memcpy(copy->data.v_packed.values, obj->data.v_packed.values,
+                   obj->data.v_packed.size * sizeof(int));
+        }
+        return copy;
+    }
+    case VECTOR3I:
+    case VECTOR3F:
+    {
+        object_t *copy = _new_object();
+        if (copy != NULL)
+        {
+            copy->kind = obj->kind;
+            copy->data.v_packed_vector3 = obj->data.v_packed_vector3;
+            heap_profile_sample(copy);
+        }
+        return copy;
+    }
+    case MAP:
+    {
+        object_t *copy = obj->data.v_map.weak_keys ? new_ephemeron_map() : new_map();
+        for (size_t i = 0; copy != NULL && i < obj->data.v_map.capacity; i++)
+        {
+            map_entry_t *entry = &obj->data.v_map.entries[i];
+            if (entry->key != NULL && !map_set(copy, entry->key, entry->value))
+            {
+                object_free(&copy);
+            }
+        }
+        return copy;
+    }
+    case WEAK:
+        return new_weak(obj->data.v_weak);
+    default:
+        return NULL;
+    }
+}
+
+bool array_set(object_t *array, size_t index, object_t *value)
+{
+    if (array == NULL || value == NULL || array->kind != ARRAY)
+    {
+        return false;
+    }
+
+    if (index >= array->data.v_array.size)
+    {
+        return false;
+    }
+
+    // Copy-on-write: stop sharing the elements buffer before mutating it
+    if (!_array_reserve(array, array->data.v_array.size))
+    {
+        return false;
+    }
+    
+    // Object already at index
+    if (array->data.v_array.elements[index] != NULL)
+    {
+        release_reference(&array->data.v_array.elements[index]);
+    }
+    
+    array->data.v_array.elements[index] = value;
+    add_reference(array->data.v_array.elements[index]);
+    return true;
+}
+
+bool array_push(object_t *array, object_t *value)
+{
+    if (array == NULL || value == NULL || array->kind != ARRAY)
+    {
+        return false;
+    }
+
+    if (!_array_grow(array, array->data.v_array.size + 1))
+    {
+        return false;
+    }
+
+    array->data.v_array.elements[array->data.v_array.size++] = value;
+    add_reference(value);
+    return true;
+}
+
+object_t *array_pop(object_t *array)
+{
+    if (array == NULL || array->kind != ARRAY || array->data.v_array.size == 0)
+    {
+        return NULL;
+    }
+
+    // Copy-on-write: the shared buffer keeps its references for the other owners
+    if (!_array_reserve(array, array->data.v_array.size))
+    {
+        return NULL;
+    }
+
+    size_t last = --array->data.v_array.size;
+    object_t *value = array->data.v_array.elements[last];
+    array->data.v_array.elements[last] = NULL;
+    return value;
+}
+
+bool array_reserve(object_t *array, size_t capacity)
+{
+    if (array == NULL || array->kind != ARRAY)
+    {
+        return false;
+    }
+
+    if (capacity < array->data.v_array.size)
+    {
+        capacity = array->data.v_array.size;
+    }
+    return _array_reserve(array, capacity);
+}
+
+bool array_shrink_to_fit(object_t *array)
+{
+    if (array == NULL || array->kind != ARRAY)
+    {
+        return false;
+    }
+
+    object_t **elements = buffer_shrink(array->data.v_array.elements,
+                                        array->data.v_array.size * sizeof(object_t *));
+    if (elements == NULL)
+    {
+        return false;
+    }
+    array->data.v_array.elements = elements;
+    return true;
+}
+
+size_t array_capacity(object_t *array)
+{
+    if (array == NULL || array->kind != ARRAY)
+    {
+        return 0;
+    }
+    return buffer_capacity(array->data.v_array.elements) / sizeof(object_t *);
+}
+
+object_t *array_get(object_t *array, size_t index)
+{
+    if (array == NULL || array->kind != ARRAY)
+    {
+        return NULL;
+    }
+
+    if (index >= array->data.v_array.size)
+    {
+        return NULL;
+    }
+    
+    return array->data.v_array.elements[index];
+}
+
+int length(object_t *obj)
+{
+    if (obj == NULL)
+    {
+        return -1;
+    }
+
+    switch (obj->kind)
+    {
+    case INTEGER:
+        return 1;
+    case FLOAT:
+        return 1;
+    case STRING:
+        return obj->data.v_string.length;
+    case VECTOR3:
+    case VECTOR3I:
+    case VECTOR3F:
+        return 3;
+    case ARRAY:
+        return obj->data.v_array.size;
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        return obj->data.v_packed.size;
+    case MAP:
+        return obj->data.v_map.count;
+    default:
+        return -1;
+    }
+}
+
+object_t *add(object_t *a, object_t *b)
+{
+    if (a == NULL || b == NULL)
+    {
+        return NULL;
+    }
+
+    object_t *ptr = NULL;
+
+    switch (a->kind)
+    {
+    case INTEGER:
+        if (b->kind == INTEGER)
+        {
+            ptr = new_integer(a->data.v_int + b->data.v_int);
+        }
+        else if (b->kind == FLOAT)
+        {
+            ptr = new_float(a->data.v_int + b->data.v_float);
+        }
+        break;
+
+    case FLOAT:
+        if (b->kind == INTEGER)
+        {
+            ptr = new_float(a->data.v_float + b->data.v_int);
+        }
+        else if (b->kind == FLOAT)
+        {
+            ptr = new_float(a->data.v_float + b->data.v_float);
+        }
+        break;
+
+    case STRING:
+        if (b->kind != STRING)
+        {
+            break;
+        }
+
+        size_t len_a = a->data.v_string.length;
+        size_t len_b = b->data.v_string.length;
+        // Appending an empty string derives a value sharing the other buffer
+        if (len_b == 0 || len_a == 0)
+        {
+            object_t *shared = len_b == 0 ? a : b;
+            ptr = _new_string_value(buffer_retain(shared->data.v_string.chars),
+                                    rope_retain(shared->data.v_string.rope),
+                                    shared->data.v_string.length);
+            break;
+        }
+
+        // Short results are cheaper to copy than to link
+        if (len_a + len_b <= ROPE_FLAT_MAX)
+        {
+            char *chars_a = string_chars(a);
+            char *chars_b = string_chars(b);
+            char *dst = chars_a && chars_b ? buffer_new(len_a + len_b + 1) : NULL;
+            if (dst == NULL)
+            {
+                break;
+            }
+            memcpy(dst, chars_a, len_a);
+            memcpy(dst + len_a, chars_b, len_b);
+
+            ptr = _new_string_value(dst, NULL, len_a + len_b);
+            break;
+        }
+
+        rope_t *left = _string_rope(a);
+        rope_t *right = _string_rope(b);
+        rope_t *rope = (left && right) ? rope_concat(left, right) : NULL;
+        rope_release(left);
+        rope_release(right);
+        if (rope == NULL)
+        {
+            break;
+        }
+
+        ptr = _new_string_value(NULL, rope, len_a + len_b);
+        break;
+    case VECTOR3:
+        if (b->kind != VECTOR3)
+        {
+            break;
+        }
+
+        object_t *new_x = add(a->data.v_vector3.x, b->data.v_vector3.x);
+        object_t *new_y = add(a->data.v_vector3.y, b->data.v_vector3.y);
+        object_t *new_z = add(a->data.v_vector3.z, b->data.v_vector3.z);
+        if (new_x == NULL || new_y == NULL || new_z == NULL)
+        { // If any  fails
+            if (new_x)
+                release_reference(&new_x);
+            if (new_y)
+                release_reference(&new_y);
+            if (new_z)
+                release_reference(&new_z);
+            break;
+        }
+
+        ptr = new_vector3(new_x, new_y, new_z);
+        // Release initial reference since objects within this scope are not needded
+        release_reference(&new_x);
+        release_reference(&new_y);
+        release_reference(&new_z);
+        break;
+
+    case ARRAY:
+        if (b->kind != ARRAY)
+        {
+            break;
+        }
+
+        // Appending an empty array derives a value sharing the other buffer
+        if (b->data.v_array.size == 0 || a->data.v_array.size == 0)
+        {
+            object_t *shared = b->data.v_array.size == 0 ? a : b;
+            ptr = _new_array_buffer(buffer_retain(shared->data.v_array.elements),
+                                    shared->data.v_array.size);
+            break;
+        }
+
+        size_t size = a->data.v_array.size + b->data.v_array.size;
+        ptr = new_array(size);
+        if (ptr == NULL)
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < a->data.v_array.size; i++)
+        {
+            object_t *obj = array_get(a, i);
+            array_set(ptr, i, obj);
+
+        }
+        for (size_t i = 0; i < b->data.v_array.size; i++)
+        {
+            object_t *obj = array_get(b, i);
+            array_set(ptr, (i + a->data.v_array.size), obj);
+        }
+        break;
+
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        if ((b->kind != INT_ARRAY && b->kind != FLOAT_ARRAY) ||
+            a->data.v_packed.size != b->data.v_packed.size)
+        {
+            break;
+        }
+
+        ptr = _new_packed_array((a->kind == INT_ARRAY && b->kind == INT_ARRAY) ? INT_ARRAY : FLOAT_ARRAY,
+                                a->data.v_packed.size);
+        if (ptr == NULL)
+        {
+            break;
+        }
+        _add_packed(ptr, a, b);
+        break;
+
+    case VECTOR3I:
+    case VECTOR3F:
+        if (b->kind != VECTOR3I && b->kind != VECTOR3F)
+        {
+            break;
+        }
+
+        // Components are inline: one allocation, one SIMD add
+        ptr = _new_object();
+        if (ptr == NULL)
+        {
+            break;
+        }
+        ptr->kind = (a->kind == VECTOR3I && b->kind == VECTOR3I) ? VECTOR3I : VECTOR3F;
+        _add_packed_vector3(ptr, a, b);
+        heap_profile_sample(ptr);
+        break;
+
+    default:
+        break;
+    }
+
+    return ptr;
+}
+
+/**
+ * @brief Check whether `add(a, b)` is defined and can reuse the storage of `a`.
+ * 
+ * @param a First object.
+ * @param b Second object.
+ * @return True if both objects are of compatible kinds.
+ */
+static bool _can_add_in_place(object_t *a, object_t *b)
+{
+    switch (a->kind)
+    {
+    case INTEGER:
+    case FLOAT:
+        return b->kind == INTEGER || b->kind == FLOAT;
+    case STRING:
+        return b->kind == STRING;
+    case VECTOR3:
+        return b->kind == VECTOR3 &&
+               _can_add_in_place(a->data.v_vector3.x, b->data.v_vector3.x) &&
+               _can_add_in_place(a->data.v_vector3.y, b->data.v_vector3.y) &&
+               _can_add_in_place(a->data.v_vector3.z, b->data.v_vector3.z);
+    case ARRAY:
+        return b->kind == ARRAY;
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        return (b->kind == INT_ARRAY || b->kind == FLOAT_ARRAY) &&
+               a->data.v_packed.size == b->data.v_packed.size;
+    case VECTOR3I:
+    case VECTOR3F:
+        return b->kind == VECTOR3I || b->kind == VECTOR3F;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Add the components of `b` into those of a uniquely owned vector.
+ * 
+ * @param acc Vector whose components are replaced by the sums.
+ * @param b Vector of compatible components.
+ * @return True if successful, false if allocation fails, leaving `acc` untouched.
+ * 
+ * @note Uniquely owned numbers are updated in place, which cannot fail. Every
+ *       other component sum is built first, and committed only once all succeed.
+ */
+static bool _vector3_add_consume(object_t *acc, object_t *b)
+{
+    object_t **dst[3] = {&acc->data.v_vector3.x, &acc->data.v_vector3.y, &acc->data.v_vector3.z};
+    object_t *src[3] = {b->data.v_vector3.x, b->data.v_vector3.y, b->data.v_vector3.z};
+    object_t *sums[3] = {NULL, NULL, NULL};
+
+    for (int i = 0; i < 3; i++)
+    {
+        object_t *component = *dst[i];
+        if (component->refcount == 1 && (component->kind == INTEGER || component->kind == FLOAT))
+            continue;
+
+        sums[i] = add(component, src[i]);
+        if (sums[i] == NULL)
         {
-            ptr = new_integer(a->data.v_int + b->data.v_int);
+            while (i-- > 0)
+            {
+                release_reference(&sums[i]);
+            }
+            return false;
         }
-        else if (b->kind == FLOAT)
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (sums[i] != NULL)
         {
-            ptr = new_float(a->data.v_int + b->data.v_float);
+            release_reference(dst[i]);
+            *dst[i] = sums[i];
+        }
+        else
+        {
+            add_consume(dst[i], src[i]);
+        }
+    }
+    return true;
+}
+
+object_t *add_consume(object_t **a, object_t *b)
+{
+    if (a == NULL || *a == NULL || b == NULL)
+    {
+        return NULL;
+    }
+
+    object_t *acc = *a;
+    if (acc->refcount != 1 || !_can_add_in_place(acc, b))
+    {
+        // Shared (or incompatible) accumulator, fall back to a fresh result
+        object_t *ptr = add(acc, b);
+        if (ptr == NULL)
+        {
+            return NULL;
+        }
+        release_reference(a);
+        *a = ptr;
+        return ptr;
+    }
+
+    switch (acc->kind)
+    {
+    case INTEGER:
+        if (b->kind == INTEGER)
+        {
+            acc->data.v_int += b->data.v_int;
+        }
+        else
+        {
+            acc->kind = FLOAT;
+            acc->data.v_float = acc->data.v_int + b->data.v_float;
         }
         break;
 
     case FLOAT:
         if (b->kind == INTEGER)
         {
-            ptr = new_float(a->data.v_float + b->data.v_int);
+            acc->data.v_float += b->data.v_int;
         }
-        else if (b->kind == FLOAT)
+        else
         {
-            ptr = new_float(a->data.v_float + b->data.v_float);
+            acc->data.v_float += b->data.v_float;
         }
         break;
 
     case STRING:
-        if (b->kind != STRING)
+    {
+        if (acc->data.v_string.rope != NULL || b->data.v_string.rope != NULL)
         {
+            // Ropes are extended by linking, without touching any bytes
+            rope_t *left = _string_rope(acc);
+            rope_t *right = _string_rope(b);
+            rope_t *rope = (left && right) ? rope_concat(left, right) : NULL;
+            rope_release(left);
+            rope_release(right);
+            if (rope == NULL)
+            {
+                return NULL;
+            }
+
+            buffer_release(acc->data.v_string.chars);
+            rope_release(acc->data.v_string.rope);
+            acc->data.v_string.chars = NULL;
+            acc->data.v_string.rope = rope;
+            acc->data.v_string.length = rope->length;
+            acc->data.v_string.hash = 0;
             break;
         }
 
-        int len = strlen(a->data.v_string) + strlen(b->data.v_string);
-        char *dst = calloc((len + 1), sizeof(char));
+        size_t len_a = acc->data.v_string.length;
+        size_t len_b = b->data.v_string.length;
+        size_t capacity = buffer_capacity(acc->data.v_string.chars);
+        if (len_a + len_b + 1 > capacity)
+        {
+            // Grow geometrically so accumulation loops amortise reallocation
+            capacity = (len_a + len_b + 1 > capacity * 2) ? len_a + len_b + 1 : capacity * 2;
+        }
+        char *dst = buffer_reserve(acc->data.v_string.chars, len_a + 1, capacity);
         if (dst == NULL)
         {
-            break;
+            return NULL;
         }
-        // Transfer strings to temp buffer
-        strcpy(dst, a->data.v_string);
-        strcat(dst, b->data.v_string);
-
-        ptr = new_string(dst);
-        free(dst);
-
+        // Self-add reads from the (possibly moved) buffer it is appending to
+        const char *src = (b == acc) ? dst : b->data.v_string.chars;
+        memcpy(dst + len_a, src, len_b);
+        dst[len_a + len_b] = '\0';
+        acc->data.v_string.chars = dst;
+        acc->data.v_string.length = len_a + len_b;
+        acc->data.v_string.hash = 0;
         break;
+    }
+
     case VECTOR3:
-        if (b->kind != VECTOR3)
+        if (!_vector3_add_consume(acc, b))
         {
-            break;
-        }
-
-        object_t *new_x = add(a->data.v_vector3.x, b->data.v_vector3.x);
-        object_t *new_y = add(a->data.v_vector3.y, b->data.v_vector3.y);
-        object_t *new_z = add(a->data.v_vector3.z, b->data.v_vector3.z);
-        if (new_x == NULL || new_y == NULL || new_z == NULL)
-        { // If any  fails
-            if (new_x)
-                release_reference(&new_x);
-            if (new_y)
-                release_reference(&new_y);
-            if (new_z)
-                release_reference(&new_z);
-            break;
+            return NULL;
         }
-
-        ptr = new_vector3(new_x, new_y, new_z);
-        // Release initial reference since objects within this scope are not needded
-        release_reference(&new_x);
-        release_reference(&new_y);
-        release_reference(&new_z);
         break;
 
     case ARRAY:
-        if (b->kind != ARRAY)
+    {
+        size_t size_a = acc->data.v_array.size;
+        size_t size_b = b->data.v_array.size;
+        if (!_array_grow(acc, size_a + size_b))
         {
-            break;
+            return NULL;
         }
-
-        size_t size = a->data.v_array.size + b->data.v_array.size;
-        ptr = new_array(size);
-        if (ptr == NULL)
+        object_t **elements = acc->data.v_array.elements;
+        object_t **src = (b == acc) ? elements : b->data.v_array.elements;
+        for (size_t i = 0; i < size_b; i++)
         {
-            break;
+            elements[size_a + i] = src[i];
+            add_reference(src[i]);
         }
+        acc->data.v_array.size = size_a + size_b;
+        break;
+    }
 
-        for (size_t i = 0; i < a->data.v_array.size; i++)
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        // int and float share a width, so an INT_ARRAY can be widened in place
+        _add_packed(acc, acc, b);
+        if (b->kind == FLOAT_ARRAY)
         {
-            object_t *obj = array_get(a, i);
-            array_set(ptr, i, obj);
-
+            acc->kind = FLOAT_ARRAY;
         }
-        for (size_t i = 0; i < b->data.v_array.size; i++)
+        break;
+
+    case VECTOR3I:
+    case VECTOR3F:
+        _add_packed_vector3(acc, acc, b);
+        if (b->kind == VECTOR3F)
         {
-            object_t *obj = array_get(b, i);
-            array_set(ptr, (i + a->data.v_array.size), obj);
+            acc->kind = VECTOR3F;
         }
         break;
 
+    default:
+        return NULL;
+    }
+
+    return acc;
+}
+
+/**
+ * @brief Largest number of objects in one block, bounded by `object_t.block_index`.
+ */
+#define BATCH_BLOCK_MAX ((size_t)UINT32_MAX)
+
+/**
+ * @struct ObjectBlock
+ * @brief Contiguous allocation backing the results of one `add_batch` group.
+ */
+typedef struct ObjectBlock {
+    size_t live;           /**< Objects of the block that have not been freed yet */
+    object_t objects[];    /**< The objects themselves */
+} object_block_t;
+
+/**
+ * @enum BatchClass
+ * @brief Kind pairs that `add_batch` runs a specialised loop for.
+ */
+typedef enum BatchClass {
+    BATCH_INT_INT,         /**< INTEGER + INTEGER */
+    BATCH_INT_FLOAT,       /**< INTEGER + FLOAT */
+    BATCH_FLOAT_INT,       /**< FLOAT + INTEGER */
+    BATCH_FLOAT_FLOAT,     /**< FLOAT + FLOAT */
+    BATCH_VEC3I_VEC3I,     /**< VECTOR3I + VECTOR3I */
+    BATCH_VEC3F,           /**< Unboxed vectors with at least one VECTOR3F */
+    BATCH_GENERIC,         /**< Everything else, handled by `add` */
+    BATCH_CLASS_COUNT
+} batch_class_t;
+
+/**
+ * @brief Classify a pair of operands for `add_batch`.
+ * 
+ * @param a First operand.
+ * @param b Second operand.
+ * @return The specialised loop handling the pair.
+ */
+static batch_class_t _batch_class(object_t *a, object_t *b)
+{
+    if (a == NULL || b == NULL)
+    {
+        return BATCH_GENERIC;
+    }
+
+    switch (a->kind)
+    {
+    case INTEGER:
+        if (b->kind == INTEGER)
+            return BATCH_INT_INT;
+        if (b->kind == FLOAT)
+            return BATCH_INT_FLOAT;
+        break;
+    case FLOAT:
+        if (b->kind == INTEGER)
+            return BATCH_FLOAT_INT;
+        if (b->kind == FLOAT)
+            return BATCH_FLOAT_FLOAT;
+        break;
+    case VECTOR3I:
+        if (b->kind == VECTOR3I)
+            return BATCH_VEC3I_VEC3I;
+        if (b->kind == VECTOR3F)
+            return BATCH_VEC3F;
+        break;
+    case VECTOR3F:
+        if (b->kind == VECTOR3I || b->kind == VECTOR3F)
+            return BATCH_VEC3F;
+        break;
+    default:
+        break;
+    }
+    return BATCH_GENERIC;
+}
+
+/**
+ * @brief Get the kind of the results of a batch class.
+ * 
+ * @param batch_class Specialised batch class (not BATCH_GENERIC).
+ * @return Kind of every result in the class.
+ */
+static object_kind_t _batch_result_kind(batch_class_t batch_class)
+{
+    switch (batch_class)
+    {
+    case BATCH_INT_INT:
+        return INTEGER;
+    case BATCH_VEC3I_VEC3I:
+        return VECTOR3I;
+    case BATCH_VEC3F:
+        return VECTOR3F;
+    default:
+        return FLOAT;
+    }
+}
+
+/**
+ * @brief Allocate a block of objects with a single reference each.
+ * 
+ * @param kind Kind of every object in the block.
+ * @param count Number of objects, at most BATCH_BLOCK_MAX.
+ * @return Pointer to the new block, or NULL if allocation fails.
+ */
+static object_block_t *_new_block(object_kind_t kind, size_t count)
+{
+    object_block_t *block = calloc(1, sizeof(object_block_t) + count * sizeof(object_t));
+    if (block == NULL)
+        return NULL;
+
+    block->live = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        object_t *obj = &block->objects[i];
+        obj->kind = kind;
+        obj->refcount = 1;
+        obj->flags = OBJECT_FLAG_BATCHED;
+        obj->block_index = (uint32_t)i;
+    }
+    return block;
+}
+
+/**
+ * @brief Release the memory of an object, returning batched objects to their block.
+ * 
+ * @param obj Object whose resources have already been released.
+ * 
+ * @note A block is freed together with the last of its objects.
+ */
+static void _free_object_memory(object_t *obj)
+{
+    if (obj->flags & OBJECT_FLAG_SAMPLED)
+    {
+        heap_profile_release(obj);
+    }
+
+    if ((obj->flags & OBJECT_FLAG_BATCHED) == 0)
+    {
+        free(obj);
+        return;
+    }
+
+    object_block_t *block = (object_block_t *)((char *)(obj - obj->block_index) -
+                                               offsetof(object_block_t, objects));
+    block->live--;
+    if (block->live == 0)
+    {
+        free(block);
+    }
+}
+
+/**
+ * @brief Run the specialised loop of a batch class.
+ * 
+ * @param batch_class Specialised batch class (not BATCH_GENERIC).
+ * @param dst Pre-initialised result objects, one per pair.
+ * @param idx Indices of the pairs in `a` and `b`.
+ * @param a Array of first operands.
+ * @param b Array of second operands.
+ * @param count Number of pairs.
+ */
+static void _batch_run(batch_class_t batch_class, object_t *dst, const size_t *idx,
+                       object_t **a, object_t **b, size_t count)
+{
+    switch (batch_class)
+    {
+    case BATCH_INT_INT:
+        for (size_t j = 0; j < count; j++)
+            dst[j].data.v_int = a[idx[j]]->data.v_int + b[idx[j]]->data.v_int;
+        break;
+    case BATCH_INT_FLOAT:
+        for (size_t j = 0; j < count; j++)
+            dst[j].data.v_float = a[idx[j]]->data.v_int + b[idx[j]]->data.v_float;
+        break;
+    case BATCH_FLOAT_INT:
+        for (size_t j = 0; j < count; j++)
+            dst[j].data.v_float = a[idx[j]]->data.v_float + b[idx[j]]->data.v_int;
+        break;
+    case BATCH_FLOAT_FLOAT:
+        for (size_t j = 0; j < count; j++)
+            dst[j].data.v_float = a[idx[j]]->data.v_float + b[idx[j]]->data.v_float;
+        break;
+    case BATCH_VEC3I_VEC3I:
+        for (size_t j = 0; j < count; j++)
+            simd_add_int4(dst[j].data.v_packed_vector3.i, a[idx[j]]->data.v_packed_vector3.i,
+                          b[idx[j]]->data.v_packed_vector3.i);
+        break;
+    case BATCH_VEC3F:
+        for (size_t j = 0; j < count; j++)
+            _add_packed_vector3(&dst[j], a[idx[j]], b[idx[j]]);
+        break;
     default:
         break;
     }
+}
 
-    return ptr;
+size_t add_batch(object_t **out, object_t **a, object_t **b, size_t n)
+{
+    if (out == NULL || a == NULL || b == NULL)
+    {
+        return 0;
+    }
+
+    size_t done = 0;
+    size_t *order = malloc(n * sizeof(size_t));
+    if (order == NULL)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = add(a[i], b[i]);
+            done += out[i] != NULL;
+        }
+        return done;
+    }
+
+    // Counting sort of the pair indices by batch class
+    size_t counts[BATCH_CLASS_COUNT] = {0};
+    size_t starts[BATCH_CLASS_COUNT];
+    for (size_t i = 0; i < n; i++)
+    {
+        counts[_batch_class(a[i], b[i])]++;
+    }
+    for (size_t c = 0, start = 0; c < BATCH_CLASS_COUNT; c++)
+    {
+        starts[c] = start;
+        start += counts[c];
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        order[starts[_batch_class(a[i], b[i])]++] = i;
+    }
+
+    size_t *idx = order;
+    for (size_t c = 0; c < BATCH_CLASS_COUNT; idx += counts[c], c++)
+    {
+        for (size_t base = 0; base < counts[c]; base += BATCH_BLOCK_MAX)
+        {
+            size_t count = counts[c] - base < BATCH_BLOCK_MAX ? counts[c] - base : BATCH_BLOCK_MAX;
+            object_block_t *block = NULL;
+            if (c != BATCH_GENERIC)
+            {
+                block = _new_block(_batch_result_kind(c), count);
+            }
+
+            if (block == NULL)
+            {
+                // Generic pairs, or out of memory for a block
+                for (size_t j = 0; j < count; j++)
+                {
+                    size_t i = idx[base + j];
+                    out[i] = add(a[i], b[i]);
+                    done += out[i] != NULL;
+                }
+                continue;
+            }
+
+            _batch_run(c, block->objects, idx + base, a, b, count);
+            for (size_t j = 0; j < count; j++)
+            {
+                out[idx[base + j]] = &block->objects[j];
+                heap_profile_sample(&block->objects[j]);
+            }
+            done += count;
+        }
+    }
+
+    free(order);
+    return done;
 }
 
 bool object_free(object_t **obj)
@@ -312,16 +1622,31 @@ bool object_free(object_t **obj)
     if ((*obj)->refcount > 1)
      return false;
 
+    if (((*obj)->flags & OBJECT_FLAG_FINALIZABLE) && _finalize_enqueue(*obj))
+    {
+        *obj = NULL;
+        return true;
+    }
+
+    if ((*obj)->flags & OBJECT_FLAG_WEAK_TARGET)
+    {
+        _weak_clear(*obj);
+    }
+
     switch ((*obj)->kind)
     {
     case INTEGER:
     case FLOAT:
+    case VECTOR3I:
+    case VECTOR3F:
         break;
 
     case STRING:
-        // Free the dynamically allocated string,
-        free((*obj)->data.v_string);
-        (*obj)->data.v_string = NULL;
+        // Drop this object's share of the string buffer
+        buffer_release((*obj)->data.v_string.chars);
+        rope_release((*obj)->data.v_string.rope);
+        (*obj)->data.v_string.chars = NULL;
+        (*obj)->data.v_string.rope = NULL;
         break;
 
     case VECTOR3:
@@ -332,7 +1657,8 @@ bool object_free(object_t **obj)
         break;
 
     case ARRAY:
-        if ((*obj)->data.v_array.elements != NULL)
+        // Element references belong to the buffer, only the last owner drops them
+        if ((*obj)->data.v_array.elements != NULL && !buffer_is_shared((*obj)->data.v_array.elements))
         {
             for (size_t i = 0; i < (*obj)->data.v_array.size; i++)
             {
@@ -341,17 +1667,51 @@ bool object_free(object_t **obj)
                     release_reference(&(*obj)->data.v_array.elements[i]); // Remove reference `object_t *`
                 }
             }
-            free((*obj)->data.v_array.elements);
-            (*obj)->data.v_array.elements = NULL;
         }
+        buffer_release((*obj)->data.v_array.elements);
+        (*obj)->data.v_array.elements = NULL;
+
+        break;
+
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        // Values are allocated inline with the object
+        break;
+
+    case MAP:
+        for (size_t i = 0; i < (*obj)->data.v_map.capacity; i++)
+        {
+            map_entry_t *entry = &(*obj)->data.v_map.entries[i];
+            if (entry->key == NULL)
+                continue;
+
+            // Ephemeron keys are not owned, only registered
+            if ((*obj)->data.v_map.weak_keys)
+            {
+                _weak_unregister(entry->key, *obj);
+            }
+            else
+            {
+                release_reference(&entry->key);
+            }
+            release_reference(&entry->value);
+        }
+        hashmap_free(&(*obj)->data.v_map);
+        break;
 
+    case WEAK:
+        if ((*obj)->data.v_weak != NULL)
+        {
+            _weak_unregister((*obj)->data.v_weak, *obj);
+            (*obj)->data.v_weak = NULL;
+        }
         break;
 
     default:
         break;
     }
 
-    free(*obj);
+    _free_object_memory(*obj);
     *obj = NULL;
 
     return true;
@@ -28,6 +28,15 @@ object_t *new_float(float value);
  */
 object_t *new_string(char *value);
 
+/**
+ * @brief Create a new string object from raw bytes.
+ * 
+ * @param bytes Bytes to initialize the object with, may contain NULs.
+ * @param length Number of bytes.
+ * @return Pointer to the new string object.
+ */
+object_t *new_string_len(const char *bytes, size_t length);
+
 /**
  * @brief Create a new 3D vector object.
  * 
@@ -38,6 +47,26 @@ object_t *new_string(char *value);
  */
 object_t *new_vector3(object_t *x, object_t *y, object_t *z);
 
+/**
+ * @brief Create a new unboxed 3D vector of integers.
+ * 
+ * @param x X coordinate of the vector.
+ * @param y Y coordinate of the vector.
+ * @param z Z coordinate of the vector.
+ * @return Pointer to the new VECTOR3I object.
+ */
+object_t *new_vector3i(int x, int y, int z);
+
+/**
+ * @brief Create a new unboxed 3D vector of floats.
+ * 
+ * @param x X coordinate of the vector.
+ * @param y Y coordinate of the vector.
+ * @param z Z coordinate of the vector.
+ * @return Pointer to the new VECTOR3F object.
+ */
+object_t *new_vector3f(float x, float y, float z);
+
 /**
  * @brief Create a new array object.
  * 
@@ -46,6 +75,106 @@ object_t *new_vector3(object_t *x, object_t *y, object_t *z);
  */
 object_t *new_array(size_t size);
 
+/**
+ * @brief Create a new packed array of `int` values.
+ * 
+ * @param size Number of values, initialised to 0.
+ * @return Pointer to the new INT_ARRAY object.
+ */
+object_t *new_int_array(size_t size);
+
+/**
+ * @brief Create a new packed array of `float` values.
+ * 
+ * @param size Number of values, initialised to 0.
+ * @return Pointer to the new FLOAT_ARRAY object.
+ */
+object_t *new_float_array(size_t size);
+
+/**
+ * @brief Create a new, empty map object.
+ * 
+ * @return Pointer to the new MAP object.
+ */
+object_t *new_map(void);
+
+/**
+ * @brief Create a new, empty ephemeron map whose keys are held weakly.
+ * 
+ * @return Pointer to the new MAP object.
+ * 
+ * @note An entry is removed as soon as its key is freed, and its value released,
+ *       so memoization caches keyed by objects do not keep those objects alive.
+ */
+object_t *new_ephemeron_map(void);
+
+/**
+ * @brief Associate a value with a key in a map object.
+ * 
+ * @param map Map object.
+ * @param key Key, any object; numbers and strings are compared by value.
+ * @param value Value to associate with the key.
+ * @return True if successful, false otherwise.
+ * 
+ * @note References are added to the key and value, and released for a replaced pair;
+ *       ephemeron maps reference only the value.
+ *       Keys must not be mutated (e.g. with `add_consume`) while in a map.
+ */
+bool map_set(object_t *map, object_t *key, object_t *value);
+
+/**
+ * @brief Get the value associated with a key in a map object.
+ * 
+ * @param map Map object.
+ * @param key Key to look up.
+ * @return Pointer to the value, or NULL if the key is absent.
+ * 
+ * @note If the intention is to keep the borrowed reference, remember to call 
+ * `add_reference` and release the reference by `release_reference`afterwards.
+ */
+object_t *map_get(object_t *map, object_t *key);
+
+/**
+ * @brief Remove a key from a map object.
+ * 
+ * @param map Map object.
+ * @param key Key to remove.
+ * @return True if the key was present, false otherwise.
+ */
+bool map_remove(object_t *map, object_t *key);
+
+/**
+ * @brief Create a new weak reference.
+ * 
+ * @param target Object to refer to, no reference is added.
+ * @return Pointer to the new WEAK object.
+ * 
+ * @note The reference is cleared when `release_reference` frees the target.
+ */
+object_t *new_weak(object_t *target);
+
+/**
+ * @brief Get the target of a weak reference.
+ * 
+ * @param weak WEAK object.
+ * @return Pointer to the target, or NULL if it has been freed.
+ * 
+ * @note If the intention is to keep the borrowed reference, remember to call 
+ * `add_reference` and release the reference by `release_reference`afterwards.
+ */
+object_t *weak_get(object_t *weak);
+
+/**
+ * @brief Create a copy of an object.
+ * 
+ * @param obj Object to copy.
+ * @return Pointer to the new object, or NULL if allocation fails.
+ * 
+ * @note String and array copies share the source's buffer (copy-on-write) until
+ *       either of them is mutated; vector copies share their components.
+ */
+object_t *object_copy(object_t *obj);
+
 /**
  * @brief Set an element in an array object.
  * 
@@ -53,9 +182,58 @@ object_t *new_array(size_t size);
  * @param index Index at which to set the value.
  * @param value Value to set at the specified index.
  * @return True if successful, false otherwise.
+ * 
+ * @note A shared elements buffer is copied before being modified.
  */
 bool array_set(object_t *obj, size_t index, object_t *value);
 
+/**
+ * @brief Append an element to an array object, growing it when needed.
+ * 
+ * @param array Array object.
+ * @param value Value to append, a reference is added.
+ * @return True if successful, false otherwise.
+ * 
+ * @note Capacity grows geometrically, so repeated pushes are amortised O(1).
+ */
+bool array_push(object_t *array, object_t *value);
+
+/**
+ * @brief Remove the last element of an array object.
+ * 
+ * @param array Array object.
+ * @return The removed element, or NULL if the array is empty.
+ * 
+ * @note The array's reference is transferred to the caller, who must call
+ * `release_reference` when done with it.
+ */
+object_t *array_pop(object_t *array);
+
+/**
+ * @brief Make room for at least `capacity` elements without changing the size.
+ * 
+ * @param array Array object.
+ * @param capacity Number of elements to make room for.
+ * @return True if successful, false otherwise.
+ */
+bool array_reserve(object_t *array, size_t capacity);
+
+/**
+ * @brief Release the unused capacity of an array object.
+ * 
+ * @param array Array object.
+ * @return True if successful, false otherwise.
+ */
+bool array_shrink_to_fit(object_t *array);
+
+/**
+ * @brief Get the number of elements an array can hold before it must grow.
+ * 
+ * @param array Array object.
+ * @return Capacity of the array, or 0 if `array` is not an array.
+ */
+size_t array_capacity(object_t *array);
+
 /**
  * @brief Get an element from an array object.
  * 
@@ -82,9 +260,64 @@ int length(object_t *obj);
  * @param a First object.
  * @param b Second object.
  * @return Pointer to the result of the addition.
+ * 
+ * @note Packed arrays of the same size are added element-wise.
  */
 object_t *add(object_t *a, object_t *b);
 
+/**
+ * @brief Add many pairs of objects at once, `out[i] = add(a[i], b[i])`.
+ * 
+ * @param out Array receiving the `n` results (NULL where the addition fails).
+ * @param a Array of first operands.
+ * @param b Array of second operands.
+ * @param n Number of pairs.
+ * @return Number of successful additions.
+ * 
+ * @note Pairs are grouped by kind so each group runs a specialised loop, and
+ *       the number/vector results of a group share one contiguous allocation.
+ *       Results are released individually, like those of `add`.
+ */
+size_t add_batch(object_t **out, object_t **a, object_t **b, size_t n);
+
+/**
+ * @brief Add `b` into `*a`, consuming the caller's reference to `*a`.
+ * 
+ * @param a Pointer to the accumulator object, updated to point at the result.
+ * @param b Second object.
+ * @return Pointer to the result of the addition (same as `*a`), or NULL on failure.
+ * 
+ * @note When `*a` is uniquely owned (`refcount == 1`) its storage is reused:
+ *       numbers are overwritten and strings/arrays are grown in place. Otherwise
+ *       this behaves like `add` followed by `release_reference(a)`. On failure
+ *       `*a` is left untouched.
+ */
+object_t *add_consume(object_t **a, object_t *b);
+
+/**
+ * @brief Register a finalizer to run after an object's last reference is released.
+ * 
+ * @param obj Object owning external resources.
+ * @param fn Finalizer, or NULL to remove a registered one.
+ * @param context Argument passed to `fn`.
+ * @return True if successful, false if allocation fails.
+ * 
+ * @note Instead of being freed, the dead object is queued and kept alive until
+ *       `run_finalizers` runs `fn`, so releasing it stays cheap. A finalizer runs once.
+ */
+bool object_set_finalizer(object_t *obj, finalizer_t fn, void *context);
+
+/**
+ * @brief Run the finalizers of every queued object, then release those objects.
+ * 
+ * @return Number of finalizers run.
+ * 
+ * @note Only the objects queued before the call are finalized: objects freed
+ *       while finalizing, or whose finalizer registers itself again, are queued
+ *       for the next call. A finalizer may keep its object alive with `add_reference`.
+ */
+size_t run_finalizers(void);
+
 /**
  * @brief Increase the reference count of an object.
  * 
@@ -108,5 +341,8 @@ void release_reference(object_t **obj);
  * 
  * @param obj Pointer to the object to free.
  * @return True if the object was freed, false otherwise.
+ * 
+ * @note A finalizable object is queued for `run_finalizers` instead, which also
+ *       counts as freed for the caller.
  */
 bool object_free(object_t **obj);
@@ -0,0 +1,152 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "ptrmap.h"
+
+/**
+ * @brief Number of slots allocated on the first insert.
+ */
+#define PTRMAP_MIN_CAPACITY 16
+
+/**
+ * @brief Hash a pointer.
+ * 
+ * @param key Pointer to hash.
+ * @return Mixed bits of the address (splitmix64 finaliser).
+ */
+static size_t _hash(const void *key)
+{
+    uint64_t x = (uint64_t)(uintptr_t)key;
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (size_t)x;
+}
+
+/**
+ * @brief Find the slot holding a pointer, or the empty slot where it would go.
+ * 
+ * @param map Map with at least one slot.
+ * @param key Pointer to look up.
+ * @return Index of the slot.
+ */
+static size_t _probe(ptrmap_t *map, const void *key)
+{
+    size_t mask = map->capacity - 1;
+    size_t slot = _hash(key) & mask;
+    while (map->entries[slot].key != NULL && map->entries[slot].key != key)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * @brief Rehash every entry into a table of a new size.
+ * 
+ * @param map Map to resize.
+ * @param capacity New number of slots, a power of two larger than `count`.
+ * @return True if successful, false if allocation fails.
+ */
+static bool _resize(ptrmap_t *map, size_t capacity)
+{
+    ptrmap_t resized = {0, capacity, calloc(capacity, sizeof(ptrmap_entry_t))};
+    if (resized.entries == NULL)
+        return false;
+
+    for (size_t i = 0; i < map->capacity; i++)
+    {
+        if (map->entries[i].key != NULL)
+        {
+            resized.entries[_probe(&resized, map->entries[i].key)] = map->entries[i];
+        }
+    }
+    resized.count = map->count;
+
+    free(map->entries);
+    *map = resized;
+    return true;
+}
+
+void *ptrmap_get(ptrmap_t *map, const void *key)
+{
+    if (map == NULL || key == NULL || map->count == 0)
+        return NULL;
+
+    return map->entries[_probe(map, key)].value;
+}
+
+bool ptrmap_contains(ptrmap_t *map, const void *key)
+{
+    if (map == NULL || key == NULL || map->count == 0)
+        return false;
+
+    return map->entries[_probe(map, key)].key != NULL;
+}
+
+bool ptrmap_put(ptrmap_t *map, const void *key, void *value)
+{
+    if (map == NULL || key == NULL)
+        return false;
+
+    // Keep the load factor at or below 1/2, lookups of absent keys are common
+    if ((map->count + 1) * 2 > map->capacity)
+    {
+        size_t capacity = map->capacity ? map->capacity * 2 : PTRMAP_MIN_CAPACITY;
+        if (!_resize(map, capacity))
+            return false;
+    }
+
+    ptrmap_entry_t *entry = &map->entries[_probe(map, key)];
+    if (entry->key == NULL)
+    {
+        map->count++;
+        entry->key = (void *)key;
+    }
+    entry->value = value;
+    return true;
+}
+
+void *ptrmap_remove(ptrmap_t *map, const void *key)
+{
+    if (map == NULL || key == NULL || map->count == 0)
+        return NULL;
+
+    size_t mask = map->capacity - 1;
+    size_t slot = _probe(map, key);
+    if (map->entries[slot].key == NULL)
+        return NULL;
+
+    void *value = map->entries[slot].value;
+    map->entries[slot].key = NULL;
+    map->entries[slot].value = NULL;
+    map->count--;
+
+    // Backward-shift deletion keeps probe runs contiguous without tombstones
+    size_t hole = slot;
+    for (size_t i = (slot + 1) & mask; map->entries[i].key != NULL; i = (i + 1) & mask)
+    {
+        size_t home = _hash(map->entries[i].key) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            map->entries[hole] = map->entries[i];
+            map->entries[i].key = NULL;
+            map->entries[i].value = NULL;
+            hole = i;
+        }
+    }
+    return value;
+}
+
+void ptrmap_free(ptrmap_t *map)
+{
+    if (map == NULL)
+        return;
+
+    free(map->entries);
+    map->entries = NULL;
+    map->count = 0;
+    map->capacity = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @struct PtrMapEntry
+ * @brief One slot of a pointer map.
+ */
+typedef struct PtrMapEntry
+{
+    void *key;     /**< Key pointer, NULL for an empty slot */
+    void *value;   /**< Value associated with the key */
+} ptrmap_entry_t;
+
+/**
+ * @struct PtrMap
+ * @brief Open-addressing hash map keyed by pointer identity.
+ * 
+ * A zero-initialised `ptrmap_t` is an empty map.
+ */
+typedef struct PtrMap
+{
+    size_t count;             /**< Number of entries in use */
+    size_t capacity;          /**< Number of slots, 0 or a power of two */
+    ptrmap_entry_t *entries;  /**< Slots of the table */
+} ptrmap_t;
+
+/**
+ * @brief Get the value associated with a pointer.
+ * 
+ * @param map Map to search.
+ * @param key Pointer to look up.
+ * @return The value, or NULL if the pointer is absent.
+ */
+void *ptrmap_get(ptrmap_t *map, const void *key);
+
+/**
+ * @brief Check whether a pointer is in a map.
+ * 
+ * @param map Map to search.
+ * @param key Pointer to look up.
+ * @return True if the pointer is present.
+ */
+bool ptrmap_contains(ptrmap_t *map, const void *key);
+
+/**
+ * @brief Associate a value with a pointer, replacing any previous value.
+ * 
+ * @param map Map to update.
+ * @param key Non-NULL pointer.
+ * @param value Value to associate with the pointer.
+ * @return True if successful, false if allocation fails.
+ */
+bool ptrmap_put(ptrmap_t *map, const void *key, void *value);
+
+/**
+ * @brief Remove a pointer from a map.
+ * 
+ * @param map Map to update.
+ * @param key Pointer to remove.
+ * @return The value that was associated with the pointer, or NULL if absent.
+ */
+void *ptrmap_remove(ptrmap_t *map, const void *key);
+
+/**
+ * @brief Free the slots of a map, leaving it empty.
+ * 
+ * @param map Map to clear.
+ */
+void ptrmap_free(ptrmap_t *map);
@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "recorder.h"
+#include "ptrmap.h"
+
+static FILE *_out = NULL;
+static ptrmap_t _ids = {0};
+static uintptr_t _next_id = 1;
+static size_t _frames = 0;
+static ptrmap_t _handles = {0};
+static size_t _handle_base = SIZE_MAX;
+static size_t _handle_top = 0;
+
+/**
+ * @brief Write an unsigned LEB128 integer.
+ * 
+ * @param value Value to write.
+ */
+static void _write_varint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        putc((int)(value & 0x7f) | 0x80, _out);
+        value >>= 7;
+    }
+    putc((int)value, _out);
+}
+
+/**
+ * @brief Write a signed integer as a zigzag encoded varint.
+ * 
+ * @param value Value to write.
+ */
+static void _write_signed(int64_t value)
+{
+    _write_varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/**
+ * @brief Write the 4 little endian bytes of a float.
+ * 
+ * @param value Value to write.
+ */
+static void _write_float(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 4; i++)
+    {
+        putc((int)(bits >> (8 * i)) & 0xff, _out);
+    }
+}
+
+/**
+ * @brief Write the trace id of an object.
+ * 
+ * @param obj Object, or NULL.
+ */
+static void _write_id(object_t *obj)
+{
+    _write_varint(obj != NULL ? (uintptr_t)ptrmap_get(&_ids, obj) : 0);
+}
+
+/**
+ * @brief Tell whether an object was created while recording.
+ * 
+ * @param obj Object, or NULL.
+ * @return True if the object has a trace id.
+ */
+static bool _known(object_t *obj)
+{
+    return obj != NULL && ptrmap_get(&_ids, obj) != NULL;
+}
+
+/**
+ * @brief Record an object as referenced from outside the trace.
+ * 
+ * @param obj Object, ignored unless it has a trace id.
+ */
+static void _write_root(object_t *obj)
+{
+    if (!_known(obj))
+        return;
+
+    putc(REC_ROOT, _out);
+    _write_id(obj);
+}
+
+/**
+ * @brief Read the position of the next free handle slot.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @return Number of handle slots below it, counted from the first block.
+ */
+static size_t _handle_position(vm_t *vm)
+{
+    return vm->handles.block * HANDLE_BLOCK_SLOTS + vm->handles.used;
+}
+
+bool recorder_start(const char *path)
+{
+    if (_out != NULL || path == NULL)
+        return false;
+
+    _out = fopen(path, "wb");
+    if (_out == NULL)
+        return false;
+
+    _next_id = 1;
+    _frames = 0;
+    _handle_base = SIZE_MAX;
+    _handle_top = 0;
+    fwrite(RECORDER_MAGIC, 1, 4, _out);
+    for (int i = 0; i < 4; i++)
+    {
+        putc((RECORDER_VERSION >> (8 * i)) & 0xff, _out);
+    }
+    return true;
+}
+
+bool recorder_stop(void)
+{
+    if (_out == NULL)
+        return false;
+
+    bool ok = !ferror(_out);
+    ok = fclose(_out) == 0 && ok;
+    _out = NULL;
+    ptrmap_free(&_ids);
+    ptrmap_free(&_handles);
+    return ok;
+}
+
+void recorder_new(object_t *obj)
+{
+    if (_out == NULL)
+        return;
+
+    // A swept object's address may come back, the new object takes it over
+    ptrmap_put(&_ids, obj, (void *)_next_id++);
+    putc(REC_NEW, _out);
+    putc(obj->kind, _out);
+    switch (obj->kind)
+    {
+    case INTEGER:
+        _write_signed(obj->data.v_int);
+        break;
+    case FLOAT:
+        _write_float(obj->data.v_float);
+        break;
+    case STRING:
+        _write_varint(obj->data.v_string.length);
+        fwrite(string_chars(obj), 1, obj->data.v_string.length, _out);
+        break;
+    case VECTOR3:
+        _write_id(obj->data.v_vector3.x);
+        _write_id(obj->data.v_vector3.y);
+        _write_id(obj->data.v_vector3.z);
+        break;
+    case VECTOR3I:
+        for (int i = 0; i < 3; i++)
+            _write_signed(obj->data.v_packed_vector3.i[i]);
+        break;
+    case VECTOR3F:
+        for (int i = 0; i < 3; i++)
+            _write_float(obj->data.v_packed_vector3.f[i]);
+        break;
+    case ARRAY:
+        _write_varint(obj->data.v_array.size);
+        break;
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        _write_varint(obj->data.v_packed.size);
+        break;
+    case MAP:
+        putc(obj->data.v_map.weak_keys ? 1 : 0, _out);
+        break;
+    case WEAK:
+        _write_id(obj->data.v_weak);
+        break;
+    default:
+        break;
+    }
+}
+
+void recorder_array_set(object_t *array, size_t index, object_t *value)
+{
+    if (_out == NULL)
+        return;
+
+    if (!_known(array))
+    {
+        _write_root(value);
+        return;
+    }
+
+    putc(REC_ARRAY_SET, _out);
+    _write_id(array);
+    _write_varint(index);
+    _write_id(value);
+}
+
+void recorder_array_push(object_t *array, object_t *value)
+{
+    if (_out == NULL)
+        return;
+
+    if (!_known(array))
+    {
+        _write_root(value);
+        return;
+    }
+
+    putc(REC_ARRAY_PUSH, _out);
+    _write_id(array);
+    _write_id(value);
+}
+
+void recorder_map_set(object_t *map, object_t *key, object_t *value)
+{
+    if (_out == NULL)
+        return;
+
+    if (!_known(map))
+    {
+        _write_root(key);
+        _write_root(value);
+        return;
+    }
+
+    putc(REC_MAP_SET, _out);
+    _write_id(map);
+    _write_id(key);
+    _write_id(value);
+}
+
+void recorder_array_pop(object_t *array)
+{
+    if (_out == NULL || !_known(array))
+        return;
+
+    putc(REC_ARRAY_POP, _out);
+    _write_id(array);
+}
+
+void recorder_map_remove(object_t *map, object_t *key)
+{
+    if (_out == NULL || !_known(map))
+        return;
+
+    putc(REC_MAP_REMOVE, _out);
+    _write_id(map);
+    _write_id(key);
+}
+
+void recorder_frame(recorder_op_t op)
+{
+    if (_out == NULL)
+        return;
+
+    // Frames pushed before recording started are not in the trace
+    if (op == REC_FRAME_PUSH)
+    {
+        _frames++;
+    }
+    else if (_frames > 0)
+    {
+        _frames--;
+    }
+    else
+    {
+        return;
+    }
+    putc(op, _out);
+}
+
+void recorder_frame_reference(frame_t *frame, object_t *obj)
+{
+    if (_out == NULL)
+        return;
+
+    // Roots are nearly always added to the innermost frame
+    stack_t *frames = frame->vm->frames;
+    size_t depth = frames->count;
+    while (depth > 0 && frames->data[depth - 1] != frame)
+    {
+        depth--;
+    }
+    if (depth == 0)
+        return;
+
+    size_t older = frames->count - _frames;
+    if (depth <= older)
+    {
+        _write_root(obj);
+        return;
+    }
+
+    putc(REC_FRAME_REFERENCE, _out);
+    _write_varint(depth - 1 - older);
+    _write_id(obj);
+}
+
+void recorder_handle(vm_t *vm, object_t **handle)
+{
+    if (_out == NULL)
+        return;
+
+    size_t position = _handle_position(vm) - 1;
+    if (position < _handle_base)
+    {
+        _handle_base = position;
+    }
+    // Blocks are kept once allocated, so a slot always has the same position
+    ptrmap_put(&_handles, handle, (void *)(position + 1));
+    _handle_top = position - _handle_base + 1;
+
+    putc(REC_HANDLE, _out);
+    _write_id(*handle);
+}
+
+void recorder_handle_clear(object_t **handle)
+{
+    if (_out == NULL)
+        return;
+
+    // Handles created before recording started, or since released, are not in the trace
+    size_t position = (uintptr_t)ptrmap_get(&_handles, handle);
+    if (position == 0 || position - 1 < _handle_base || position - 1 - _handle_base >= _handle_top)
+        return;
+
+    putc(REC_HANDLE_CLEAR, _out);
+    _write_varint(position - 1 - _handle_base);
+}
+
+void recorder_handle_scope(vm_t *vm)
+{
+    // Nothing to release before the first handle is recorded
+    if (_out == NULL || _handle_base == SIZE_MAX)
+        return;
+
+    size_t position = _handle_position(vm);
+    if (position < _handle_base)
+    {
+        _handle_base = position;
+    }
+    if (position - _handle_base == _handle_top)
+        return;
+    _handle_top = position - _handle_base;
+
+    putc(REC_HANDLE_SCOPE_CLOSE, _out);
+    _write_varint(_handle_top);
+}
+
+void recorder_collect(void)
+{
+    if (_out == NULL)
+        return;
+
+    putc(REC_COLLECT, _out);
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "vm.h"
+
+/**
+ * @brief Allocation and mutation trace format.
+ * 
+ * A trace is the 4 bytes of `RECORDER_MAGIC`, a little endian `u32`
+ * `RECORDER_VERSION`, then one record per event: an `u8` `recorder_op_t`
+ * followed by its operands. Integers are unsigned LEB128 varints, signed ones
+ * zigzag encoded first, and floats are their 4 little endian bytes.
+ * 
+ * Objects are not named in the trace: the n-th `REC_NEW` record creates
+ * object n, counted from 1, and later records refer to objects by that id.
+ * Id 0 stands for NULL, or for an object created before recording started.
+ * 
+ * Frames and handles are numbered from the bottom of their stack, counting
+ * only those created since recording started. An object stored into an object
+ * created before recording started, or referenced by a frame pushed before it,
+ * is recorded as `REC_ROOT`, since the trace cannot tell when it is released.
+ * 
+ * - `REC_NEW`: `u8` kind, then by kind: INTEGER a signed value; FLOAT a float;
+ *   STRING the length and bytes; VECTOR3 three ids; VECTOR3I three signed
+ *   values; VECTOR3F three floats; ARRAY, INT_ARRAY and FLOAT_ARRAY the size;
+ *   MAP an `u8` that is 1 for an ephemeron map; WEAK the target id.
+ * - `REC_ARRAY_SET`: array id, index, value id.
+ * - `REC_ARRAY_PUSH`: array id, value id.
+ * - `REC_MAP_SET`: map id, key id, value id.
+ * - `REC_FRAME_PUSH`, `REC_FRAME_POP`: no operands.
+ * - `REC_FRAME_REFERENCE`: position of the frame from the bottom of the frame stack, object id.
+ * - `REC_COLLECT`: no operands.
+ * - `REC_ARRAY_POP`: array id.
+ * - `REC_MAP_REMOVE`: map id, key id.
+ * - `REC_HANDLE`: object id, rooted by a new handle on top of the handle stack.
+ * - `REC_HANDLE_CLEAR`: position of the handle from the bottom of the handle stack.
+ * - `REC_HANDLE_SCOPE_CLOSE`: new size of the handle stack. Opening a scope
+ *   changes nothing, so only closes are recorded, `frame_free` included.
+ * - `REC_ROOT`: object id, kept alive until the end of the trace.
+ */
+#define RECORDER_MAGIC "GCTR"
+#define RECORDER_VERSION 2
+
+/**
+ * @enum RecorderOp
+ * Event starting each record of a trace.
+ */
+typedef enum RecorderOp {
+    REC_NEW,               /**< Object constructed */
+    REC_ARRAY_SET,         /**< `array_set_ms` */
+    REC_ARRAY_PUSH,        /**< `array_push_ms` */
+    REC_MAP_SET,           /**< `map_set_ms` */
+    REC_FRAME_PUSH,        /**< Frame pushed by `vm_new_frame` */
+    REC_FRAME_POP,         /**< Frame popped by `vm_frame_pop` */
+    REC_FRAME_REFERENCE,   /**< `frame_reference_object` */
+    REC_COLLECT,           /**< `vm_collect_garbage` */
+    REC_ARRAY_POP,         /**< `array_pop_ms` */
+    REC_MAP_REMOVE,        /**< `map_remove_ms` */
+    REC_HANDLE,            /**< `vm_handle` */
+    REC_HANDLE_CLEAR,      /**< `handle_clear` */
+    REC_HANDLE_SCOPE_CLOSE, /**< `vm_handle_scope_close` or `frame_free` */
+    REC_ROOT               /**< Object referenced from outside the trace */
+} recorder_op_t;
+
+/**
+ * @brief Start recording the mark-and-sweep API calls to a trace file.
+ * 
+ * @param path Path of the file to create.
+ * @return True if successful, false if already recording or the file cannot be created.
+ * 
+ * @note Only calls that succeed are recorded. Record one VM at a time; the
+ *       recorder is not thread safe.
+ */
+bool recorder_start(const char *path);
+
+/**
+ * @brief Stop recording and close the trace file.
+ * 
+ * @return True if every record was written, false if writing failed or not recording.
+ */
+bool recorder_stop(void);
+
+/**
+ * @brief Record the construction of an object.
+ * 
+ * @param obj Fully initialised object.
+ * 
+ * @note Like the other `recorder_*` hooks, called by the mark-and-sweep API
+ *       and does nothing unless recording.
+ */
+void recorder_new(object_t *obj);
+
+/**
+ * @brief Record an element store into an array.
+ * 
+ * @param array Array object.
+ * @param index Index of the element.
+ * @param value Stored object.
+ */
+void recorder_array_set(object_t *array, size_t index, object_t *value);
+
+/**
+ * @brief Record an element appended to an array.
+ * 
+ * @param array Array object.
+ * @param value Appended object.
+ */
+void recorder_array_push(object_t *array, object_t *value);
+
+/**
+ * @brief Record an entry stored into a map.
+ * 
+ * @param map Map object.
+ * @param key Key object.
+ * @param value Value object.
+ */
+void recorder_map_set(object_t *map, object_t *key, object_t *value);
+
+/**
+ * @brief Record the last element popped from an array.
+ * 
+ * @param array Array object.
+ */
+void recorder_array_pop(object_t *array);
+
+/**
+ * @brief Record an entry removed from a map.
+ * 
+ * @param map Map object.
+ * @param key Key object passed to the removal.
+ */
+void recorder_map_remove(object_t *map, object_t *key);
+
+/**
+ * @brief Record a frame push or pop.
+ * 
+ * @param op REC_FRAME_PUSH or REC_FRAME_POP.
+ */
+void recorder_frame(recorder_op_t op);
+
+/**
+ * @brief Record an object referenced by a frame.
+ * 
+ * @param frame Frame on the stack of its VM.
+ * @param obj Referenced object.
+ */
+void recorder_frame_reference(frame_t *frame, object_t *obj);
+
+/**
+ * @brief Record an object rooted by a new handle.
+ * 
+ * @param vm Pointer to the virtual machine owning the handle.
+ * @param handle Handle just returned by `vm_handle`.
+ */
+void recorder_handle(vm_t *vm, object_t **handle);
+
+/**
+ * @brief Record a handle being cleared.
+ * 
+ * @param handle Handle returned by `vm_handle` while recording.
+ */
+void recorder_handle_clear(object_t **handle);
+
+/**
+ * @brief Record the handle position restored by a scope close or `frame_free`.
+ * 
+ * @param vm Pointer to the virtual machine whose handle position was restored.
+ */
+void recorder_handle_scope(vm_t *vm);
+
+/**
+ * @brief Record a garbage collection.
+ */
+void recorder_collect(void);
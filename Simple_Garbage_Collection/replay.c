@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// <sys/wait.h> pulls in the signal stack_t, which clashes with stack.h
+#define stack_t signal_stack_t
+#include <sys/wait.h>
+#undef stack_t
+
+#include "recorder.h"
+#include "replayer.h"
+
+/**
+ * @file replay.c
+ * @brief Replays a trace written by the recorder against each memory model.
+ * 
+ * Every model runs in its own process, on the same in-memory trace, so the
+ * throughput, pause and peak RSS figures are directly comparable.
+ * 
+ * Usage: `replay <trace> [mode...]`, with modes from `replayer_backend_name` (all by default).
+ */
+
+/**
+ * @brief Allocate memory or exit.
+ * 
+ * @param ptr Allocation to resize, or NULL.
+ * @param size Number of bytes.
+ * @return The allocation.
+ */
+static void *_xrealloc(void *ptr, size_t size)
+{
+    ptr = realloc(ptr, size ? size : 1);
+    if (ptr == NULL)
+    {
+        fprintf(stderr, "replay: out of memory (%zu bytes)\n", size);
+        exit(1);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Order pauses, for `qsort`.
+ */
+static int _compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Replay a trace against one memory model and print one line of JSON.
+ * 
+ * @param backend Index of the memory model.
+ * @param trace Trace, header included.
+ * @param size Size of the trace in bytes.
+ * @return True if the whole trace was replayed.
+ */
+static bool _run(size_t backend, const uint8_t *trace, size_t size)
+{
+    replay_result_t result;
+    bool ok = replayer_run(backend, trace, size, &result);
+
+    uint64_t pause_total = 0;
+    for (size_t i = 0; i < result.pauses; i++)
+    {
+        pause_total += result.pause_ns[i];
+    }
+    qsort(result.pause_ns, result.pauses, sizeof(uint64_t), _compare_u64);
+    uint64_t p99 = result.pauses ? result.pause_ns[(result.pauses - 1) * 99 / 100] : 0;
+    uint64_t max = result.pauses ? result.pause_ns[result.pauses - 1] : 0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("{\"mode\":\"%s\",\"complete\":%s,\"events\":%zu,\"objects\":%zu,"
+           "\"total_ms\":%.3f,\"events_per_sec\":%.0f,\"pauses\":%zu,"
+           "\"pause_total_ms\":%.3f,\"pause_p99_us\":%.1f,\"pause_max_us\":%.1f,\"peak_rss_kb\":%ld}\n",
+           replayer_backend_name(backend), ok ? "true" : "false", result.events, result.objects,
+           result.total_ns / 1e6, result.events / (result.total_ns / 1e9), result.pauses,
+           pause_total / 1e6, p99 / 1e3, max / 1e3, usage.ru_maxrss);
+    fflush(stdout);
+    replayer_result_free(&result);
+    return ok;
+}
+
+/**
+ * @brief Read a whole file.
+ * 
+ * @param path Path of the file.
+ * @param size Receives the size of the file.
+ * @return Contents of the file, or NULL if it cannot be read.
+ */
+static uint8_t *_read_file(const char *path, size_t *size)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL)
+        return NULL;
+
+    uint8_t *data = NULL;
+    size_t used = 0;
+    size_t capacity = 0;
+    for (;;)
+    {
+        if (used == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1 << 20;
+            data = _xrealloc(data, capacity);
+        }
+        size_t n = fread(data + used, 1, capacity - used, in);
+        used += n;
+        if (n == 0)
+            break;
+    }
+    bool ok = !ferror(in);
+    fclose(in);
+    if (!ok)
+    {
+        free(data);
+        return NULL;
+    }
+    *size = used;
+    return data;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <trace> [mode...]\nmodes:", argv[0]);
+        for (size_t b = 0; b < replayer_backend_count(); b++)
+        {
+            fprintf(stderr, " %s", replayer_backend_name(b));
+        }
+        fputc('\n', stderr);
+        return 2;
+    }
+
+    size_t size = 0;
+    uint8_t *trace = _read_file(argv[1], &size);
+    if (trace == NULL || size < 8 || memcmp(trace, RECORDER_MAGIC, 4) != 0 ||
+        (trace[4] | trace[5] << 8 | trace[6] << 16 | (uint32_t)trace[7] << 24) != RECORDER_VERSION)
+    {
+        fprintf(stderr, "replay: %s is not a readable trace\n", argv[1]);
+        return 1;
+    }
+
+    int status = 0;
+    for (size_t b = 0; b < replayer_backend_count(); b++)
+    {
+        const char *name = replayer_backend_name(b);
+        bool selected = argc == 2;
+        for (int i = 2; i < argc; i++)
+        {
+            selected = selected || strcmp(argv[i], name) == 0;
+        }
+        if (!selected)
+            continue;
+
+        // A fresh process per model, so heaps and peak RSS do not carry over
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            bool ok = _run(b, trace, size);
+            free(trace);
+            exit(ok ? 0 : 1);
+        }
+
+        int child = 1;
+        if (pid < 0 || waitpid(pid, &child, 0) < 0 || !WIFEXITED(child) || WEXITSTATUS(child) != 0)
+        {
+            fprintf(stderr, "replay: mode %s failed on %s\n", name, argv[1]);
+            status = 1;
+        }
+    }
+
+    free(trace);
+    return status;
+}
@@ -0,0 +1,856 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "replayer.h"
+#include "object_rc.h"
+#include "object_ms.h"
+#include "hashmap.h"
+#include "recorder.h"
+#include "stack.h"
+
+/**
+ * @struct ReplayArgs
+ * @brief Operands of a `REC_NEW` record.
+ */
+typedef struct ReplayArgs {
+    int64_t ints[3];       /**< INTEGER value, VECTOR3I components */
+    float floats[3];       /**< FLOAT value, VECTOR3F components */
+    object_t *refs[3];     /**< VECTOR3 components, WEAK target */
+    size_t size;           /**< String length, array size, 1 for an ephemeron map */
+    const char *bytes;     /**< String contents, not NUL terminated */
+} replay_args_t;
+
+/**
+ * @struct ReplayBackend
+ * @brief A memory model driven by the replayer.
+ * 
+ * Objects passed in are never NULL and were returned by `create`. Frame and
+ * handle positions are those of the trace, and may be out of range.
+ */
+typedef struct ReplayBackend {
+    const char *name;      /**< Mode selected on the command line */
+    void *(*open)(void);   /**< Create the model's state, NULL on failure */
+    object_t *(*create)(void *state, object_kind_t kind, const replay_args_t *args); /**< `REC_NEW` */
+    bool (*array_set)(void *state, object_t *array, size_t index, object_t *value); /**< `REC_ARRAY_SET` */
+    bool (*array_push)(void *state, object_t *array, object_t *value); /**< `REC_ARRAY_PUSH` */
+    void (*array_pop)(void *state, object_t *array); /**< `REC_ARRAY_POP` */
+    bool (*map_set)(void *state, object_t *map, object_t *key, object_t *value); /**< `REC_MAP_SET` */
+    bool (*map_remove)(void *state, object_t *map, object_t *key); /**< `REC_MAP_REMOVE` */
+    void (*frame_push)(void *state); /**< `REC_FRAME_PUSH` */
+    void (*frame_pop)(void *state); /**< `REC_FRAME_POP` */
+    void (*frame_reference)(void *state, size_t depth, object_t *obj); /**< `REC_FRAME_REFERENCE` */
+    void (*handle)(void *state, object_t *obj); /**< `REC_HANDLE` */
+    void (*handle_clear)(void *state, size_t position); /**< `REC_HANDLE_CLEAR` */
+    void (*handle_scope_close)(void *state, size_t position); /**< `REC_HANDLE_SCOPE_CLOSE` */
+    void (*root)(void *state, object_t *obj); /**< `REC_ROOT` */
+    void (*collect)(void *state); /**< `REC_COLLECT` */
+    void (*close)(void *state); /**< Free everything, roots included */
+} replay_backend_t;
+
+/**
+ * @struct ReplayReader
+ * @brief Cursor over a trace loaded in memory.
+ */
+typedef struct ReplayReader {
+    const uint8_t *next;   /**< Next byte to decode */
+    const uint8_t *end;    /**< End of the trace */
+    bool truncated;        /**< A record ran past the end */
+} replay_reader_t;
+
+/**
+ * @brief Read a monotonic clock.
+ * 
+ * @return Current time in nanoseconds.
+ */
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Read a byte.
+ * 
+ * @param in Trace being read.
+ * @return The byte, 0 past the end of the trace.
+ */
+static uint8_t _read_u8(replay_reader_t *in)
+{
+    if (in->next == in->end)
+    {
+        in->truncated = true;
+        return 0;
+    }
+    return *in->next++;
+}
+
+/**
+ * @brief Read an unsigned LEB128 integer.
+ * 
+ * @param in Trace being read.
+ * @return The value.
+ */
+static uint64_t _read_varint(replay_reader_t *in)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t byte = _read_u8(in);
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            break;
+    }
+    return value;
+}
+
+/**
+ * @brief Read a zigzag encoded signed integer.
+ * 
+ * @param in Trace being read.
+ * @return The value.
+ */
+static int64_t _read_signed(replay_reader_t *in)
+{
+    uint64_t value = _read_varint(in);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief Read the 4 little endian bytes of a float.
+ * 
+ * @param in Trace being read.
+ * @return The value.
+ */
+static float _read_float(replay_reader_t *in)
+{
+    uint32_t bits = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        bits |= (uint32_t)_read_u8(in) << (8 * i);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @struct RcState
+ * @brief Roots of the reference counting replay.
+ * 
+ * Frames and handles own one reference per object they root, and the bottom
+ * frame holds the `REC_ROOT` objects. A reference the traced program dropped
+ * is not released at once but moved to `pending`, as are creation references,
+ * until the next collection record: the point where mark-and-sweep would
+ * reclaim the object, so later records may still use it.
+ */
+typedef struct RcState {
+    stack_t *frames;       /**< One stack of rooted objects per frame */
+    stack_t *handles;      /**< Object rooted by each handle, NULL once cleared */
+    stack_t *pending;      /**< References dropped since the last collection */
+} rc_state_t;
+
+/**
+ * @brief Release every object of a stack and empty it.
+ * 
+ * @param objects Stack of owned references, NULL entries allowed.
+ */
+static void _rc_release_all(stack_t *objects)
+{
+    while (objects->count > 0)
+    {
+        object_t *obj = stack_pop(objects);
+        release_reference(&obj);
+    }
+}
+
+/**
+ * @brief Hand a reference over to `pending`, to be released by the next collection.
+ * 
+ * @param rc Replay state.
+ * @param obj Owned reference, or NULL.
+ */
+static void _rc_defer(rc_state_t *rc, object_t *obj)
+{
+    if (obj != NULL && !stack_push(rc->pending, obj))
+    {
+        release_reference(&obj);
+    }
+}
+
+/**
+ * @brief Keep an object the next record drops alive until the next collection.
+ * 
+ * @param rc Replay state.
+ * @param obj Object, or NULL.
+ */
+static void _rc_keep(rc_state_t *rc, object_t *obj)
+{
+    if (obj != NULL)
+    {
+        add_reference(obj);
+        _rc_defer(rc, obj);
+    }
+}
+
+static void _rc_close(void *state);
+
+static void _rc_frame_push(void *state)
+{
+    rc_state_t *rc = state;
+    stack_t *roots = stack_new(8);
+    if (roots != NULL && !stack_push(rc->frames, roots))
+    {
+        stack_free(roots);
+    }
+}
+
+static void *_rc_open(void)
+{
+    rc_state_t *rc = malloc(sizeof(rc_state_t));
+    if (rc == NULL)
+        return NULL;
+
+    rc->frames = stack_new(8);
+    rc->handles = stack_new(64);
+    rc->pending = stack_new(1024);
+    if (rc->frames == NULL || rc->handles == NULL || rc->pending == NULL)
+    {
+        stack_free(rc->frames);
+        stack_free(rc->handles);
+        stack_free(rc->pending);
+        free(rc);
+        return NULL;
+    }
+    _rc_frame_push(rc);
+    if (rc->frames->count == 0)
+    {
+        _rc_close(rc);
+        return NULL;
+    }
+    return rc;
+}
+
+static object_t *_rc_create(void *state, object_kind_t kind, const replay_args_t *args)
+{
+    rc_state_t *rc = state;
+    object_t *obj = NULL;
+    switch (kind)
+    {
+    case INTEGER:
+        obj = new_integer((int)args->ints[0]);
+        break;
+    case FLOAT:
+        obj = new_float(args->floats[0]);
+        break;
+    case STRING:
+        obj = new_string_len(args->bytes, args->size);
+        break;
+    case VECTOR3:
+        obj = new_vector3(args->refs[0], args->refs[1], args->refs[2]);
+        break;
+    case VECTOR3I:
+        obj = new_vector3i((int)args->ints[0], (int)args->ints[1], (int)args->ints[2]);
+        break;
+    case VECTOR3F:
+        obj = new_vector3f(args->floats[0], args->floats[1], args->floats[2]);
+        break;
+    case ARRAY:
+        obj = new_array(args->size);
+        break;
+    case INT_ARRAY:
+        obj = new_int_array(args->size);
+        break;
+    case FLOAT_ARRAY:
+        obj = new_float_array(args->size);
+        break;
+    case MAP:
+        obj = args->size ? new_ephemeron_map() : new_map();
+        break;
+    case WEAK:
+        obj = new_weak(args->refs[0]);
+        break;
+    default:
+        break;
+    }
+    if (obj != NULL && !stack_push(rc->pending, obj))
+    {
+        release_reference(&obj);
+        return NULL;
+    }
+    return obj;
+}
+
+static bool _rc_array_set(void *state, object_t *array, size_t index, object_t *value)
+{
+    _rc_keep(state, array_get(array, index));
+    return array_set(array, index, value);
+}
+
+static bool _rc_array_push(void *state, object_t *array, object_t *value)
+{
+    return array_push(array, value);
+}
+
+static void _rc_array_pop(void *state, object_t *array)
+{
+    _rc_defer(state, array_pop(array));
+}
+
+/**
+ * @brief Keep the entry of a map a store or removal is about to drop.
+ * 
+ * @param rc Replay state.
+ * @param map Map object.
+ * @param key Key looked up.
+ */
+static void _rc_keep_entry(rc_state_t *rc, object_t *map, object_t *key)
+{
+    if (map->kind != MAP)
+        return;
+
+    map_entry_t *entry = hashmap_find(&map->data.v_map, key);
+    if (entry != NULL)
+    {
+        _rc_keep(rc, entry->key);
+        _rc_keep(rc, entry->value);
+    }
+}
+
+static bool _rc_map_set(void *state, object_t *map, object_t *key, object_t *value)
+{
+    _rc_keep_entry(state, map, key);
+    return map_set(map, key, value);
+}
+
+static bool _rc_map_remove(void *state, object_t *map, object_t *key)
+{
+    _rc_keep_entry(state, map, key);
+    return map_remove(map, key);
+}
+
+static void _rc_frame_pop(void *state)
+{
+    rc_state_t *rc = state;
+    if (rc->frames->count <= 1)
+        return;
+
+    stack_t *roots = stack_pop(rc->frames);
+    while (roots->count > 0)
+    {
+        _rc_defer(rc, stack_pop(roots));
+    }
+    stack_free(roots);
+}
+
+static void _rc_frame_reference(void *state, size_t depth, object_t *obj)
+{
+    rc_state_t *rc = state;
+    if (depth + 1 < rc->frames->count && stack_push(rc->frames->data[depth + 1], obj))
+    {
+        add_reference(obj);
+    }
+}
+
+static void _rc_handle(void *state, object_t *obj)
+{
+    rc_state_t *rc = state;
+    if (stack_push(rc->handles, obj))
+    {
+        add_reference(obj);
+    }
+}
+
+static void _rc_handle_clear(void *state, size_t position)
+{
+    rc_state_t *rc = state;
+    if (position < rc->handles->count)
+    {
+        _rc_defer(rc, rc->handles->data[position]);
+        rc->handles->data[position] = NULL;
+    }
+}
+
+static void _rc_handle_scope_close(void *state, size_t position)
+{
+    rc_state_t *rc = state;
+    while (rc->handles->count > position)
+    {
+        _rc_defer(rc, stack_pop(rc->handles));
+    }
+}
+
+static void _rc_root(void *state, object_t *obj)
+{
+    rc_state_t *rc = state;
+    if (stack_push(rc->frames->data[0], obj))
+    {
+        add_reference(obj);
+    }
+}
+
+static void _rc_collect(void *state)
+{
+    rc_state_t *rc = state;
+    _rc_release_all(rc->pending);
+}
+
+static void _rc_close(void *state)
+{
+    rc_state_t *rc = state;
+    while (rc->frames->count > 0)
+    {
+        stack_t *roots = stack_pop(rc->frames);
+        _rc_release_all(roots);
+        stack_free(roots);
+    }
+    _rc_release_all(rc->handles);
+    _rc_release_all(rc->pending);
+    stack_free(rc->frames);
+    stack_free(rc->handles);
+    stack_free(rc->pending);
+    free(rc);
+}
+
+/**
+ * @brief Mark-and-sweep replays drive a VM through the `*_ms` API, frames and
+ *        handles included. The bottom frame holds the `REC_ROOT` objects.
+ */
+static void *_ms_open(void)
+{
+    vm_t *vm = vm_new(false);
+    if (vm != NULL && vm_new_frame(vm) == NULL)
+    {
+        vm_free(vm);
+        return NULL;
+    }
+    return vm;
+}
+
+static void *_ms_open_prefetch(void)
+{
+    vm_t *vm = _ms_open();
+    if (vm != NULL)
+        vm->prefetch_marking = true;
+    return vm;
+}
+
+static object_t *_ms_create(void *state, object_kind_t kind, const replay_args_t *args)
+{
+    vm_t *vm = state;
+    switch (kind)
+    {
+    case INTEGER:
+        return new_integer_ms(vm, (int)args->ints[0]);
+    case FLOAT:
+        return new_float_ms(vm, args->floats[0]);
+    case STRING:
+        return new_string_len_ms(vm, args->bytes, args->size);
+    case VECTOR3:
+        return new_vector3_ms(vm, args->refs[0], args->refs[1], args->refs[2]);
+    case VECTOR3I:
+        return new_vector3i_ms(vm, (int)args->ints[0], (int)args->ints[1], (int)args->ints[2]);
+    case VECTOR3F:
+        return new_vector3f_ms(vm, args->floats[0], args->floats[1], args->floats[2]);
+    case ARRAY:
+        return new_array_ms(vm, args->size);
+    case INT_ARRAY:
+        return new_int_array_ms(vm, args->size);
+    case FLOAT_ARRAY:
+        return new_float_array_ms(vm, args->size);
+    case MAP:
+        return args->size ? new_ephemeron_map_ms(vm) : new_map_ms(vm);
+    case WEAK:
+        return new_weak_ms(vm, args->refs[0]);
+    default:
+        return NULL;
+    }
+}
+
+static bool _ms_array_set(void *state, object_t *array, size_t index, object_t *value)
+{
+    return array_set_ms(state, array, index, value);
+}
+
+static bool _ms_array_push(void *state, object_t *array, object_t *value)
+{
+    return array_push_ms(state, array, value);
+}
+
+static void _ms_array_pop(void *state, object_t *array)
+{
+    array_pop_ms(state, array);
+}
+
+static bool _ms_map_set(void *state, object_t *map, object_t *key, object_t *value)
+{
+    return map_set_ms(state, map, key, value);
+}
+
+static bool _ms_map_remove(void *state, object_t *map, object_t *key)
+{
+    return map_remove_ms(state, map, key);
+}
+
+static void _ms_frame_push(void *state)
+{
+    vm_new_frame(state);
+}
+
+static void _ms_frame_pop(void *state)
+{
+    vm_t *vm = state;
+    if (vm->frames->count > 1)
+    {
+        frame_free(vm_frame_pop(vm));
+    }
+}
+
+static void _ms_frame_reference(void *state, size_t depth, object_t *obj)
+{
+    vm_t *vm = state;
+    if (depth + 1 < vm->frames->count)
+    {
+        frame_reference_object(vm->frames->data[depth + 1], obj);
+    }
+}
+
+/**
+ * @brief Read the position of the next free handle slot.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @return Number of handle slots below it.
+ */
+static size_t _ms_handle_top(vm_t *vm)
+{
+    return vm->handles.block * HANDLE_BLOCK_SLOTS + vm->handles.used;
+}
+
+static void _ms_handle(void *state, object_t *obj)
+{
+    vm_handle(state, obj);
+}
+
+static void _ms_handle_clear(void *state, size_t position)
+{
+    vm_t *vm = state;
+    if (position < _ms_handle_top(vm))
+    {
+        object_t **block = vm->handle_blocks->data[position / HANDLE_BLOCK_SLOTS];
+        handle_clear(block + position % HANDLE_BLOCK_SLOTS);
+    }
+}
+
+static void _ms_handle_scope_close(void *state, size_t position)
+{
+    vm_t *vm = state;
+    if (position <= _ms_handle_top(vm))
+    {
+        handle_scope_t scope = {position / HANDLE_BLOCK_SLOTS, position % HANDLE_BLOCK_SLOTS};
+        vm_handle_scope_close(vm, &scope);
+    }
+}
+
+static void _ms_root(void *state, object_t *obj)
+{
+    vm_t *vm = state;
+    frame_reference_object(vm->frames->data[0], obj);
+}
+
+static void _ms_collect(void *state)
+{
+    vm_collect_garbage(state);
+}
+
+static void _ms_close(void *state)
+{
+    vm_t *vm = state;
+    while (vm->frames->count > 0)
+    {
+        frame_free(vm_frame_pop(vm));
+    }
+    vm_free(vm);
+}
+
+static const replay_backend_t _backends[] = {
+    {
+        .name = "rc", .open = _rc_open, .create = _rc_create,
+        .array_set = _rc_array_set, .array_push = _rc_array_push, .array_pop = _rc_array_pop,
+        .map_set = _rc_map_set, .map_remove = _rc_map_remove,
+        .frame_push = _rc_frame_push, .frame_pop = _rc_frame_pop, .frame_reference = _rc_frame_reference,
+        .handle = _rc_handle, .handle_clear = _rc_handle_clear, .handle_scope_close = _rc_handle_scope_close,
+        .root = _rc_root, .collect = _rc_collect, .close = _rc_close,
+    },
+    {
+        .name = "ms", .open = _ms_open, .create = _ms_create,
+        .array_set = _ms_array_set, .array_push = _ms_array_push, .array_pop = _ms_array_pop,
+        .map_set = _ms_map_set, .map_remove = _ms_map_remove,
+        .frame_push = _ms_frame_push, .frame_pop = _ms_frame_pop, .frame_reference = _ms_frame_reference,
+        .handle = _ms_handle, .handle_clear = _ms_handle_clear, .handle_scope_close = _ms_handle_scope_close,
+        .root = _ms_root, .collect = _ms_collect, .close = _ms_close,
+    },
+    {
+        .name = "ms-prefetch", .open = _ms_open_prefetch, .create = _ms_create,
+        .array_set = _ms_array_set, .array_push = _ms_array_push, .array_pop = _ms_array_pop,
+        .map_set = _ms_map_set, .map_remove = _ms_map_remove,
+        .frame_push = _ms_frame_push, .frame_pop = _ms_frame_pop, .frame_reference = _ms_frame_reference,
+        .handle = _ms_handle, .handle_clear = _ms_handle_clear, .handle_scope_close = _ms_handle_scope_close,
+        .root = _ms_root, .collect = _ms_collect, .close = _ms_close,
+    },
+};
+
+#define BACKEND_COUNT (sizeof(_backends) / sizeof(_backends[0]))
+
+size_t replayer_backend_count(void)
+{
+    return BACKEND_COUNT;
+}
+
+const char *replayer_backend_name(size_t backend)
+{
+    return backend < BACKEND_COUNT ? _backends[backend].name : NULL;
+}
+
+/**
+ * @brief Look up an object by trace id.
+ * 
+ * @param in Trace being read.
+ * @param objects Objects created so far, indexed by id - 1.
+ * @param count Number of objects created so far.
+ * @return The object, or NULL for id 0, an unknown id or an object the model failed to create.
+ */
+static object_t *_read_object(replay_reader_t *in, object_t **objects, size_t count)
+{
+    uint64_t id = _read_varint(in);
+    return id > 0 && id <= count ? objects[id - 1] : NULL;
+}
+
+/**
+ * @brief Make room for one more element in a growing array.
+ * 
+ * @param data Array to grow, updated on success.
+ * @param count Number of elements in use.
+ * @param capacity Number of elements allocated, updated on success.
+ * @param elem_size Size of an element.
+ * @return True if there is room, false if allocation fails.
+ */
+static bool _reserve(void **data, size_t count, size_t *capacity, size_t elem_size)
+{
+    if (count < *capacity)
+        return true;
+
+    size_t grown = *capacity ? *capacity * 2 : 64;
+    void *resized = realloc(*data, grown * elem_size);
+    if (resized == NULL)
+        return false;
+
+    *data = resized;
+    *capacity = grown;
+    return true;
+}
+
+/**
+ * @brief Decode the operands of a `REC_NEW` record.
+ * 
+ * @param in Trace being read.
+ * @param kind Kind of the object.
+ * @param objects Objects created so far, indexed by id - 1.
+ * @param count Number of objects created so far.
+ * @param args Receives the operands.
+ * @return True if successful, false for an unknown kind.
+ */
+static bool _read_new(replay_reader_t *in, object_kind_t kind, object_t **objects, size_t count,
+                      replay_args_t *args)
+{
+    switch (kind)
+    {
+    case INTEGER:
+        args->ints[0] = _read_signed(in);
+        return true;
+    case FLOAT:
+        args->floats[0] = _read_float(in);
+        return true;
+    case STRING:
+        args->size = _read_varint(in);
+        if (args->size > (size_t)(in->end - in->next))
+        {
+            in->truncated = true;
+            return true;
+        }
+        args->bytes = (const char *)in->next;
+        in->next += args->size;
+        return true;
+    case VECTOR3:
+        for (int i = 0; i < 3; i++)
+            args->refs[i] = _read_object(in, objects, count);
+        return true;
+    case VECTOR3I:
+        for (int i = 0; i < 3; i++)
+            args->ints[i] = _read_signed(in);
+        return true;
+    case VECTOR3F:
+        for (int i = 0; i < 3; i++)
+            args->floats[i] = _read_float(in);
+        return true;
+    case ARRAY:
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        args->size = _read_varint(in);
+        return true;
+    case MAP:
+        args->size = _read_u8(in);
+        return true;
+    case WEAK:
+        args->refs[0] = _read_object(in, objects, count);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool replayer_run(size_t backend, const uint8_t *trace, size_t size, replay_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    if (backend >= BACKEND_COUNT || trace == NULL || size < 8 ||
+        memcmp(trace, RECORDER_MAGIC, 4) != 0 ||
+        (trace[4] | trace[5] << 8 | trace[6] << 16 | (uint32_t)trace[7] << 24) != RECORDER_VERSION)
+    {
+        return false;
+    }
+
+    const replay_backend_t *model = &_backends[backend];
+    replay_reader_t in = {trace + 8, trace + size, false};
+    object_t **objects = NULL;
+    size_t capacity = 0;
+    size_t pause_capacity = 0;
+
+    uint64_t start = _now_ns();
+    void *state = model->open();
+    if (state == NULL)
+        return false;
+
+    bool ok = true;
+    while (ok && in.next < in.end)
+    {
+        recorder_op_t op = _read_u8(&in);
+        switch (op)
+        {
+        case REC_NEW:
+        {
+            object_kind_t kind = _read_u8(&in);
+            replay_args_t args = {0};
+            ok = _read_new(&in, kind, objects, result->objects, &args) &&
+                 _reserve((void **)&objects, result->objects, &capacity, sizeof(object_t *));
+            if (!ok || in.truncated)
+                break;
+
+            objects[result->objects++] = model->create(state, kind, &args);
+            break;
+        }
+        case REC_ARRAY_SET:
+        {
+            object_t *array = _read_object(&in, objects, result->objects);
+            size_t index = _read_varint(&in);
+            object_t *value = _read_object(&in, objects, result->objects);
+            if (array != NULL && value != NULL)
+                model->array_set(state, array, index, value);
+            break;
+        }
+        case REC_ARRAY_PUSH:
+        {
+            object_t *array = _read_object(&in, objects, result->objects);
+            object_t *value = _read_object(&in, objects, result->objects);
+            if (array != NULL && value != NULL)
+                model->array_push(state, array, value);
+            break;
+        }
+        case REC_ARRAY_POP:
+        {
+            object_t *array = _read_object(&in, objects, result->objects);
+            if (array != NULL)
+                model->array_pop(state, array);
+            break;
+        }
+        case REC_MAP_SET:
+        {
+            object_t *map = _read_object(&in, objects, result->objects);
+            object_t *key = _read_object(&in, objects, result->objects);
+            object_t *value = _read_object(&in, objects, result->objects);
+            if (map != NULL && key != NULL && value != NULL)
+                model->map_set(state, map, key, value);
+            break;
+        }
+        case REC_MAP_REMOVE:
+        {
+            object_t *map = _read_object(&in, objects, result->objects);
+            object_t *key = _read_object(&in, objects, result->objects);
+            if (map != NULL && key != NULL)
+                model->map_remove(state, map, key);
+            break;
+        }
+        case REC_FRAME_PUSH:
+            model->frame_push(state);
+            break;
+        case REC_FRAME_POP:
+            model->frame_pop(state);
+            break;
+        case REC_FRAME_REFERENCE:
+        {
+            size_t depth = _read_varint(&in);
+            object_t *obj = _read_object(&in, objects, result->objects);
+            if (obj != NULL)
+                model->frame_reference(state, depth, obj);
+            break;
+        }
+        case REC_HANDLE:
+        {
+            // Handles to unknown objects still take a position
+            object_t *obj = _read_object(&in, objects, result->objects);
+            model->handle(state, obj);
+            break;
+        }
+        case REC_HANDLE_CLEAR:
+            model->handle_clear(state, _read_varint(&in));
+            break;
+        case REC_HANDLE_SCOPE_CLOSE:
+            model->handle_scope_close(state, _read_varint(&in));
+            break;
+        case REC_ROOT:
+        {
+            object_t *obj = _read_object(&in, objects, result->objects);
+            if (obj != NULL)
+                model->root(state, obj);
+            break;
+        }
+        case REC_COLLECT:
+        {
+            ok = _reserve((void **)&result->pause_ns, result->pauses, &pause_capacity, sizeof(uint64_t));
+            if (!ok)
+                break;
+
+            uint64_t pause_start = _now_ns();
+            model->collect(state);
+            result->pause_ns[result->pauses++] = _now_ns() - pause_start;
+            break;
+        }
+        default:
+            ok = false;
+            break;
+        }
+        ok = ok && !in.truncated;
+        result->events++;
+    }
+
+    model->close(state);
+    result->total_ns = _now_ns() - start;
+    free(objects);
+    return ok;
+}
+
+void replayer_result_free(replay_result_t *result)
+{
+    free(result->pause_ns);
+    result->pause_ns = NULL;
+    result->pauses = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @struct ReplayResult
+ * @brief Measurements of one replay.
+ */
+typedef struct ReplayResult {
+    size_t events;         /**< Records replayed */
+    size_t objects;        /**< Objects created */
+    uint64_t total_ns;     /**< Time spent replaying, closing the model included */
+    size_t pauses;         /**< Collection records */
+    uint64_t *pause_ns;    /**< Duration of each collection record */
+} replay_result_t;
+
+/**
+ * @brief Count the memory models a trace can be replayed against.
+ * 
+ * @return Number of backends.
+ */
+size_t replayer_backend_count(void);
+
+/**
+ * @brief Name a memory model.
+ * 
+ * @param backend Index of the backend, below `replayer_backend_count()`.
+ * @return Name such as "rc", "ms" or "ms-prefetch", or NULL for an invalid index.
+ */
+const char *replayer_backend_name(size_t backend);
+
+/**
+ * @brief Replay a whole trace written by the recorder against one memory model.
+ * 
+ * @param backend Index of the backend, below `replayer_backend_count()`.
+ * @param trace Trace, header included.
+ * @param size Size of the trace in bytes.
+ * @param result Receives the measurements, to be freed with `replayer_result_free`.
+ * @return True if the whole trace was replayed, false if it is malformed, of
+ *         another version, or allocation fails.
+ * 
+ * @note A pause is the time spent on a `REC_COLLECT` record: a collection for
+ *       mark-and-sweep, and releasing the references dropped since the last
+ *       one for reference counting.
+ */
+bool replayer_run(size_t backend, const uint8_t *trace, size_t size, replay_result_t *result);
+
+/**
+ * @brief Free the pauses of a replay result.
+ * 
+ * @param result Result filled by `replayer_run`.
+ */
+void replayer_result_free(replay_result_t *result);
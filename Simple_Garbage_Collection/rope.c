@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rope.h"
+#include "buffer.h"
+
+/**
+ * @brief Minimum length of a balanced rope of a given depth, i.e. `Fib(depth + 2)`.
+ */
+static size_t min_length[ROPE_MAX_DEPTH + 1];
+
+/**
+ * @brief Fill the `min_length` table on first use.
+ */
+static void _init_min_length(void)
+{
+    if (min_length[0] != 0)
+        return;
+
+    min_length[0] = 1;
+    min_length[1] = 2;
+    for (size_t i = 2; i <= ROPE_MAX_DEPTH; i++)
+    {
+        min_length[i] = min_length[i - 1] + min_length[i - 2];
+    }
+}
+
+/**
+ * @brief Check the Fibonacci balance criterion for a rope.
+ * 
+ * @param rope Rope to check.
+ * @return True if the rope is at least `Fib(depth + 2)` bytes long.
+ */
+static bool _is_balanced(rope_t *rope)
+{
+    return rope->depth < ROPE_MAX_DEPTH && rope->length >= min_length[rope->depth];
+}
+
+/**
+ * @brief Create an inner node without any rebalancing.
+ * 
+ * @param left Left child, a reference is added.
+ * @param right Right child, a reference is added.
+ * @return Pointer to the new node, or NULL if allocation fails.
+ */
+static rope_t *_new_node(rope_t *left, rope_t *right)
+{
+    rope_t *node = malloc(sizeof(rope_t));
+    if (node == NULL)
+        return NULL;
+
+    node->refcount = 1;
+    node->length = left->length + right->length;
+    node->depth = 1 + (left->depth > right->depth ? left->depth : right->depth);
+    node->left = rope_retain(left);
+    node->right = rope_retain(right);
+    node->chars = NULL;
+    return node;
+}
+
+/**
+ * @brief Insert a balanced rope into the forest used by `_balance`.
+ * 
+ * @param rope Balanced rope to insert, a reference is added.
+ * @param forest Slots where slot `i` holds a rope of length in `[min_length[i], min_length[i + 1])`.
+ * @return True if successful, false if allocation fails.
+ * 
+ * @note Boehm, Atkinson & Plass, "Ropes: an Alternative to Strings" (1995).
+ */
+static bool _add_leaf_to_forest(rope_t *rope, rope_t **forest)
+{
+    rope_t *too_tiny = NULL;
+    size_t i = 0;
+
+    // Concatenate everything shorter than the new rope in front of it
+    for (; i < ROPE_MAX_DEPTH && rope->length >= min_length[i + 1]; i++)
+    {
+        if (forest[i] == NULL)
+            continue;
+
+        rope_t *tmp = too_tiny ? _new_node(forest[i], too_tiny) : rope_retain(forest[i]);
+        if (tmp == NULL)
+        {
+            rope_release(too_tiny);
+            return false;
+        }
+        rope_release(too_tiny);
+        rope_release(forest[i]);
+        forest[i] = NULL;
+        too_tiny = tmp;
+    }
+
+    rope_t *insertee = too_tiny ? _new_node(too_tiny, rope) : rope_retain(rope);
+    rope_release(too_tiny);
+    if (insertee == NULL)
+        return false;
+
+    // Carry the result upwards until it fits an empty slot
+    for (;; i++)
+    {
+        if (forest[i] != NULL)
+        {
+            rope_t *tmp = _new_node(forest[i], insertee);
+            rope_release(insertee);
+            if (tmp == NULL)
+                return false;
+
+            rope_release(forest[i]);
+            forest[i] = NULL;
+            insertee = tmp;
+        }
+        if (i == ROPE_MAX_DEPTH || insertee->length < min_length[i + 1])
+        {
+            forest[i] = insertee;
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Insert every maximal balanced sub-rope of a rope into the forest.
+ * 
+ * @param rope Rope to decompose.
+ * @param forest Forest to insert into.
+ * @return True if successful, false if allocation fails.
+ * 
+ * @note Balanced sub-ropes are reused as-is, so only the unbalanced spine is rebuilt.
+ */
+static bool _add_to_forest(rope_t *rope, rope_t **forest)
+{
+    if (_is_balanced(rope))
+        return _add_leaf_to_forest(rope, forest);
+
+    return _add_to_forest(rope->left, forest) && _add_to_forest(rope->right, forest);
+}
+
+/**
+ * @brief Rebuild a rope so that its depth is logarithmic in its length.
+ * 
+ * @param rope Rope to rebalance.
+ * @return Pointer to a new, balanced rope, or NULL if allocation fails.
+ */
+static rope_t *_balance(rope_t *rope)
+{
+    rope_t *forest[ROPE_MAX_DEPTH + 1] = {0};
+    bool ok = _add_to_forest(rope, forest);
+
+    rope_t *result = NULL;
+    for (size_t i = 0; i <= ROPE_MAX_DEPTH; i++)
+    {
+        if (forest[i] == NULL)
+            continue;
+
+        if (ok)
+        {
+            rope_t *tmp = result ? _new_node(forest[i], result) : rope_retain(forest[i]);
+            if (tmp == NULL)
+                ok = false;
+            rope_release(result);
+            result = tmp;
+        }
+        rope_release(forest[i]);
+    }
+
+    if (!ok)
+    {
+        rope_release(result);
+        return NULL;
+    }
+    return result;
+}
+
+rope_t *rope_leaf(char *chars, size_t length)
+{
+    rope_t *leaf = malloc(sizeof(rope_t));
+    if (leaf == NULL)
+        return NULL;
+
+    leaf->refcount = 1;
+    leaf->length = length;
+    leaf->depth = 0;
+    leaf->left = NULL;
+    leaf->right = NULL;
+    leaf->chars = buffer_retain(chars);
+    return leaf;
+}
+
+rope_t *rope_concat(rope_t *left, rope_t *right)
+{
+    if (left == NULL || right == NULL)
+        return NULL;
+
+    if (right->length == 0)
+        return rope_retain(left);
+    if (left->length == 0)
+        return rope_retain(right);
+
+    _init_min_length();
+
+    rope_t *node = _new_node(left, right);
+    if (node == NULL)
+        return NULL;
+
+    if (node->depth > ROPE_REBALANCE_DEPTH && !_is_balanced(node))
+    {
+        rope_t *balanced = _balance(node);
+        // Out of memory while rebalancing, the unbalanced rope is still valid
+        if (balanced == NULL)
+            return node;
+
+        rope_release(node);
+        node = balanced;
+    }
+    return node;
+}
+
+/**
+ * @brief Copy the leaves of a rope into a contiguous destination.
+ * 
+ * @param rope Rope to copy.
+ * @param dst Destination with room for `rope->length` bytes.
+ * @return Pointer just past the copied bytes.
+ */
+static char *_copy_leaves(rope_t *rope, char *dst)
+{
+    if (rope->chars != NULL)
+    {
+        memcpy(dst, rope->chars, rope->length);
+        return dst + rope->length;
+    }
+
+    dst = _copy_leaves(rope->left, dst);
+    return _copy_leaves(rope->right, dst);
+}
+
+char *rope_flatten(rope_t *rope)
+{
+    if (rope == NULL)
+        return NULL;
+
+    char *dst = buffer_new(rope->length + 1);
+    if (dst == NULL)
+        return NULL;
+
+    _copy_leaves(rope, dst);
+    return dst;
+}
+
+char rope_index(rope_t *rope, size_t index)
+{
+    if (rope == NULL || index >= rope->length)
+        return '\0';
+
+    while (rope->chars == NULL)
+    {
+        if (index < rope->left->length)
+        {
+            rope = rope->left;
+        }
+        else
+        {
+            index -= rope->left->length;
+            rope = rope->right;
+        }
+    }
+    return rope->chars[index];
+}
+
+rope_t *rope_retain(rope_t *rope)
+{
+    if (rope != NULL)
+        rope->refcount++;
+
+    return rope;
+}
+
+void rope_release(rope_t *rope)
+{
+    if (rope == NULL)
+        return;
+
+    rope->refcount--;
+    if (rope->refcount > 0)
+        return;
+
+    if (rope->chars != NULL)
+    {
+        buffer_release(rope->chars);
+    }
+    else
+    {
+        rope_release(rope->left);
+        rope_release(rope->right);
+    }
+    free(rope);
+}
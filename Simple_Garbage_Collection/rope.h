@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Strings at most this long are concatenated eagerly into a flat buffer.
+ */
+#define ROPE_FLAT_MAX 64
+
+/**
+ * @brief Concatenation trees deeper than this are rebalanced when unbalanced.
+ */
+#define ROPE_REBALANCE_DEPTH 8
+
+/**
+ * @brief Maximum depth of a rope, bounded by the Fibonacci balance criterion.
+ */
+#define ROPE_MAX_DEPTH 90
+
+/**
+ * @struct Rope
+ * @brief Immutable, reference counted concatenation tree of string buffers.
+ * 
+ * Leaves share a `buffer_t` string payload, inner nodes hold two sub-ropes.
+ */
+typedef struct Rope
+{
+    size_t refcount;       /**< Number of owners (string objects or parent nodes) */
+    size_t length;         /**< Number of bytes in the rope */
+    size_t depth;          /**< 0 for leaves, 1 + max depth of the children otherwise */
+    struct Rope *left;     /**< Left child, NULL for leaves */
+    struct Rope *right;    /**< Right child, NULL for leaves */
+    char *chars;           /**< Leaf contents (`buffer_t` payload), NULL for inner nodes */
+} rope_t;
+
+/**
+ * @brief Create a leaf sharing a string buffer.
+ * 
+ * @param chars String buffer payload, a reference is added.
+ * @param length Number of bytes of `chars` covered by the leaf.
+ * @return Pointer to the new leaf, or NULL if allocation fails.
+ */
+rope_t *rope_leaf(char *chars, size_t length);
+
+/**
+ * @brief Concatenate two ropes in constant time, rebalancing when needed.
+ * 
+ * @param left Left rope, a reference is added.
+ * @param right Right rope, a reference is added.
+ * @return Pointer to the new rope, or NULL if allocation fails.
+ */
+rope_t *rope_concat(rope_t *left, rope_t *right);
+
+/**
+ * @brief Copy the contents of a rope into a new, NUL terminated string buffer.
+ * 
+ * @param rope Rope to flatten.
+ * @return Pointer to the `buffer_t` payload, or NULL if allocation fails.
+ */
+char *rope_flatten(rope_t *rope);
+
+/**
+ * @brief Get the byte at a position in a rope, in time proportional to its depth.
+ * 
+ * @param rope Rope to index.
+ * @param index Position of the byte.
+ * @return The byte at `index`, or '\0' if out of range.
+ */
+char rope_index(rope_t *rope, size_t index);
+
+/**
+ * @brief Add an owner to a rope.
+ * 
+ * @param rope Rope to share.
+ * @return The same rope.
+ */
+rope_t *rope_retain(rope_t *rope);
+
+/**
+ * @brief Drop one owner of a rope, freeing the nodes (and leaf buffers) no longer used.
+ * 
+ * @param rope Rope to release.
+ */
+void rope_release(rope_t *rope);
@@ -0,0 +1,227 @@
+#include "simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Scalar kernels, also used for the tails of the vector kernels.
+ */
+static void _add_int_scalar(int *dst, const int *a, const int *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] + b[i];
+}
+
+static void _add_float_scalar(float *dst, const float *a, const float *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] + b[i];
+}
+
+static void _add_int_float_scalar(float *dst, const int *a, const float *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = a[i] + b[i];
+}
+
+#if defined(SIMD_X86)
+
+__attribute__((target("sse2")))
+static void _add_int_sse2(int *dst, const int *a, const int *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi32(va, vb));
+    }
+    _add_int_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void _add_float_sse2(float *dst, const float *a, const float *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vb = _mm_loadu_ps(b + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(va, vb));
+    }
+    _add_float_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void _add_int_float_sse2(float *dst, const int *a, const float *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 va = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(a + i)));
+        __m128 vb = _mm_loadu_ps(b + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(va, vb));
+    }
+    _add_int_float_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void _add_int_avx2(int *dst, const int *a, const int *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_add_epi32(va, vb));
+    }
+    _add_int_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void _add_float_avx2(float *dst, const float *a, const float *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 va = _mm256_loadu_ps(a + i);
+        __m256 vb = _mm256_loadu_ps(b + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(va, vb));
+    }
+    _add_float_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void _add_int_float_avx2(float *dst, const int *a, const float *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 va = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(a + i)));
+        __m256 vb = _mm256_loadu_ps(b + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(va, vb));
+    }
+    _add_int_float_scalar(dst + i, a + i, b + i, n - i);
+}
+
+#endif
+
+/**
+ * @brief Instruction sets usable on the running CPU.
+ */
+typedef enum SimdLevel {
+    SIMD_UNKNOWN,
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2
+} simd_level_t;
+
+/**
+ * @brief Detect the best instruction set once and cache the result.
+ * 
+ * @return The instruction set the kernels dispatch to.
+ */
+static simd_level_t _simd_level(void)
+{
+    static simd_level_t level = SIMD_UNKNOWN;
+    if (level != SIMD_UNKNOWN)
+        return level;
+
+    level = SIMD_SCALAR;
+#if defined(SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        level = SIMD_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        level = SIMD_SSE2;
+#endif
+    return level;
+}
+
+void simd_add_int(int *dst, const int *a, const int *b, size_t n)
+{
+    switch (_simd_level())
+    {
+#if defined(SIMD_X86)
+    case SIMD_AVX2:
+        _add_int_avx2(dst, a, b, n);
+        return;
+    case SIMD_SSE2:
+        _add_int_sse2(dst, a, b, n);
+        return;
+#endif
+    default:
+        _add_int_scalar(dst, a, b, n);
+        return;
+    }
+}
+
+void simd_add_float(float *dst, const float *a, const float *b, size_t n)
+{
+    switch (_simd_level())
+    {
+#if defined(SIMD_X86)
+    case SIMD_AVX2:
+        _add_float_avx2(dst, a, b, n);
+        return;
+    case SIMD_SSE2:
+        _add_float_sse2(dst, a, b, n);
+        return;
+#endif
+    default:
+        _add_float_scalar(dst, a, b, n);
+        return;
+    }
+}
+
+void simd_add_int_float(float *dst, const int *a, const float *b, size_t n)
+{
+    switch (_simd_level())
+    {
+#if defined(SIMD_X86)
+    case SIMD_AVX2:
+        _add_int_float_avx2(dst, a, b, n);
+        return;
+    case SIMD_SSE2:
+        _add_int_float_sse2(dst, a, b, n);
+        return;
+#endif
+    default:
+        _add_int_float_scalar(dst, a, b, n);
+        return;
+    }
+}
+
+// SSE2 is part of the x86-64 baseline, so the 4-lane kernels need no dispatch
+
+void simd_add_int4(int dst[4], const int a[4], const int b[4])
+{
+#if defined(__SSE2__)
+    __m128i va = _mm_loadu_si128((const __m128i *)a);
+    __m128i vb = _mm_loadu_si128((const __m128i *)b);
+    _mm_storeu_si128((__m128i *)dst, _mm_add_epi32(va, vb));
+#else
+    _add_int_scalar(dst, a, b, 4);
+#endif
+}
+
+void simd_add_float4(float dst[4], const float a[4], const float b[4])
+{
+#if defined(__SSE2__)
+    _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+#else
+    _add_float_scalar(dst, a, b, 4);
+#endif
+}
+
+void simd_add_int_float4(float dst[4], const int a[4], const float b[4])
+{
+#if defined(__SSE2__)
+    __m128 va = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)a));
+    _mm_storeu_ps(dst, _mm_add_ps(va, _mm_loadu_ps(b)));
+#else
+    _add_int_float_scalar(dst, a, b, 4);
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief Element-wise addition of two int arrays, `dst[i] = a[i] + b[i]`.
+ * 
+ * @param dst Destination array, may alias `a` or `b`.
+ * @param a First operand.
+ * @param b Second operand.
+ * @param n Number of elements.
+ * 
+ * @note Uses AVX2 or SSE2 when the CPU supports it, with a scalar fallback.
+ */
+void simd_add_int(int *dst, const int *a, const int *b, size_t n);
+
+/**
+ * @brief Element-wise addition of two float arrays, `dst[i] = a[i] + b[i]`.
+ * 
+ * @param dst Destination array, may alias `a` or `b`.
+ * @param a First operand.
+ * @param b Second operand.
+ * @param n Number of elements.
+ */
+void simd_add_float(float *dst, const float *a, const float *b, size_t n);
+
+/**
+ * @brief Element-wise addition of an int and a float array, `dst[i] = a[i] + b[i]`.
+ * 
+ * @param dst Destination array, may alias `a` or `b`.
+ * @param a First operand, converted to float.
+ * @param b Second operand.
+ * @param n Number of elements.
+ */
+void simd_add_int_float(float *dst, const int *a, const float *b, size_t n);
+
+/**
+ * @brief Add two 4-lane int vectors with a single SIMD instruction.
+ * 
+ * @param dst Destination lanes, may alias `a` or `b`.
+ * @param a First operand.
+ * @param b Second operand.
+ */
+void simd_add_int4(int dst[4], const int a[4], const int b[4]);
+
+/**
+ * @brief Add two 4-lane float vectors with a single SIMD instruction.
+ * 
+ * @param dst Destination lanes, may alias `a` or `b`.
+ * @param a First operand.
+ * @param b Second operand.
+ */
+void simd_add_float4(float dst[4], const float a[4], const float b[4]);
+
+/**
+ * @brief Add a 4-lane int vector to a 4-lane float vector.
+ * 
+ * @param dst Destination lanes, may alias `a` or `b`.
+ * @param a First operand, converted to float.
+ * @param b Second operand.
+ */
+void simd_add_int_float4(float dst[4], const int a[4], const float b[4]);
@@ -1,15 +1,67 @@
+#include <stdint.h>
+
 #include "stack.h"
 
-stack_t *stack_new(size_t capacity)
+size_t stack_growth_double(size_t capacity, size_t needed)
+{
+	size_t grown = capacity < 4 ? 8 : capacity * 2;
+	return grown < needed ? needed : grown;
+}
+
+size_t stack_growth_half(size_t capacity, size_t needed)
+{
+	size_t grown = capacity < 8 ? 8 : capacity + capacity / 2;
+	return grown < needed ? needed : grown;
+}
+
+/**
+ * @brief Resize the element array of a stack.
+ * 
+ * @param stack Pointer to the stack.
+ * @param capacity New capacity, at least `stack->count`.
+ * @return True if successful, false if allocation fails (the stack is unchanged).
+ */
+static bool _resize(stack_t *stack, size_t capacity)
+{
+	if (capacity > SIZE_MAX / sizeof(void *))
+		return false;
+
+	void **data;
+	if (stack->allocator != NULL)
+	{
+		data = stack->allocator->resize(stack->allocator->context, stack->data,
+		                                stack->capacity * sizeof(void *), capacity * sizeof(void *));
+	}
+	else if (capacity == 0)
+	{
+		free(stack->data);
+		data = NULL;
+	}
+	else
+	{
+		data = realloc(stack->data, capacity * sizeof(void *));
+	}
+
+	if (data == NULL && capacity > 0)
+		return false;
+
+	stack->data = data;
+	stack->capacity = capacity;
+	return true;
+}
+
+stack_t *stack_new_with(size_t capacity, stack_growth_t growth, const stack_allocator_t *allocator)
 {
 	stack_t *stack = malloc(sizeof(stack_t));
 	if(stack == NULL)
 		return NULL;
 	
 	stack->count = 0;
-	stack->capacity = capacity;
-	stack->data = malloc(stack->capacity * sizeof(void *));
-	if(stack->data == NULL)
+	stack->capacity = 0;
+	stack->data = NULL;
+	stack->growth = growth != NULL ? growth : stack_growth_double;
+	stack->allocator = allocator;
+	if (capacity > 0 && !_resize(stack, capacity))
 	{
 		free(stack);
 		return NULL;
@@ -18,23 +70,53 @@ stack_t *stack_new(size_t capacity)
 	return stack;
 }
 
-void stack_push(stack_t *stack, void *obj)
+stack_t *stack_new(size_t capacity)
+{
+	return stack_new_with(capacity, NULL, NULL);
+}
+
+bool stack_reserve(stack_t *stack, size_t capacity)
 {
-	if (stack->capacity == stack-> count)
+	if (capacity <= stack->capacity)
+		return true;
+
+	return _resize(stack, capacity);
+}
+
+bool stack_push(stack_t *stack, void *obj)
+{
+	if (stack->capacity == stack->count &&
+	    !_resize(stack, stack->growth(stack->capacity, stack->count + 1)))
 	{
-		stack->capacity *= 2;
-		void **tmptr = realloc(stack->data, stack->capacity * sizeof(void *));
-		if (tmptr == NULL)
-		{
-			free(stack->data);
-			exit(1);
-		}
-		stack->data = tmptr;
+		return false;
 	}
 	
 	stack->data[stack->count] = obj;
 	stack->count++;
-	return;
+	return true;
+}
+
+bool stack_push_many(stack_t *stack, void *const *objs, size_t n)
+{
+	if (n == 0)
+		return true;
+
+	size_t needed = stack->count + n;
+	if (needed < n)
+		return false;
+
+	if (needed > stack->capacity &&
+	    !_resize(stack, stack->growth(stack->capacity, needed)))
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < n; i++)
+	{
+		stack->data[stack->count + i] = objs[i];
+	}
+	stack->count = needed;
+	return true;
 }
 
 void *stack_pop(stack_t *stack) 
@@ -47,10 +129,21 @@ void *stack_pop(stack_t *stack)
 	
 }
 
+bool stack_shrink_to_fit(stack_t *stack)
+{
+	if (stack->count == stack->capacity)
+		return true;
+
+	return _resize(stack, stack->count);
+}
+
 void stack_free(stack_t *stack) {
-  if (stack == NULL || stack->data == NULL)
+  if (stack == NULL)
 	  return;
   
-  free(stack->data);
+  if (stack->allocator != NULL)
+	  stack->allocator->release(stack->allocator->context, stack->data, stack->capacity * sizeof(void *));
+  else
+	  free(stack->data);
   free(stack);
 }
@@ -2,6 +2,27 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * @brief Growth policy, choosing the new capacity of a full stack.
+ * 
+ * @param capacity Current capacity.
+ * @param needed Minimum capacity required, larger than `capacity`.
+ * @return New capacity, at least `needed`.
+ */
+typedef size_t (*stack_growth_t)(size_t capacity, size_t needed);
+
+/**
+ * @struct StackAllocator
+ * @brief Hooks used to allocate the element array of a stack.
+ */
+typedef struct StackAllocator
+{
+    void *(*resize)(void *context, void *ptr, size_t old_size, size_t new_size); /**< `realloc`-like, `ptr` may be NULL */
+    void (*release)(void *context, void *ptr, size_t size);                        /**< `free`-like */
+    void *context;                                                                 /**< Passed to both hooks */
+} stack_allocator_t;
 
 /**
  * @struct Stack
@@ -15,25 +36,75 @@ typedef struct Stack
     size_t count;      /**< Current number of elements in the stack */
     size_t capacity;   /**< Maximum capacity of the stack before resizing */
     void **data;       /**< Array of pointers to stack elements */
+    stack_growth_t growth;               /**< Growth policy */
+    const stack_allocator_t *allocator;  /**< Element array allocator, NULL for `realloc`/`free` */
 } stack_t;
 
+/**
+ * @brief Default growth policy, doubling the capacity (at least 8 elements).
+ * 
+ * @param capacity Current capacity.
+ * @param needed Minimum capacity required.
+ * @return New capacity.
+ */
+size_t stack_growth_double(size_t capacity, size_t needed);
+
+/**
+ * @brief Growth policy adding half the capacity (at least 8 elements), for large, long-lived stacks.
+ * 
+ * @param capacity Current capacity.
+ * @param needed Minimum capacity required.
+ * @return New capacity.
+ */
+size_t stack_growth_half(size_t capacity, size_t needed);
+
 /**
  * @brief Create a new stack with a specified initial capacity.
  * 
- * @param capacity Initial capacity of the stack.
+ * @param capacity Initial capacity of the stack, may be 0.
  * @return Pointer to the newly created stack, or NULL if allocation fails.
  */
 stack_t *stack_new(size_t capacity);
 
+/**
+ * @brief Create a new stack with a custom growth policy and allocator.
+ * 
+ * @param capacity Initial capacity of the stack, may be 0.
+ * @param growth Growth policy, NULL for `stack_growth_double`.
+ * @param allocator Element array allocator, NULL for `realloc`/`free`; must outlive the stack.
+ * @return Pointer to the newly created stack, or NULL if allocation fails.
+ */
+stack_t *stack_new_with(size_t capacity, stack_growth_t growth, const stack_allocator_t *allocator);
+
+/**
+ * @brief Make sure a stack can hold at least `capacity` elements without growing.
+ * 
+ * @param stack Pointer to the stack.
+ * @param capacity Number of elements to make room for.
+ * @return True if successful, false if allocation fails (the stack is unchanged).
+ */
+bool stack_reserve(stack_t *stack, size_t capacity);
+
 /**
  * @brief Push an object onto the stack.
  * 
  * @param stack Pointer to the stack.
  * @param obj Pointer to the object to push onto the stack.
+ * @return True if successful, false if allocation fails (the stack is unchanged).
+ * 
+ * @note The stack grows according to its growth policy when the current capacity is exceeded.
+ */
+bool stack_push(stack_t *stack, void *obj);
+
+/**
+ * @brief Push several objects onto the stack, growing it at most once.
  * 
- * @note The stack will resize by a factor of 2 automatically if the current capacity is exceeded.
+ * @param stack Pointer to the stack.
+ * @param objs Objects to push, `objs[n - 1]` ends on top.
+ * @param n Number of objects.
+ * @return True if successful, false if allocation fails (nothing is pushed).
  */
-void stack_push(stack_t *stack, void *obj);
+bool stack_push_many(stack_t *stack, void *const *objs, size_t n);
 
 /**
  * @brief Pop the top object from the stack.
@@ -43,6 +114,14 @@ void stack_push(stack_t *stack, void *obj);
  */
 void *stack_pop(stack_t *stack);
 
+/**
+ * @brief Release the unused capacity of a stack.
+ * 
+ * @param stack Pointer to the stack.
+ * @return True if successful, false if allocation fails (the stack is unchanged).
+ */
+bool stack_shrink_to_fit(stack_t *stack);
+
 /**
  * @brief Free the stack and its allocated resources.
  * 
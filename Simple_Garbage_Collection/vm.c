@@ -1,14 +1,36 @@
+#include <string.h>
+#include <time.h>
+
 #include "vm.h"
+#include "buffer.h"
+#include "rope.h"
+#include "hashmap.h"
+#include "heap_profile.h"
+#include "event_ring.h"
+#include "recorder.h"
 
 static void vm_debug_init(vm_t *vm);
-static void vm_debug_track_free(vm_t *vm, void *ptr);
-static void vm_frame_push(vm_t *vm, frame_t *frame);
-static void object_free_tr(vm_t *vm, object_t *obj);
+static bool vm_debug_track_free(vm_t *vm, void *ptr, size_t size);
+static void vm_debug_release(vm_debug_t *debug);
+static bool vm_frame_push(vm_t *vm, frame_t *frame);
+static void frame_destroy(frame_t *frame);
+static size_t object_free_tr(vm_t *vm, object_t *obj);
 static void mark(vm_t *vm);
-static void trace_mark_object(stack_t *gray_objects, object_t *obj);
-static void trace_traverse_object(stack_t *gray_objects, object_t *obj);
+static void trace_mark_object(vm_t *vm, object_t *obj);
+static void trace_traverse_object(vm_t *vm, object_t *obj);
+static void trace_gray(vm_t *vm);
+static bool trace_ephemerons(vm_t *vm);
+static bool trace_overflow_rescan(vm_t *vm);
+static void trace_drain(vm_t *vm);
 static void trace(vm_t *vm);
+static void finalize(vm_t *vm);
+static void sweep_weak(vm_t *vm);
+static void sweep_space(vm_t *vm, stack_t *objects);
+static size_t space_find(stack_t *space, object_t *obj);
 static void sweep(vm_t *vm);
+static uint64_t clock_ns(void);
+static size_t pause_bucket(uint64_t ns);
+static void heap_update_peak(heap_stats_t *heap);
 
 /**
  * @brief Initialize the virtual machine's debug mode and associated structures.
@@ -17,15 +39,16 @@ static void sweep(vm_t *vm);
  */
 static void vm_debug_init(vm_t *vm)
 {
-    vm->debug = malloc(sizeof(vm_debug_t));
+    vm->debug = calloc(1, sizeof(vm_debug_t));
     if (vm->debug)
     {
         vm->debug->debug_mode = true;
-        vm->debug->total_allocations = 0;
-        vm->debug->total_frees = 0;
-        vm->debug->tracked_capacity = 64; // Initial capacity
-        vm->debug->tracked_count = 0;
-        vm->debug->tracked_pointers = calloc(vm->debug->tracked_capacity, sizeof(void *));
+        vm->debug->sample_rate = 1;
+        if (!vm_debug_configure(vm, VM_DEBUG_QUARANTINE, 1))
+        {
+            free(vm->debug);
+            vm->debug = NULL;
+        }
     }
 }
 
@@ -36,52 +59,132 @@ vm_t *vm_new(bool debug)
         return NULL;
 
     vm->frames = stack_new(8);
-    if (vm->frames == NULL)
+    vm->frame_pool = stack_new(8);
+    vm->handle_blocks = stack_new(8);
+    if (vm->frames == NULL || vm->frame_pool == NULL || vm->handle_blocks == NULL)
     {
+        stack_free(vm->frames);
+        stack_free(vm->frame_pool);
+        stack_free(vm->handle_blocks);
         free(vm);
         return NULL;
     }
+    vm->handles.block = 0;
+    vm->handles.used = 0;
+    vm->live_objects = 0;
+    vm->gray = (mark_stack_t){0};
+    vm->prefetch_marking = false;
+    memset(&vm->stats, 0, sizeof(vm->stats));
+    memset(&vm->heap, 0, sizeof(vm->heap));
     vm->objects = stack_new(8);
-    if (vm->objects == NULL)
+    vm->large_objects = stack_new(8);
+    if (vm->objects == NULL || vm->large_objects == NULL)
     {
+        stack_free(vm->objects);
+        stack_free(vm->large_objects);
         stack_free(vm->frames);
+        stack_free(vm->frame_pool);
+        stack_free(vm->handle_blocks);
+        free(vm);
+        return NULL;
+    }
+    vm->weak_refs = stack_new(8);
+    vm->ephemerons = stack_new(8);
+    vm->finalizers = stack_new(8);
+    vm->finalize_queue = stack_new(8);
+    if (vm->weak_refs == NULL || vm->ephemerons == NULL ||
+        vm->finalizers == NULL || vm->finalize_queue == NULL)
+    {
+        stack_free(vm->weak_refs);
+        stack_free(vm->ephemerons);
+        stack_free(vm->finalizers);
+        stack_free(vm->finalize_queue);
+        stack_free(vm->objects);
+        stack_free(vm->large_objects);
+        stack_free(vm->frames);
+        stack_free(vm->frame_pool);
+        stack_free(vm->handle_blocks);
         free(vm);
         return NULL;
     }
 
+    vm->debug = NULL;
     if (debug)
         vm_debug_init(vm);
 
     return vm;
 }
 
+/**
+ * @brief Free the quarantined pointers and empty the quarantine.
+ * 
+ * @param debug Debug information of the virtual machine.
+ */
+static void vm_debug_release(vm_debug_t *debug)
+{
+    for (size_t i = 0; i < debug->tracked_count; i++)
+    {
+        free(debug->tracked_pointers[(debug->tracked_head + i) % debug->tracked_capacity]);
+    }
+    ptrmap_free(&debug->tracked_index);
+    debug->tracked_count = 0;
+    debug->tracked_head = 0;
+}
+
+bool vm_debug_configure(vm_t *vm, size_t capacity, size_t sample_rate)
+{
+    if (vm == NULL || vm->debug == NULL || capacity == 0 || sample_rate == 0)
+        return false;
+
+    void **ring = malloc(capacity * sizeof(void *));
+    if (ring == NULL)
+        return false;
+
+    vm_debug_release(vm->debug);
+    free(vm->debug->tracked_pointers);
+    vm->debug->tracked_pointers = ring;
+    vm->debug->tracked_capacity = capacity;
+    vm->debug->sample_rate = sample_rate;
+    return true;
+}
+
 /**
  * @brief Internal function to track a freed pointer in debug mode.
  * 
  * @param vm Pointer to the virtual machine.
- * @param ptr Pointer to the memory that was freed.
+ * @param ptr Pointer to the memory being freed.
+ * @param size Size of the memory in bytes.
+ * @return True if the memory was poisoned and quarantined, false if the
+ *         caller must free it.
+ * 
+ * @note The oldest quarantined pointer is freed to make room when the ring is full.
  */
-static void vm_debug_track_free(vm_t *vm, void *ptr)
+static bool vm_debug_track_free(vm_t *vm, void *ptr, size_t size)
 {
-    if (vm->debug == NULL || !vm->debug->debug_mode)
-        return;
+    vm_debug_t *debug = vm->debug;
+    if (debug == NULL || !debug->debug_mode)
+        return false;
 
-    vm->debug->total_frees++;
+    if (debug->total_frees++ % debug->sample_rate != 0)
+        return false;
 
-    // Track the freed pointer
-    if (vm->debug->tracked_count >= vm->debug->tracked_capacity)
+    if (debug->tracked_count == debug->tracked_capacity)
     {
-        size_t new_capacity = vm->debug->tracked_capacity * 2;
-        void **new_array = realloc(vm->debug->tracked_pointers,
-                                   sizeof(void *) * new_capacity);
-        if (!new_array)
-            return;
-
-        vm->debug->tracked_pointers = new_array;
-        vm->debug->tracked_capacity = new_capacity;
+        void *oldest = debug->tracked_pointers[debug->tracked_head];
+        ptrmap_remove(&debug->tracked_index, oldest);
+        free(oldest);
+        debug->tracked_head = (debug->tracked_head + 1) % debug->tracked_capacity;
+        debug->tracked_count--;
     }
 
-    vm->debug->tracked_pointers[vm->debug->tracked_count++] = ptr;
+    if (!ptrmap_put(&debug->tracked_index, ptr, ptr))
+        return false;
+
+    // Reads through a dangling pointer now see garbage instead of a valid object
+    memset(ptr, 0xdb, size);
+    debug->tracked_pointers[(debug->tracked_head + debug->tracked_count) % debug->tracked_capacity] = ptr;
+    debug->tracked_count++;
+    return true;
 }
 
 bool vm_debug_was_freed(vm_t *vm, void *ptr)
@@ -89,14 +192,7 @@ bool vm_debug_was_freed(vm_t *vm, void *ptr)
     if (vm->debug == NULL || !vm->debug->debug_mode)
         return false;
 
-    for (size_t i = 0; i < vm->debug->tracked_count; i++)
-    {
-        if (vm->debug->tracked_pointers[i] == ptr)
-        {
-            return true;
-        }
-    }
-    return false;
+    return ptrmap_contains(&vm->debug->tracked_index, ptr);
 }
 
 /**
@@ -108,6 +204,7 @@ static void vm_debug_cleanup(vm_t *vm)
 {
     if (vm->debug)
     {
+        vm_debug_release(vm->debug);
         free(vm->debug->tracked_pointers);
         free(vm->debug);
     }
@@ -115,29 +212,232 @@ static void vm_debug_cleanup(vm_t *vm)
 
 void vm_free(vm_t *vm)
 {
-    vm_debug_cleanup(vm);
+    // Release external resources before the objects themselves
+    if (stack_push_many(vm->finalize_queue, vm->finalizers->data, vm->finalizers->count))
+    {
+        vm->finalizers->count = 0;
+    }
+    vm_run_finalizers(vm);
+    while (vm->finalizers->count > 0)
+    {
+        finalizer_entry_t *entry = stack_pop(vm->finalizers);
+        entry->fn(entry->obj, entry->context);
+        free(entry);
+    }
+    stack_free(vm->finalizers);
+    stack_free(vm->finalize_queue);
 
     for (int i = 0; i < vm->frames->count; i++)
     {
-        frame_free(vm->frames->data[i]);
+        frame_destroy(vm->frames->data[i]);
     }
     stack_free(vm->frames);
 
+    for (size_t i = 0; i < vm->frame_pool->count; i++)
+    {
+        frame_destroy(vm->frame_pool->data[i]);
+    }
+    stack_free(vm->frame_pool);
+
+    for (size_t i = 0; i < vm->handle_blocks->count; i++)
+    {
+        free(vm->handle_blocks->data[i]);
+    }
+    stack_free(vm->handle_blocks);
+
     for (int i = 0; i < vm->objects->count; i++)
     {
         object_free_tr(vm, vm->objects->data[i]);
     }
     stack_free(vm->objects);
+
+    for (size_t i = 0; i < vm->large_objects->count; i++)
+    {
+        object_free_tr(vm, vm->large_objects->data[i]);
+    }
+    stack_free(vm->large_objects);
+    stack_free(vm->weak_refs);
+    stack_free(vm->ephemerons);
+    mark_stack_free(&vm->gray);
+
+    // Last, objects freed above are still reported to the debug tracker
+    vm_debug_cleanup(vm);
     free(vm);
 }
 
-void vm_track_object(vm_t *vm, object_t *obj)
+bool vm_track_object(vm_t *vm, object_t *obj)
 {
     if (vm == NULL || obj == NULL)
     {
-        return;
+        return false;
+    }
+    if (!stack_push(vm->objects, obj))
+    {
+        return false;
     }
-    stack_push(vm->objects, obj);
+
+    vm->stats.objects_allocated++;
+    if (vm->debug != NULL)
+        vm->debug->total_allocations++;
+    return true;
+}
+
+bool vm_track_large_object(vm_t *vm, object_t *obj)
+{
+    if (vm == NULL || obj == NULL)
+    {
+        return false;
+    }
+    if (!stack_push(vm->large_objects, obj))
+    {
+        return false;
+    }
+
+    vm->stats.objects_allocated++;
+    if (vm->debug != NULL)
+        vm->debug->total_allocations++;
+    return true;
+}
+
+/**
+ * @brief Find an object in an object space.
+ * 
+ * @param space `vm->objects` or `vm->large_objects`.
+ * @param obj Object to find.
+ * @return Index of the object plus one, or 0 if it is not in the space.
+ * 
+ * @note Searches from the top, where recent allocations are.
+ */
+static size_t space_find(stack_t *space, object_t *obj)
+{
+    size_t i = space->count;
+    while (i > 0 && space->data[i - 1] != obj)
+    {
+        i--;
+    }
+    return i;
+}
+
+bool vm_move_object_space(vm_t *vm, object_t *obj, bool large)
+{
+    if (vm == NULL || obj == NULL)
+    {
+        return false;
+    }
+    stack_t *from = large ? vm->objects : vm->large_objects;
+    stack_t *to = large ? vm->large_objects : vm->objects;
+
+    // The object being resized is usually a recent allocation
+    size_t i = space_find(from, obj);
+    if (i == 0)
+    {
+        return false;
+    }
+    if (!stack_push(to, obj))
+    {
+        return false;
+    }
+    from->data[i - 1] = from->data[--from->count];
+    return true;
+}
+
+bool vm_untrack_object(vm_t *vm, object_t *obj)
+{
+    if (vm == NULL || obj == NULL)
+    {
+        return false;
+    }
+    stack_t *space = vm->objects;
+    size_t i = space_find(space, obj);
+    if (i == 0)
+    {
+        space = vm->large_objects;
+        i = space_find(space, obj);
+    }
+    if (i == 0)
+    {
+        return false;
+    }
+    space->data[i - 1] = space->data[--space->count];
+
+    vm->stats.objects_allocated--;
+    if (vm->debug != NULL)
+        vm->debug->total_allocations--;
+    return true;
+}
+
+bool vm_track_weak(vm_t *vm, object_t *obj)
+{
+    if (vm == NULL || obj == NULL)
+    {
+        return false;
+    }
+    return stack_push(obj->kind == WEAK ? vm->weak_refs : vm->ephemerons, obj);
+}
+
+bool vm_set_finalizer(vm_t *vm, object_t *obj, finalizer_t fn, void *context)
+{
+    if (vm == NULL || obj == NULL)
+        return false;
+
+    finalizer_entry_t *entry = NULL;
+    if (obj->flags & OBJECT_FLAG_FINALIZABLE)
+    {
+        for (size_t i = 0; i < vm->finalizers->count; i++)
+        {
+            finalizer_entry_t *candidate = vm->finalizers->data[i];
+            if (candidate->obj == obj)
+            {
+                entry = candidate;
+                if (fn == NULL)
+                {
+                    vm->finalizers->data[i] = vm->finalizers->data[--vm->finalizers->count];
+                    obj->flags &= ~OBJECT_FLAG_FINALIZABLE;
+                    free(entry);
+                    return true;
+                }
+                break;
+            }
+        }
+    }
+    if (fn == NULL)
+        return true;
+
+    if (entry == NULL)
+    {
+        entry = malloc(sizeof(finalizer_entry_t));
+        if (entry == NULL)
+            return false;
+
+        entry->obj = obj;
+        if (!stack_push(vm->finalizers, entry))
+        {
+            free(entry);
+            return false;
+        }
+    }
+
+    entry->fn = fn;
+    entry->context = context;
+    obj->flags |= OBJECT_FLAG_FINALIZABLE;
+    return true;
+}
+
+size_t vm_run_finalizers(vm_t *vm)
+{
+    if (vm == NULL)
+        return 0;
+
+    size_t count = 0;
+    while (vm->finalize_queue->count > 0)
+    {
+        // Once popped, the object is collectable again unless the finalizer keeps it
+        finalizer_entry_t *entry = stack_pop(vm->finalize_queue);
+        entry->fn(entry->obj, entry->context);
+        free(entry);
+        count++;
+    }
+    return count;
 }
 
 /**
@@ -145,15 +445,22 @@ void vm_track_object(vm_t *vm, object_t *obj)
  * 
  * @param vm Pointer to the virtual machine.
  * @param frame Frame to be pushed onto the VM's stack.
+ * @return True if successful, false if allocation fails.
  */
-static void vm_frame_push(vm_t *vm, frame_t *frame)
+static bool vm_frame_push(vm_t *vm, frame_t *frame)
 {
     if (frame == NULL || vm == NULL)
     {
-        return;
+        return false;
     }
 
-    stack_push(vm->frames, frame);
+    if (!stack_push(vm->frames, frame))
+    {
+        return false;
+    }
+    event_begin("vm", "frame");
+    recorder_frame(REC_FRAME_PUSH);
+    return true;
 }
 
 frame_t *vm_frame_pop(vm_t *vm)
@@ -163,12 +470,30 @@ frame_t *vm_frame_pop(vm_t *vm)
         return NULL;
     }
 
-    return stack_pop(vm->frames);
+    frame_t *frame = stack_pop(vm->frames);
+    if (frame != NULL)
+    {
+        event_end("vm", "frame");
+        recorder_frame(REC_FRAME_POP);
+    }
+    return frame;
 }
 
 frame_t *vm_new_frame(vm_t *vm)
 {
-    frame_t *frame = malloc(sizeof(frame_t));
+    frame_t *frame = stack_pop(vm->frame_pool);
+    if (frame != NULL)
+    {
+        frame->handles = vm->handles;
+        if (!vm_frame_push(vm, frame))
+        {
+            frame_destroy(frame);
+            return NULL;
+        }
+        return frame;
+    }
+
+    frame = malloc(sizeof(frame_t));
     if (frame == NULL)
     {
         return NULL;
@@ -180,70 +505,184 @@ frame_t *vm_new_frame(vm_t *vm)
         free(frame);
         return NULL;
     }
+    frame->vm = vm;
+    frame->handles = vm->handles;
 
-    vm_frame_push(vm, frame);
+    if (!vm_frame_push(vm, frame))
+    {
+        frame_destroy(frame);
+        return NULL;
+    }
     return frame;
 }
 
-void frame_free(frame_t *frame)
+/**
+ * @brief Release the memory of a frame and its reference stack.
+ * 
+ * @param frame Pointer to the frame to destroy.
+ */
+static void frame_destroy(frame_t *frame)
 {
     stack_free(frame->reference);
     free(frame);
 }
 
+void frame_free(frame_t *frame)
+{
+    if (frame == NULL)
+        return;
+
+    // Drop the roots but keep the capacity for the next call
+    frame->reference->count = 0;
+    frame->vm->handles = frame->handles;
+    recorder_handle_scope(frame->vm);
+    if (!stack_push(frame->vm->frame_pool, frame))
+    {
+        frame_destroy(frame);
+    }
+}
+
+void vm_handle_scope_open(vm_t *vm, handle_scope_t *scope)
+{
+    *scope = vm->handles;
+}
+
+void vm_handle_scope_close(vm_t *vm, const handle_scope_t *scope)
+{
+    vm->handles = *scope;
+    recorder_handle_scope(vm);
+}
+
+object_t **vm_handle(vm_t *vm, object_t *obj)
+{
+    if (vm->handles.used == HANDLE_BLOCK_SLOTS)
+    {
+        vm->handles.block++;
+        vm->handles.used = 0;
+    }
+
+    if (vm->handles.block == vm->handle_blocks->count)
+    {
+        object_t **block = malloc(HANDLE_BLOCK_SLOTS * sizeof(object_t *));
+        if (block == NULL)
+        {
+            // Keep the position valid for the enclosing scopes
+            if (vm->handles.block > 0)
+            {
+                vm->handles.block--;
+                vm->handles.used = HANDLE_BLOCK_SLOTS;
+            }
+            return NULL;
+        }
+        if (!stack_push(vm->handle_blocks, block))
+        {
+            free(block);
+            if (vm->handles.block > 0)
+            {
+                vm->handles.block--;
+                vm->handles.used = HANDLE_BLOCK_SLOTS;
+            }
+            return NULL;
+        }
+    }
+
+    object_t **slot = (object_t **)vm->handle_blocks->data[vm->handles.block] + vm->handles.used++;
+    *slot = obj;
+    recorder_handle(vm, slot);
+    return slot;
+}
+
+void handle_clear(object_t **handle)
+{
+    if (handle != NULL)
+    {
+        recorder_handle_clear(handle);
+        *handle = NULL;
+    }
+}
+
 /**
  * @brief Frees an object and its contained resources, with tracking in debug mode.
  * 
  * @param vm Pointer to the virtual machine, used for tracking freed objects in debug mode.
  * @param obj Pointer to the object to free.
  * 
+ * @return Number of bytes freed: the object, and the payload it did not share.
+ * 
  * @note This function traverses the object's contents based on its type, 
  *       freeing any dynamically allocated resources it contains. 
  *       The function is used internally for controlled memory deallocation.
  *       However, it doesn't free the `object_t` in the objects.
  */
-static void object_free_tr(vm_t *vm, object_t *obj)
+static size_t object_free_tr(vm_t *vm, object_t *obj)
 {
     if (obj == NULL)
-        return;
+        return 0;
 
+    size_t bytes = object_size(obj);
     switch (obj->kind)
     {
     case INTEGER:
     case FLOAT:
+    case VECTOR3I:
+    case VECTOR3F:
         break;
 
     case STRING:
-        // Free the dynamically allocated string,
-        free(obj->data.v_string);
+        // Drop this object's share of the string buffer
+        buffer_release(obj->data.v_string.chars);
+        rope_release(obj->data.v_string.rope);
         break;
 
     case VECTOR3:
         break;
 
     case ARRAY:
-        if (obj->data.v_array.elements != NULL)
-        {
-            free(obj->data.v_array.elements);
-        }
+        buffer_release(obj->data.v_array.elements);
+        break;
+
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+        // Values are allocated inline with the object
+        break;
+
+    case MAP:
+        hashmap_free(&obj->data.v_map);
         break;
 
     default:
         break;
     }
 
-    vm_debug_track_free(vm, obj);
-    free(obj);
+    heap_kind_stats_t *kind = &vm->heap.kinds[obj->kind];
+    kind->objects--;
+    kind->bytes -= bytes;
+    kind->payload_bytes -= bytes - sizeof(object_t);
+    vm->heap.objects--;
+    vm->heap.bytes -= bytes;
+
+    if (obj->flags & OBJECT_FLAG_SAMPLED)
+    {
+        heap_profile_release(obj);
+    }
+    if (!vm_debug_track_free(vm, obj, sizeof(object_t)))
+        free(obj);
+    return bytes;
 }
 
-void frame_reference_object(frame_t *frame, object_t *obj)
+bool frame_reference_object(frame_t *frame, object_t *obj)
 {
     if (frame == NULL || obj == NULL)
     {
-        return;
+        return false;
     }
 
-    stack_push(frame->reference, obj);
+    if (!stack_push(frame->reference, obj))
+    {
+        return false;
+    }
+    recorder_frame_reference(frame, obj);
+    return true;
 }
 
 /**
@@ -264,30 +703,63 @@ static void mark(vm_t *vm)
             obj->is_marked = true;
         }
     }
+
+    // Handles in use are dense arrays, all blocks before the current one are full
+    for (size_t b = 0; b <= vm->handles.block && b < vm->handle_blocks->count; b++)
+    {
+        object_t **slots = vm->handle_blocks->data[b];
+        size_t used = b == vm->handles.block ? vm->handles.used : HANDLE_BLOCK_SLOTS;
+        for (size_t i = 0; i < used; i++)
+        {
+            if (slots[i] != NULL)
+            {
+                slots[i]->is_marked = true;
+            }
+        }
+    }
+
+    // Objects waiting for their finalizer are roots until it has run
+    for (size_t i = 0; i < vm->finalize_queue->count; i++)
+    {
+        finalizer_entry_t *entry = vm->finalize_queue->data[i];
+        entry->obj->is_marked = true;
+    }
 }
 
 /**
  * @brief Trace and mark an object during garbage collection.
  * 
- * @param gray_objects Stack of marked objects to trace further references.
+ * @param vm Pointer to the virtual machine, whose gray stack receives the object.
  * @param obj Object to be marked.
+ * 
+ * @note If the stack cannot grow the object stays marked but untraced, and
+ *       `trace_overflow_rescan` picks it up later.
  */
-static void trace_mark_object(stack_t *gray_objects, object_t *obj)
+static void trace_mark_object(vm_t *vm, object_t *obj)
 {
     if (obj == NULL || obj->is_marked)
         return;
 
     obj->is_marked = true;
-    stack_push(gray_objects, obj); // Allows for travesal of object
+    mark_stack_push(&vm->gray, obj); // Allows for travesal of object
+
+    if (vm->prefetch_marking)
+    {
+        // The header is in cache now, start loading the payload traversed later
+        if (obj->kind == ARRAY)
+            __builtin_prefetch(obj->data.v_array.elements);
+        else if (obj->kind == MAP)
+            __builtin_prefetch(obj->data.v_map.entries);
+    }
 }
 
 /**
  * @brief Traverese trace references within a marked object.
  * 
- * @param gray_objects Stack of marked objects to trace further references.
+ * @param vm Pointer to the virtual machine.
  * @param obj Object to check.
  */
-static void trace_traverse_object(stack_t *gray_objects, object_t *obj)
+static void trace_traverse_object(vm_t *vm, object_t *obj)
 {
     if (obj == NULL)
         return;
@@ -297,19 +769,44 @@ static void trace_traverse_object(stack_t *gray_objects, object_t *obj)
     case INTEGER:
     case FLOAT:
     case STRING:
-        /* code */
+    case INT_ARRAY:
+    case FLOAT_ARRAY:
+    case VECTOR3I:
+    case VECTOR3F:
+    case WEAK:
+        // No outgoing (strong) references
         break;
 
     case VECTOR3:
-        trace_mark_object(gray_objects, obj->data.v_vector3.x);
-        trace_mark_object(gray_objects, obj->data.v_vector3.y);
-        trace_mark_object(gray_objects, obj->data.v_vector3.z);
+        trace_mark_object(vm, obj->data.v_vector3.x);
+        trace_mark_object(vm, obj->data.v_vector3.y);
+        trace_mark_object(vm, obj->data.v_vector3.z);
         break;
 
     case ARRAY:
+        // Only the live length, slots past `size` are spare capacity
         for (size_t i = 0; i < obj->data.v_array.size; i++)
         {
-            trace_mark_object(gray_objects, obj->data.v_array.elements[i]);
+            trace_mark_object(vm, obj->data.v_array.elements[i]);
+        }
+        break;
+
+    case MAP:
+        for (size_t i = 0; i < obj->data.v_map.capacity; i++)
+        {
+            map_entry_t *entry = &obj->data.v_map.entries[i];
+            if (entry->key == NULL)
+                continue;
+
+            // An ephemeron value is reachable only through a reachable key
+            if (!obj->data.v_map.weak_keys)
+            {
+                trace_mark_object(vm, entry->key);
+            }
+            if (!obj->data.v_map.weak_keys || entry->key->is_marked)
+            {
+                trace_mark_object(vm, entry->value);
+            }
         }
         break;
 
@@ -318,6 +815,125 @@ static void trace_traverse_object(stack_t *gray_objects, object_t *obj)
     }
 }
 
+/**
+ * @brief Mark the values of ephemeron entries whose keys were marked after the map was traversed.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @return True if any value was marked, in which case tracing must continue.
+ */
+static bool trace_ephemerons(vm_t *vm)
+{
+    for (size_t i = 0; i < vm->ephemerons->count; i++)
+    {
+        object_t *obj = vm->ephemerons->data[i];
+        if (!obj->is_marked)
+            continue;
+
+        for (size_t j = 0; j < obj->data.v_map.capacity; j++)
+        {
+            map_entry_t *entry = &obj->data.v_map.entries[j];
+            if (entry->key != NULL && entry->key->is_marked)
+            {
+                trace_mark_object(vm, entry->value);
+            }
+        }
+    }
+    return !mark_stack_is_empty(&vm->gray) || vm->gray.overflowed;
+}
+
+/**
+ * @brief Recover from a mark stack overflow by re-traversing every marked object.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @return True if the stack had overflowed, in which case tracing must continue.
+ * 
+ * @note Objects whose push failed are marked but untraced; traversing all
+ *       marked objects again reaches their references. Already traced objects
+ *       only find marked references, so each pass makes progress.
+ */
+static bool trace_overflow_rescan(vm_t *vm)
+{
+    if (!vm->gray.overflowed)
+        return false;
+
+    vm->gray.overflowed = false;
+    stack_t *spaces[] = {vm->objects, vm->large_objects};
+    for (size_t s = 0; s < sizeof(spaces) / sizeof(spaces[0]); s++)
+    {
+        for (size_t i = 0; i < spaces[s]->count; i++)
+        {
+            object_t *obj = spaces[s]->data[i];
+            if (!obj->is_marked)
+                continue;
+
+            trace_traverse_object(vm, obj);
+            trace_gray(vm);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Pop and traverse objects until the gray stack is empty.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * 
+ * @note With `prefetch_marking`, popped objects are prefetched and wait in a
+ *       FIFO of TRACE_PREFETCH_DISTANCE entries before being traversed, so the
+ *       cache miss on each object overlaps with the work on the previous ones.
+ */
+static void trace_gray(vm_t *vm)
+{
+    if (!vm->prefetch_marking)
+    {
+        while (!mark_stack_is_empty(&vm->gray))
+        {
+            trace_traverse_object(vm, mark_stack_pop(&vm->gray));
+        }
+        return;
+    }
+
+    object_t *fifo[TRACE_PREFETCH_DISTANCE];
+    size_t head = 0;
+    size_t count = 0;
+    while (count > 0 || !mark_stack_is_empty(&vm->gray))
+    {
+        object_t *next = mark_stack_pop(&vm->gray);
+        if (next != NULL)
+        {
+            __builtin_prefetch(next);
+            fifo[(head + count) % TRACE_PREFETCH_DISTANCE] = next;
+            count++;
+
+            // Keep filling until the oldest entry has had time to arrive
+            if (count < TRACE_PREFETCH_DISTANCE)
+                continue;
+        }
+
+        object_t *obj = fifo[head];
+        head = (head + 1) % TRACE_PREFETCH_DISTANCE;
+        count--;
+        trace_traverse_object(vm, obj);
+    }
+}
+
+/**
+ * @brief Traverse gray objects until none are left.
+ * 
+ * @param vm Pointer to the virtual machine.
+ */
+static void trace_drain(vm_t *vm)
+{
+    // Repeat until no overflow is pending and no ephemeron gains a live key
+    do
+    {
+        do
+        {
+            trace_gray(vm);
+        } while (trace_overflow_rescan(vm));
+    } while (trace_ephemerons(vm));
+}
+
 /**
  * @brief Trace all reachable/active objects in the virtual machine.
  * 
@@ -327,64 +943,306 @@ static void trace_traverse_object(stack_t *gray_objects, object_t *obj)
  */
 static void trace(vm_t *vm)
 {
-    stack_t *gray_objects = stack_new(8);
-    if (gray_objects == NULL)
+    stack_t *spaces[] = {vm->objects, vm->large_objects};
+    for (size_t s = 0; s < sizeof(spaces) / sizeof(spaces[0]); s++)
+    {
+        for (size_t i = 0; i < spaces[s]->count; i++)
+        {
+            object_t *obj = spaces[s]->data[i];
+
+            if (obj->is_marked)
+            {
+                mark_stack_push(&vm->gray, obj);
+            }
+        }
+    }
+    trace_drain(vm);
+}
+
+/**
+ * @brief Queue the finalizers of unmarked objects and resurrect those objects.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * 
+ * @note Runs between `trace` and `sweep`; everything reachable from a queued
+ *       object is marked too, so the finalizer sees an intact object graph.
+ */
+static void finalize(vm_t *vm)
+{
+    if (vm->finalizers->count == 0)
         return;
 
-    for (size_t i = 0; i < vm->objects->count; i++)
+    size_t write = 0;
+    for (size_t read = 0; read < vm->finalizers->count; read++)
     {
-        object_t *obj = vm->objects->data[i];
+        finalizer_entry_t *entry = vm->finalizers->data[read];
+        if (entry->obj->is_marked)
+        {
+            vm->finalizers->data[write++] = entry;
+            continue;
+        }
 
-        if (obj->is_marked)
+        // Resurrected either way, a finalizer that cannot be queued waits for the next collection
+        entry->obj->is_marked = true;
+        mark_stack_push(&vm->gray, entry->obj);
+        if (!stack_push(vm->finalize_queue, entry))
         {
-            stack_push(gray_objects, obj);
+            vm->finalizers->data[write++] = entry;
+            continue;
         }
+        entry->obj->flags &= ~OBJECT_FLAG_FINALIZABLE;
     }
-    while (gray_objects->count > 0)
+    vm->finalizers->count = write;
+
+    trace_drain(vm);
+}
+
+/**
+ * @brief Clear weak references to unmarked objects, before they are freed.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * 
+ * @note Unmarked WEAK objects and ephemeron maps are dropped from the registries.
+ */
+static void sweep_weak(vm_t *vm)
+{
+    size_t write = 0;
+    for (size_t read = 0; read < vm->weak_refs->count; read++)
     {
-        trace_traverse_object(gray_objects, stack_pop(gray_objects));
+        object_t *weak = vm->weak_refs->data[read];
+        if (!weak->is_marked)
+            continue;
+
+        if (weak->data.v_weak != NULL && !weak->data.v_weak->is_marked)
+        {
+            weak->data.v_weak = NULL;
+        }
+        vm->weak_refs->data[write++] = weak;
     }
+    vm->weak_refs->count = write;
+
+    write = 0;
+    for (size_t read = 0; read < vm->ephemerons->count; read++)
+    {
+        object_t *obj = vm->ephemerons->data[read];
+        if (!obj->is_marked)
+            continue;
 
-    stack_free(gray_objects);
+        map_t *map = &obj->data.v_map;
+        for (size_t i = 0; i < map->capacity;)
+        {
+            // Removal shifts a later entry into slot `i`, so only advance past live ones
+            if (map->entries[i].key != NULL && !map->entries[i].key->is_marked)
+            {
+                hashmap_remove_slot(map, i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+        vm->ephemerons->data[write++] = obj;
+    }
+    vm->ephemerons->count = write;
 }
 
 /**
- * @brief Sweep and free unmarked objects in the virtual machine.
+ * @brief Free the unmarked objects of one object list and compact it.
  * 
  * @param vm Pointer to the virtual machine.
+ * @param objects `vm->objects` or `vm->large_objects`.
  */
-static void sweep(vm_t *vm)
+static void sweep_space(vm_t *vm, stack_t *objects)
 {
     size_t write = 0; // Write position for compaction
 
-    for (size_t read = 0; read < vm->objects->count; read++)
+    for (size_t read = 0; read < objects->count; read++)
     {
-        object_t *obj = vm->objects->data[read];
+        object_t *obj = objects->data[read];
         if (obj->is_marked)
         {
             obj->is_marked = false; //Reset mark for next GC cycle.
             if(write != read)
             {
-                vm->objects->data[write] = obj;
+                objects->data[write] = obj;
             }
             write++;
         }
         else
         {
-            object_free_tr(vm, obj);
-            vm->objects->data[read] = NULL;
+            vm->stats.last.bytes_reclaimed += object_free_tr(vm, obj);
+            vm->stats.last.objects_reclaimed++;
+            objects->data[read] = NULL;
         }
 
     }
     // Update stack count to new size after compaction
-    vm->objects->count = write;
+    objects->count = write;
+}
+
+/**
+ * @brief Sweep and free unmarked objects in the virtual machine.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * 
+ * @note Large objects are swept from their own list; their mapped payloads
+ *       are unmapped as soon as they are freed.
+ */
+static void sweep(vm_t *vm)
+{
+    sweep_weak(vm);
+    sweep_space(vm, vm->objects);
+    sweep_space(vm, vm->large_objects);
+    vm->live_objects = vm->objects->count + vm->large_objects->count;
+
+    // Keep enough chunks to trace a heap of this size without allocating
+    mark_stack_trim(&vm->gray, vm->live_objects / MARK_STACK_CHUNK_SLOTS + 1);
+}
 
-    // TODO: Compact object stack;
+/**
+ * @brief Read a monotonic clock.
+ * 
+ * @return Current time in nanoseconds.
+ */
+static uint64_t clock_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Find the pause histogram bucket of a duration.
+ * 
+ * @param ns Duration in nanoseconds.
+ * @return Index of the bucket, `floor(log2(ns))` capped to the last bucket.
+ */
+static size_t pause_bucket(uint64_t ns)
+{
+    if (ns == 0)
+        return 0;
+
+    size_t bucket = 63 - (size_t)__builtin_clzll(ns);
+    return bucket < GC_PAUSE_BUCKETS ? bucket : GC_PAUSE_BUCKETS - 1;
 }
 
 void vm_collect_garbage(vm_t *vm)
 {
+    gc_stats_t *stats = &vm->stats;
+    memset(&stats->last, 0, sizeof(stats->last));
+    recorder_collect();
+
+    event_begin("gc", "collect");
+    uint64_t start = clock_ns();
+    event_begin("gc", "mark");
     mark(vm);
+    event_end("gc", "mark");
+    uint64_t marked = clock_ns();
+    event_begin("gc", "trace");
     trace(vm);
+    event_end("gc", "trace");
+    event_begin("gc", "finalize");
+    finalize(vm);
+    event_end("gc", "finalize");
+    uint64_t traced = clock_ns();
+    event_begin("gc", "sweep");
     sweep(vm);
+    event_end("gc", "sweep");
+    uint64_t end = clock_ns();
+    event_end("gc", "collect");
+
+    stats->last.mark_ns = marked - start;
+    stats->last.trace_ns = traced - marked;
+    stats->last.sweep_ns = end - traced;
+    stats->last.pause_ns = end - start;
+
+    stats->collections++;
+    stats->total.mark_ns += stats->last.mark_ns;
+    stats->total.trace_ns += stats->last.trace_ns;
+    stats->total.sweep_ns += stats->last.sweep_ns;
+    stats->total.pause_ns += stats->last.pause_ns;
+    stats->total.objects_reclaimed += stats->last.objects_reclaimed;
+    stats->total.bytes_reclaimed += stats->last.bytes_reclaimed;
+    if (stats->last.pause_ns > stats->max_pause_ns)
+        stats->max_pause_ns = stats->last.pause_ns;
+    stats->pause_histogram[pause_bucket(stats->last.pause_ns)]++;
+}
+
+const gc_stats_t *vm_gc_stats(const vm_t *vm)
+{
+    return vm == NULL ? NULL : &vm->stats;
+}
+
+void vm_gc_stats_reset(vm_t *vm)
+{
+    if (vm != NULL)
+        memset(&vm->stats, 0, sizeof(vm->stats));
+}
+
+/**
+ * @brief Raise the peaks of the live heap statistics to the current values.
+ * 
+ * @param heap Live heap statistics.
+ */
+static void heap_update_peak(heap_stats_t *heap)
+{
+    if (heap->objects > heap->peak_objects)
+        heap->peak_objects = heap->objects;
+    if (heap->bytes > heap->peak_bytes)
+        heap->peak_bytes = heap->bytes;
+}
+
+void vm_heap_account(vm_t *vm, object_t *obj)
+{
+    size_t bytes = object_size(obj);
+    heap_kind_stats_t *kind = &vm->heap.kinds[obj->kind];
+    kind->objects++;
+    kind->bytes += bytes;
+    kind->payload_bytes += bytes - sizeof(object_t);
+    vm->heap.objects++;
+    vm->heap.bytes += bytes;
+    heap_update_peak(&vm->heap);
+}
+
+void vm_heap_resize(vm_t *vm, object_t *obj, size_t old_size)
+{
+    size_t bytes = object_size(obj);
+    heap_kind_stats_t *kind = &vm->heap.kinds[obj->kind];
+    kind->bytes = kind->bytes - old_size + bytes;
+    kind->payload_bytes = kind->payload_bytes - old_size + bytes;
+    vm->heap.bytes = vm->heap.bytes - old_size + bytes;
+    heap_update_peak(&vm->heap);
+}
+
+const heap_stats_t *vm_heap_stats(const vm_t *vm)
+{
+    return vm == NULL ? NULL : &vm->heap;
+}
+
+void vm_heap_stats_reset_peak(vm_t *vm)
+{
+    if (vm != NULL)
+    {
+        vm->heap.peak_objects = vm->heap.objects;
+        vm->heap.peak_bytes = vm->heap.bytes;
+    }
+}
+
+uint64_t gc_stats_pause_percentile(const gc_stats_t *stats, double percentile)
+{
+    if (stats == NULL || stats->collections == 0)
+        return 0;
+
+    // Rank of the pause, counted from 1, that the percentile falls on
+    double rank = percentile / 100.0 * (double)stats->collections;
+    size_t seen = 0;
+    for (size_t i = 0; i < GC_PAUSE_BUCKETS; i++)
+    {
+        seen += stats->pause_histogram[i];
+        if (seen > 0 && (double)seen >= rank)
+        {
+            return i == GC_PAUSE_BUCKETS - 1 ? stats->max_pause_ns : (2ULL << i) - 1;
+        }
+    }
+    return stats->max_pause_ns;
 }
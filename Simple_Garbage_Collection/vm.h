@@ -1,21 +1,123 @@
 #pragma once
+#include <stdint.h>
 #include "stack.h"
 #include "object.h"
+#include "mark_stack.h"
+#include "ptrmap.h"
+
+/**
+ * @brief Number of root slots in each block of handles.
+ */
+#define HANDLE_BLOCK_SLOTS 256
+
+/**
+ * @brief Number of popped gray objects waiting in the prefetch FIFO before being traversed.
+ */
+#define TRACE_PREFETCH_DISTANCE 8
+
+/**
+ * @brief Default number of freed objects kept in quarantine in debug mode.
+ */
+#define VM_DEBUG_QUARANTINE 4096
+
+/**
+ * @brief Number of buckets in the pause histogram.
+ * 
+ * Bucket `i` counts pauses of [2^i, 2^(i+1)) nanoseconds; the last one also
+ * counts every longer pause (2^31 ns is about 2 seconds).
+ */
+#define GC_PAUSE_BUCKETS 32
+
+/**
+ * @struct HandleScope
+ * @brief Position of the next free handle slot, saved by a scope to be restored on close.
+ */
+typedef struct HandleScope {
+    size_t block;          /**< Index of the block holding the next free slot */
+    size_t used;           /**< Number of slots in use in that block */
+} handle_scope_t;
+
+/**
+ * @struct GcCycleStats
+ * @brief Cost and yield of garbage collection, for one cycle or summed over all of them.
+ */
+typedef struct GcCycleStats {
+    uint64_t mark_ns;          /**< Time spent marking the roots */
+    uint64_t trace_ns;         /**< Time spent tracing, finalizer resurrection included */
+    uint64_t sweep_ns;         /**< Time spent sweeping */
+    uint64_t pause_ns;         /**< Time spent in `vm_collect_garbage` */
+    size_t objects_reclaimed;  /**< Objects freed */
+    size_t bytes_reclaimed;    /**< Bytes freed: objects, and the payloads they did not share */
+} gc_cycle_stats_t;
+
+/**
+ * @struct GcStats
+ * @brief Garbage collection statistics, kept whether or not debug mode is enabled.
+ * 
+ * Keeping them up to date costs a few clock reads per collection and one
+ * increment per allocation.
+ */
+typedef struct GcStats {
+    size_t collections;        /**< Number of collections */
+    size_t objects_allocated;  /**< Number of objects tracked by the VM */
+    gc_cycle_stats_t last;     /**< Last collection */
+    gc_cycle_stats_t total;    /**< Sum over all collections */
+    uint64_t max_pause_ns;     /**< Longest pause */
+    size_t pause_histogram[GC_PAUSE_BUCKETS]; /**< Pauses, bucketed by their base 2 logarithm */
+} gc_stats_t;
+
+/**
+ * @brief Number of object kinds counted by the live heap statistics.
+ */
+#define HEAP_STATS_KINDS (WEAK + 1)
+
+/**
+ * @struct HeapKindStats
+ * @brief Live objects of one kind.
+ */
+typedef struct HeapKindStats {
+    size_t objects;            /**< Live objects */
+    size_t bytes;              /**< Their `object_size`: headers and payloads */
+    size_t payload_bytes;      /**< Part of `bytes` outside the `object_t` headers */
+} heap_kind_stats_t;
+
+/**
+ * @struct HeapStats
+ * @brief Live heap of a virtual machine, maintained on allocation, resize and reclamation.
+ * 
+ * Reading it never walks the heap: counters move by one object, or one
+ * resize, at a time.
+ */
+typedef struct HeapStats {
+    heap_kind_stats_t kinds[HEAP_STATS_KINDS]; /**< Live objects by `object_kind_t` */
+    size_t objects;            /**< Live objects of every kind */
+    size_t bytes;              /**< Live bytes of every kind */
+    size_t peak_objects;       /**< Highest `objects` since creation or `vm_heap_stats_reset_peak` */
+    size_t peak_bytes;         /**< Highest `bytes` since creation or `vm_heap_stats_reset_peak` */
+} heap_stats_t;
 
 /**
  * @struct vm_debug_t
  * @brief Structure to store debug information for the virtual machine.
  * 
- * This structure contains debugging flags, counters, and a list of freed pointers
- * for tracking memory management in debug mode.
+ * This structure contains debugging flags, counters, and the quarantine of freed
+ * pointers for tracking memory management in debug mode.
+ * 
+ * The most recently freed objects are poisoned and kept allocated in a ring
+ * instead of being returned to malloc, so their addresses cannot be reused
+ * while they are checked. Memory and the cost of each check stay fixed however
+ * long the VM runs.
  */
 typedef struct {
     bool debug_mode;           /**< Flag indicating if debug mode is enabled */
     size_t total_allocations;  /**< Total number of allocations */
     size_t total_frees;        /**< Total number of frees */
-    void **tracked_pointers;   /**< Array of pointers that have been freed */
+    void **tracked_pointers;   /**< Ring of quarantined pointers, oldest at `tracked_head` */
     size_t tracked_count;      /**< Number of tracked pointers */
-    size_t tracked_capacity;   /**< Capacity of the tracked pointers array */
+    size_t tracked_capacity;   /**< Capacity of the ring */
+    size_t tracked_head;       /**< Index of the oldest tracked pointer */
+    ptrmap_t tracked_index;    /**< Set of the tracked pointers */
+    size_t sample_rate;        /**< Track one free in `sample_rate`, 1 to track all of them */
 } vm_debug_t;
 
 /**
@@ -26,7 +128,20 @@ typedef struct {
  */
 typedef struct VirtualMachine {
     stack_t *frames;       /**< Stack of frames in the virtual machine */
+    stack_t *frame_pool;   /**< Freed frames kept, with their reference stacks, for reuse */
+    stack_t *handle_blocks; /**< Blocks of HANDLE_BLOCK_SLOTS root slots, kept once allocated */
+    handle_scope_t handles; /**< Next free handle slot */
+    size_t live_objects;   /**< Objects that survived the last collection */
+    mark_stack_t gray;     /**< Gray objects of a collection, chunks kept for the next one */
+    bool prefetch_marking; /**< Trace through a prefetching FIFO, for large heaps with poor locality */
     stack_t *objects;      /**< Stack of objects managed by the virtual machine */
+    stack_t *large_objects; /**< Objects whose payload is mapped from the OS (see BUFFER_LARGE_THRESHOLD) */
+    stack_t *weak_refs;    /**< WEAK objects, cleared in `sweep` when their target dies */
+    stack_t *ephemerons;   /**< Maps with weak keys, pruned in `sweep` */
+    stack_t *finalizers;   /**< `finalizer_entry_t` of live finalizable objects */
+    stack_t *finalize_queue; /**< `finalizer_entry_t` of dead objects, kept alive until finalized */
+    gc_stats_t stats;      /**< Garbage collection statistics */
+    heap_stats_t heap;     /**< Live heap statistics */
     vm_debug_t *debug;     /**< Debug information, if debug mode is enabled */
 } vm_t;
 
@@ -36,6 +151,8 @@ typedef struct VirtualMachine {
  */
 typedef struct StackFrame {
     stack_t *reference;    /**< Reference to the stack */
+    vm_t *vm;              /**< Virtual machine whose pool the frame returns to */
+    handle_scope_t handles; /**< Handle position at creation, restored by `frame_free` */
 } frame_t;
 
 /**
@@ -50,6 +167,8 @@ vm_t *vm_new(bool debug);
  * @brief Free the virtual machine and its resources.
  * 
  * @param vm Pointer to the virtual machine to free.
+ * 
+ * @note Every outstanding finalizer is run first.
  */
 void vm_free(vm_t *vm);
 
@@ -58,14 +177,62 @@ void vm_free(vm_t *vm);
  * 
  * @param vm Pointer to the virtual machine.
  * @param obj Object to be tracked by the VM.
+ * @return True if successful, false if allocation fails.
  */
-void vm_track_object(vm_t *vm, object_t *obj);
+bool vm_track_object(vm_t *vm, object_t *obj);
+
+/**
+ * @brief Track an object whose payload lives in its own `mmap` mapping.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param obj Object to be tracked in the large object space.
+ * @return True if successful, false if allocation fails.
+ * 
+ * @note Large objects are swept separately from small ones; an array that
+ *       is resized across BUFFER_LARGE_THRESHOLD changes space with it.
+ */
+bool vm_track_large_object(vm_t *vm, object_t *obj);
+
+/**
+ * @brief Move a tracked object between the small and the large object space.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param obj Object whose payload became (or stopped being) mapped.
+ * @param large True to move it to the large object space, false to move it out.
+ * @return True if the object was moved, false if it was not in the other space
+ *         or allocation fails.
+ * 
+ * @note Searches the source space, so it is meant for the rare resize that
+ *       crosses BUFFER_LARGE_THRESHOLD.
+ */
+bool vm_move_object_space(vm_t *vm, object_t *obj, bool large);
+
+/**
+ * @brief Stop tracking an object whose construction failed, undoing `vm_track_object`.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param obj Object not yet handed out, freed by the caller afterwards.
+ * @return True if the object was tracked, false otherwise.
+ */
+bool vm_untrack_object(vm_t *vm, object_t *obj);
+
+/**
+ * @brief Register a WEAK object or an ephemeron map with the virtual machine.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param obj Tracked object whose weak references the collector must clear.
+ * @return True if successful, false if allocation fails.
+ */
+bool vm_track_weak(vm_t *vm, object_t *obj);
 
 /**
  * @brief Create a new stack frame in the virtual machine.
  * 
  * @param vm Pointer to the virtual machine.
  * @return Pointer to the newly created frame.
+ * 
+ * @note Frames released by `frame_free` are reused first, so a steady
+ *       call/return cycle does not allocate.
  */
 frame_t *vm_new_frame(vm_t *vm);
 
@@ -82,16 +249,57 @@ frame_t *vm_frame_pop(vm_t *vm);
  * 
  * @param frame Pointer to the frame.
  * @param obj Object to be referenced within the frame.
+ * @return True if successful, false if allocation fails.
  */
-void frame_reference_object(frame_t *frame, object_t *obj);
+bool frame_reference_object(frame_t *frame, object_t *obj);
 
 /**
  * @brief Free a frame and its associated resources.
  * 
  * @param frame Pointer to the frame to free.
+ * 
+ * @note The frame and its reference stack go back to the pool of their
+ *       virtual machine, keeping their capacity, until `vm_free`.
  */
 void frame_free(frame_t *frame);
 
+/**
+ * @brief Open a handle scope.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param scope Receives the current handle position.
+ * 
+ * @note Scopes nest, and a frame is an implicit scope closed by `frame_free`.
+ */
+void vm_handle_scope_open(vm_t *vm, handle_scope_t *scope);
+
+/**
+ * @brief Close a handle scope, releasing every handle created since it was opened.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param scope Position saved by `vm_handle_scope_open`.
+ */
+void vm_handle_scope_close(vm_t *vm, const handle_scope_t *scope);
+
+/**
+ * @brief Root an object in a new handle of the innermost scope.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param obj Object to keep alive.
+ * @return Pointer to the handle slot, or NULL if allocation fails.
+ * 
+ * @note Slots are bump-allocated from fixed blocks, so handles never move and
+ *       creating one only allocates when a new block is first needed.
+ */
+object_t **vm_handle(vm_t *vm, object_t *obj);
+
+/**
+ * @brief Drop the root held by a handle, without closing its scope.
+ * 
+ * @param handle Handle returned by `vm_handle`.
+ */
+void handle_clear(object_t **handle);
+
 /**
  * @brief Run garbage collection on the virtual machine.
  * 
@@ -99,11 +307,110 @@ void frame_free(frame_t *frame);
  */
 void vm_collect_garbage(vm_t *vm);
 
+/**
+ * @brief Get the garbage collection statistics of the virtual machine.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @return Statistics, updated in place by later allocations and collections.
+ */
+const gc_stats_t *vm_gc_stats(const vm_t *vm);
+
+/**
+ * @brief Reset the garbage collection statistics of the virtual machine.
+ * 
+ * @param vm Pointer to the virtual machine.
+ */
+void vm_gc_stats_reset(vm_t *vm);
+
+/**
+ * @brief Count a newly constructed object in the live heap statistics.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param obj Tracked object, fully initialised.
+ * 
+ * @note Called by the `new_*_ms` constructors; the object is uncounted when it is swept.
+ */
+void vm_heap_account(vm_t *vm, object_t *obj);
+
+/**
+ * @brief Update the live heap statistics after an object changed size.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param obj Counted object, after the change.
+ * @param old_size Its `object_size` before the change.
+ */
+void vm_heap_resize(vm_t *vm, object_t *obj, size_t old_size);
+
+/**
+ * @brief Get the live heap statistics of the virtual machine.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @return Statistics, updated in place by later allocations and collections.
+ */
+const heap_stats_t *vm_heap_stats(const vm_t *vm);
+
+/**
+ * @brief Restart peak tracking from the current live heap.
+ * 
+ * @param vm Pointer to the virtual machine.
+ */
+void vm_heap_stats_reset_peak(vm_t *vm);
+
+/**
+ * @brief Estimate a percentile of the pause durations from the histogram.
+ * 
+ * @param stats Statistics of a virtual machine.
+ * @param percentile Percentile, from 0 to 100.
+ * @return Upper bound of the bucket holding the percentile in nanoseconds,
+ *         0 if nothing was collected.
+ */
+uint64_t gc_stats_pause_percentile(const gc_stats_t *stats, double percentile);
+
+/**
+ * @brief Register a finalizer to run once an object becomes unreachable.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @param obj Tracked object owning external resources.
+ * @param fn Finalizer, or NULL to remove a registered one.
+ * @param context Argument passed to `fn`.
+ * @return True if successful, false if allocation fails.
+ * 
+ * @note The collection that finds `obj` dead queues it and keeps it, and what it
+ *       references, alive; `vm_run_finalizers` runs `fn` outside the pause and
+ *       a later collection frees the object. A finalizer runs once.
+ */
+bool vm_set_finalizer(vm_t *vm, object_t *obj, finalizer_t fn, void *context);
+
+/**
+ * @brief Run the finalizers queued by previous collections.
+ * 
+ * @param vm Pointer to the virtual machine.
+ * @return Number of finalizers run.
+ * 
+ * @note Finalizers may allocate, but must not run the collector.
+ */
+size_t vm_run_finalizers(vm_t *vm);
+
+/**
+ * @brief Resize the quarantine of freed pointers and choose how many frees it samples.
+ * 
+ * @param vm Pointer to the virtual machine, in debug mode.
+ * @param capacity Number of freed objects kept in quarantine.
+ * @param sample_rate Track one free in `sample_rate`, 1 to track all of them.
+ * @return True if successful, false if debug mode is off or allocation fails.
+ * 
+ * @note The objects already in quarantine are released.
+ */
+bool vm_debug_configure(vm_t *vm, size_t capacity, size_t sample_rate);
+
 /**
  * @brief Check if a pointer has been freed in debug mode.
  * 
  * @param vm Pointer to the virtual machine.
  * @param ptr Pointer to check if it was previously freed.
  * @return True if the pointer was freed, false otherwise.
+ * 
+ * @note Runs in constant time. Only the last frees kept in quarantine, and
+ *       only sampled ones, are known.
  */
 bool vm_debug_was_freed(vm_t *vm, void *ptr);